@@ -1,406 +1,2547 @@
 #include "AudioCodec.h"
+#include "CodecProfile.h"
+#include "FrameSync.h"
 #include <cmath>
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <stdexcept>
+
+// Order of the fixed temporal predictor; the first PREDICTOR_ORDER samples
+// of every frame are stored verbatim so frames can be decoded independently
+static const int PREDICTOR_ORDER = 2;
+
+// Golomb quotients of this size or more are escaped, bounding every codeword
+static const int ESCAPE_LIMIT = 32;
+
+// Width of the subframe type field
+static const int SUBFRAME_TYPE_BITS = 3;
+
+// Residual partitioning: width of the partition order field, and the
+// smallest partition the encoder will create
+static const int PARTITION_ORDER_BITS = 4;
+static const size_t MIN_PARTITION_SIZE = 16;
+
+// Run segment sizes (log2) of the run mode, indexed by an adaptive state
+// (the J table of JPEG-LS)
+static const int RUN_SEGMENT_BITS[] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                       4, 4, 5, 5, 6, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static const int RUN_INDEX_COUNT = sizeof(RUN_SEGMENT_BITS) / sizeof(RUN_SEGMENT_BITS[0]);
+
+// Largest Golomb parameter the adaptive mode will pick, and its bit length
+// (the largest length field readGolombParameter accepts)
+static const int MAX_GOLOMB_PARAMETER_BITS = 30;
+static const double MAX_GOLOMB_PARAMETER = (1 << MAX_GOLOMB_PARAMETER_BITS) - 1;
+
+// Lossy mode: MDCT coefficients per block, and the bands (coefficient index
+// ranges, narrow at low frequencies) that share a quantization step. The
+// step of a band is 2^(scale factor / 4).
+static const size_t LOSSY_BLOCK_SIZE = 1024;
+static const size_t LOSSY_BAND_EDGES[] = {0, 4, 8, 12, 16, 20, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128,
+                                          160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+static const int LOSSY_BAND_COUNT = sizeof(LOSSY_BAND_EDGES) / sizeof(LOSSY_BAND_EDGES[0]) - 1;
+static const int LOSSY_BAND_COUNT_BITS = 5;
+static const int LOSSY_SCALE_BITS = 7;
+static const int LOSSY_SCALE_PARAMETER = 2; // Golomb parameter of scale factor differences
+
+// Hybrid mode correction streams: how each channel of each frame is coded
+static const int CORRECTION_MODE_BITS = 2;
+static const int CORRECTION_ZERO = 0;
+static const int CORRECTION_GOLOMB = 1;
+static const int CORRECTION_FIXED = 2;
+
+// Width of each entry (samples in one frame) of the frame table of edited
+// multichannel streams
+static const int FRAME_TABLE_BITS = 16;
+
+// Width used for raw samples in the stream: 16 bits also covers 8-bit audio
+// widened to 16 bits by the int16_t API
+static int codedSampleBits(const AudioInfo& info) {
+    return info.bitsPerSample <= 16 ? 16 : std::min<int>(info.bitsPerSample, 32);
+}
+
+// Range decoded samples are clamped to: the source bit depth (at least 8
+// bits), or the coded width for wide streams, whose samples do not fit the
+// source depth (8-bit audio scaled to 16 bits by the int16_t WAV API)
+static int sampleRange(const AudioInfo& info, bool wide) {
+    int bits = codedSampleBits(info);
+    return wide ? bits : std::min(bits, std::max<int>(info.bitsPerSample, 8));
+}
+
+// Whether any sample is outside the source bit depth
+static bool widerThanSource(const int32_t* samples, size_t n, const AudioInfo& info) {
+    int bits = sampleRange(info, false);
+    if (bits >= codedSampleBits(info)) return false;
+    int32_t maxValue = (1 << (bits - 1)) - 1;
+    for (size_t i = 0; i < n; i++) {
+        if (samples[i] > maxValue || samples[i] < -maxValue - 1) return true;
+    }
+    return false;
+}
+
+// Bits of a fixed-width correction value, covering 0..2 * delta
+static int correctionWidth(int delta) {
+    int width = 1;
+    while ((static_cast<int64_t>(1) << width) <= 2 * static_cast<int64_t>(delta)) {
+        width++;
+    }
+    return width;
+}
+
+const char* stereoModeName(StereoMode mode) {
+    static const char* names[] = {"leftRight", "midSide", "leftSide", "rightSide"};
+    return mode >= STEREO_LEFT_RIGHT && mode <= STEREO_RIGHT_SIDE ? names[mode] : "unknown";
+}
+
+const char* subframeTypeName(SubframeType type) {
+    static const char* names[] = {"constant", "verbatim", "fixed", "run", "nlms", "lpc", "cross"};
+    return type >= SUBFRAME_CONSTANT && type < SUBFRAME_TYPE_COUNT ? names[type] : "unknown";
+}
 
 // Constructor
-AudioCodec::AudioCodec(int golombParam, bool adaptive) 
-    : golomb(golombParam), defaultGolombParameter(golombParam), adaptiveMode(adaptive) {
+AudioCodec::AudioCodec(int golombParam, bool adaptive, int frameSize)
+    : golomb(golombParam), defaultGolombParameter(golombParam), adaptiveMode(adaptive),
+      blockSize(frameSize), extraHighMode(false), stereoSearch(true), maxLPCOrder(0),
+      exhaustiveOrderSearch(false), precisionSearch(false), maxPartitionOrder(4), longTermPrediction(false),
+      crossChannelPrediction(false), nearLosslessDelta(0), sampleRangeBits(16), lossyQuality(50), targetBitrate(0.0),
+      bufferSeconds(0.5), resyncFrames(false), lostFrames(0), profile(NULL), trace(NULL), subframeTypeCount() {
+    golomb.setEscapeLimit(ESCAPE_LIMIT);
+    setBlockSize(frameSize);
+}
+
+// Temporal prediction (order 2 by default)
+int64_t AudioCodec::predictTemporal(const int32_t* samples, size_t index, int order) {
+    if (index == 0) {
+        return 0; // No prediction for first sample
+    }
+    
+    if (order == 1) {
+        // First-order prediction: predict current sample as previous sample
+        return samples[index - 1];
+    } else if (order == 2 && index >= 2) {
+        // Second-order prediction: linear extrapolation
+        return 2 * static_cast<int64_t>(samples[index - 1]) - samples[index - 2];
+    } else if (order == 3 && index >= 3) {
+        // Third-order prediction
+        return 3 * static_cast<int64_t>(samples[index - 1]) - 3 * static_cast<int64_t>(samples[index - 2])
+               + samples[index - 3];
+    }
+    
+    return samples[index - 1]; // Fallback to order 1
+}
+
+// Split a stereo frame into the two channels actually coded for the given mode
+void AudioCodec::decorrelateStereo(const int32_t* left, const int32_t* right, size_t n, StereoMode mode,
+                                   std::vector<int32_t>& first, std::vector<int32_t>& second) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    first.resize(n);
+    second.resize(n);
+    
+    for (size_t i = 0; i < n; i++) {
+        switch (mode) {
+            case STEREO_MID_SIDE:
+                first[i] = (left[i] + right[i]) >> 1;
+                second[i] = left[i] - right[i];
+                break;
+            case STEREO_LEFT_SIDE:
+                first[i] = left[i];
+                second[i] = left[i] - right[i];
+                break;
+            case STEREO_RIGHT_SIDE:
+                first[i] = right[i];
+                second[i] = left[i] - right[i];
+                break;
+            default:
+                first[i] = left[i];
+                second[i] = right[i];
+                break;
+        }
+    }
+}
+
+// Inverse of decorrelateStereo
+void AudioCodec::correlateStereo(const int32_t* first, const int32_t* second, size_t n, StereoMode mode,
+                                 int32_t* left, int32_t* right) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    for (size_t i = 0; i < n; i++) {
+        switch (mode) {
+            case STEREO_MID_SIDE: {
+                // The bit lost by the mid shift is the low bit of the side
+                int32_t sum = first[i] * 2 + (second[i] & 1);
+                left[i] = (sum + second[i]) >> 1;
+                right[i] = (sum - second[i]) >> 1;
+                break;
+            }
+            case STEREO_LEFT_SIDE:
+                left[i] = first[i];
+                right[i] = first[i] - second[i];
+                break;
+            case STEREO_RIGHT_SIDE:
+                right[i] = first[i];
+                left[i] = first[i] + second[i];
+                break;
+            default:
+                left[i] = first[i];
+                right[i] = second[i];
+                break;
+        }
+    }
+}
+
+// Residuals of the cross-channel predictor for the second channel of a pair
+void AudioCodec::predictInterChannel(const int32_t* samples, const int32_t* reference, size_t n,
+                                     std::vector<int64_t>& residuals) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    crossPredictor.reset();
+    residuals.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        residuals[i] = crossPredictor.compress(samples[i], reference[i]);
+    }
+}
+
+void AudioCodec::restoreInterChannel(const std::vector<int64_t>& residuals, const int32_t* reference,
+                                     int32_t* samples, size_t n) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    crossPredictor.reset();
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = static_cast<int32_t>(crossPredictor.decompress(residuals[i], reference[i]));
+    }
+}
+
+// Pick the stereo mode with the smallest estimated coded size for this frame
+StereoMode AudioCodec::chooseStereoMode(const int32_t* left, const int32_t* right, size_t n, int sampleBits) {
+    ProfileTimer timer(profile, PROFILE_PARAMETER_SEARCH);
+    std::vector<int32_t>& mid = stereoMid;
+    std::vector<int32_t>& side = stereoSide;
+    mid.resize(n);
+    side.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        mid[i] = (left[i] + right[i]) >> 1;
+        side[i] = left[i] - right[i];
+    }
+    
+    size_t leftBits = estimateSubframeBits(left, n, sampleBits);
+    size_t rightBits = estimateSubframeBits(right, n, sampleBits);
+    size_t midBits = estimateSubframeBits(mid.data(), n, sampleBits);
+    size_t sideBits = estimateSubframeBits(side.data(), n, sampleBits + 1);
+    
+    // With cross-channel prediction the second channel depends on the first
+    size_t rightAfterLeft = rightBits;
+    size_t sideAfterMid = sideBits;
+    size_t sideAfterLeft = sideBits;
+    size_t sideAfterRight = sideBits;
+    if (crossChannelPrediction) {
+        rightAfterLeft = estimateSubframeBits(right, n, sampleBits, left);
+        sideAfterMid = estimateSubframeBits(side.data(), n, sampleBits + 1, mid.data());
+        sideAfterLeft = estimateSubframeBits(side.data(), n, sampleBits + 1, left);
+        sideAfterRight = estimateSubframeBits(side.data(), n, sampleBits + 1, right);
+    }
+    
+    size_t cost[4];
+    cost[STEREO_LEFT_RIGHT] = leftBits + rightAfterLeft;
+    cost[STEREO_MID_SIDE] = midBits + sideAfterMid;
+    cost[STEREO_LEFT_SIDE] = leftBits + sideAfterLeft;
+    cost[STEREO_RIGHT_SIDE] = rightBits + sideAfterRight;
+    
+    return static_cast<StereoMode>(std::min_element(cost, cost + 4) - cost);
+}
+
+// Encode one frame of a channel pair, optionally searching for the best stereo mode
+StereoMode AudioCodec::encodePairFrame(std::vector<bool>& bitstream, const int32_t* left, const int32_t* right,
+                                       size_t n, int sampleBits, bool searchMode) {
+    StereoMode mode = STEREO_LEFT_RIGHT;
+    if (searchMode) {
+        // The side of 32-bit audio does not fit in int32_t, so those streams stay
+        // L/R; so do near-lossless ones, whose errors a side channel would add up
+        if (sampleBits < 32 && stereoSearch && nearLosslessDelta == 0) {
+            mode = chooseStereoMode(left, right, n, sampleBits);
+        }
+        writeInteger(bitstream, mode, 2);
+    }
+    if (profile) profile->stereoModeCount[mode]++;
+    if (trace) traceRecord.stereoModes.push_back(mode);
+    
+    // The side channel needs one extra bit of range
+    std::vector<int32_t>& first = stereoFirst;
+    std::vector<int32_t>& second = stereoSecond;
+    decorrelateStereo(left, right, n, mode, first, second);
+    encodeSubframe(bitstream, first.data(), n, sampleBits);
+    encodeSubframe(bitstream, second.data(), n,
+                   mode == STEREO_LEFT_RIGHT ? sampleBits : sampleBits + 1, first.data());
+    
+    return mode;
+}
+
+// Decode one frame of a channel pair
+void AudioCodec::decodePairFrame(const std::vector<bool>& bitstream, size_t& pos, int32_t* left, int32_t* right,
+                                 size_t n, int sampleBits, bool hasMode, int golombParam, bool adaptive, int delta) {
+    StereoMode mode = STEREO_LEFT_RIGHT;
+    if (hasMode) {
+        mode = static_cast<StereoMode>(readInteger(bitstream, pos, 2));
+    }
+    if (profile) profile->stereoModeCount[mode]++;
+    
+    std::vector<int32_t>& first = stereoFirst;
+    std::vector<int32_t>& second = stereoSecond;
+    first.resize(n);
+    second.resize(n);
+    decodeSubframe(bitstream, pos, first.data(), n, sampleBits, golombParam, adaptive, delta);
+    decodeSubframe(bitstream, pos, second.data(), n,
+                   mode == STEREO_LEFT_RIGHT ? sampleBits : sampleBits + 1,
+                   golombParam, adaptive, delta, first.data());
+    
+    correlateStereo(first.data(), second.data(), n, mode, left, right);
+}
+
+// Calculate optimal Golomb parameter based on residual statistics
+int AudioCodec::calculateOptimalParameter(const std::vector<int64_t>& residuals, size_t windowSize) {
+    // Use the last windowSize residuals
+    size_t start = residuals.size() > windowSize ? residuals.size() - windowSize : 0;
+    return calculateOptimalParameter(residuals.data() + start, residuals.size() - start);
+}
+
+int AudioCodec::calculateOptimalParameter(const int64_t* residuals, size_t count) {
+    if (count == 0) return defaultGolombParameter;
+    
+    // Calculate mean of the interleaved (non-negative) residuals
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double r = static_cast<double>(residuals[i]);
+        sum += r >= 0 ? 2.0 * r : -2.0 * r - 1.0;
+    }
+    
+    double mean = sum / count;
+    
+    // Estimate optimal m for Golomb coding
+    // For a geometric distribution P(n) = (1-p) p^n the mean is p/(1-p), so p = mean/(1+mean),
+    // and the optimal m is ceil(-log(1+p) / log(p))
+    if (mean > 0) {
+        double p = mean / (1.0 + mean);
+        double m = std::ceil(-std::log(1.0 + p) / std::log(p));
+        
+        // Clamp to the range representable in the stream
+        return static_cast<int>(std::max(1.0, std::min(m, MAX_GOLOMB_PARAMETER)));
+    }
+    
+    return 1; // All residuals are zero
+}
+
+// Calculate residuals using temporal prediction (warm-up samples are not included)
+void AudioCodec::calculateResiduals(const int32_t* samples, size_t n, std::vector<int64_t>& residuals) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+    residuals.clear();
+    residuals.reserve(n - warmup);
+    
+    for (size_t i = warmup; i < n; i++) {
+        int64_t predicted = predictTemporal(samples, i, PREDICTOR_ORDER);
+        residuals.push_back(samples[i] - predicted);
+    }
+}
+
+// Reconstruct samples from residuals (warm-up samples must already be in place)
+void AudioCodec::reconstructFromResiduals(const std::vector<int64_t>& residuals, int32_t* samples, size_t n) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+    
+    for (size_t i = warmup; i < n && i - warmup < residuals.size(); i++) {
+        int64_t predicted = predictTemporal(samples, i, PREDICTOR_ORDER);
+        samples[i] = static_cast<int32_t>(predicted + residuals[i - warmup]);
+    }
+}
+
+// Near-lossless residuals of the fixed predictor: each prediction error is
+// quantized to the nearest multiple of 2 * delta + 1 and the predictor then
+// sees the sample the decoder will reconstruct, clamped to rangeBits
+void AudioCodec::calculateNearLosslessResiduals(const int32_t* samples, size_t n, int rangeBits, int delta,
+                                                std::vector<int64_t>& residuals) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+    int64_t step = 2 * static_cast<int64_t>(delta) + 1;
+    int64_t maxValue = (static_cast<int64_t>(1) << (rangeBits - 1)) - 1;
+    residuals.clear();
+    residuals.reserve(n - warmup);
+    
+    std::vector<int32_t>& reconstructed = reconstructedScratch;
+    reconstructed.assign(samples, samples + n);
+    for (size_t i = warmup; i < n; i++) {
+        int64_t predicted = predictTemporal(reconstructed.data(), i, PREDICTOR_ORDER);
+        int64_t error = samples[i] - predicted;
+        int64_t quantized = error >= 0 ? (error + delta) / step : -((delta - error) / step);
+        residuals.push_back(quantized);
+        
+        int64_t value = std::max(-maxValue - 1, std::min(maxValue, predicted + quantized * step));
+        reconstructed[i] = static_cast<int32_t>(value);
+    }
+}
+
+void AudioCodec::reconstructNearLossless(const std::vector<int64_t>& residuals, int32_t* samples, size_t n,
+                                         int rangeBits, int delta) {
+    ProfileTimer timer(profile, PROFILE_PREDICTION);
+    size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+    int64_t step = 2 * static_cast<int64_t>(delta) + 1;
+    int64_t maxValue = (static_cast<int64_t>(1) << (rangeBits - 1)) - 1;
+    
+    for (size_t i = warmup; i < n && i - warmup < residuals.size(); i++) {
+        int64_t predicted = predictTemporal(samples, i, PREDICTOR_ORDER);
+        int64_t value = std::max(-maxValue - 1, std::min(maxValue, predicted + residuals[i - warmup] * step));
+        samples[i] = static_cast<int32_t>(value);
+    }
+}
+
+// Number of bits needed to store every sample as two's complement
+static int requiredSampleBits(const int32_t* samples, size_t n) {
+    uint32_t magnitude = 0;
+    for (size_t i = 0; i < n; i++) {
+        // Non-negative values and their one's complement need the same width
+        magnitude |= static_cast<uint32_t>(samples[i] < 0 ? ~samples[i] : samples[i]);
+    }
+    int bits = 1;
+    while (bits < 32 && (magnitude >> (bits - 1)) != 0) {
+        bits++;
+    }
+    return bits;
+}
+
+// Bits used to signal a Golomb parameter (see writeGolombParameter)
+static size_t parameterBits(int param) {
+    size_t length = 1;
+    while (length < 31 && (param >> length) != 0) {
+        length++;
+    }
+    return 5 + length - 1;
+}
+
+// Size of the residual section of a subframe, choosing how it is coded. In
+// adaptive mode the residuals are split into 2^partitionOrder partitions,
+// each with its own parameter; every order up to maxPartitionOrder that keeps
+// partitions of at least MIN_PARTITION_SIZE residuals is sized exactly.
+// Includes the pitch flag, but not the lag and gain that follow it.
+size_t AudioCodec::planResidualCoding(const std::vector<int64_t>& residuals, int maxPartitionOrder,
+                                      int& partitionOrder, std::vector<int>& parameters) {
+    ProfileTimer timer(profile, PROFILE_PARAMETER_SEARCH);
+    GolombCoding estimator(defaultGolombParameter);
+    estimator.setEscapeLimit(ESCAPE_LIMIT);
+    
+    if (!adaptiveMode) {
+        partitionOrder = 0;
+        parameters.assign(1, defaultGolombParameter);
+        size_t bits = 1;
+        for (size_t i = 0; i < residuals.size(); i++) {
+            bits += estimator.codeLengthInterleaving(residuals[i]);
+        }
+        return bits;
+    }
+    
+    // Room for the most partitions, so that the parameter vectors (swapped
+    // between plans) reach their final capacity on the first frame
+    size_t bestBits = 0;
+    std::vector<int>& trial = trialParameters;
+    size_t maxPartitions = static_cast<size_t>(1) << maxPartitionOrder;
+    parameters.reserve(std::min(maxPartitions, residuals.size() / MIN_PARTITION_SIZE + 1));
+    for (int order = 0; order <= maxPartitionOrder; order++) {
+        if (order > 0 && (residuals.size() >> order) < MIN_PARTITION_SIZE) break;
+        
+        size_t partitions = static_cast<size_t>(1) << order;
+        size_t bits = 1 + PARTITION_ORDER_BITS;
+        trial.resize(partitions);
+        for (size_t p = 0; p < partitions; p++) {
+            size_t first, last;
+            partitionBounds(residuals.size(), order, p, first, last);
+            trial[p] = calculateOptimalParameter(residuals.data() + first, last - first);
+            estimator.setParameter(trial[p]);
+            bits += parameterBits(trial[p]);
+            for (size_t i = first; i < last; i++) {
+                bits += estimator.codeLengthInterleaving(residuals[i]);
+            }
+        }
+        
+        if (order == 0 || bits < bestBits) {
+            bestBits = bits;
+            partitionOrder = order;
+            parameters = trial;
+        }
+    }
+    return bestBits;
+}
+
+// Residual range [first, last) of a partition: all partitions have
+// count >> order residuals except the last, which takes the remainder
+void AudioCodec::partitionBounds(size_t count, int order, size_t partition, size_t& first, size_t& last) {
+    size_t size = count >> order;
+    first = partition * size;
+    last = partition + 1 == (static_cast<size_t>(1) << order) ? count : first + size;
+}
+
+// Decide how one channel of one frame is coded, computing its exact size in bits
+void AudioCodec::planSubframe(const int32_t* samples, size_t n, int sampleBits, SubframePlan& plan,
+                              const int32_t* reference) {
+    ProfileTimer timer(profile, PROFILE_PARAMETER_SEARCH);
+    plan.wastedBits = 0;
+    plan.pitchGain = 0;
+    plan.samples.clear();
+    plan.residuals.clear();
+    
+    // Header: subframe type
+    size_t headerBits = SUBFRAME_TYPE_BITS;
+    
+    bool constant = n > 0;
+    uint32_t usedBits = 0;
+    for (size_t i = 0; i < n; i++) {
+        constant = constant && samples[i] == samples[0];
+        usedBits |= static_cast<uint32_t>(samples[i]);
+    }
+    
+    if (constant) {
+        plan.type = SUBFRAME_CONSTANT;
+        plan.bits = headerBits + sampleBits;
+        return;
+    }
+    
+    // Low bits that are zero in every sample are not coded (near-lossless
+    // errors would be scaled up by the shift, so it is lossless only)
+    bool nearLossless = nearLosslessDelta > 0;
+    if (usedBits != 0 && !nearLossless) {
+        while (plan.wastedBits < sampleBits - 1 && plan.wastedBits < 31 &&
+               ((usedBits >> plan.wastedBits) & 1) == 0) {
+            plan.wastedBits++;
+        }
+    }
+    headerBits += plan.wastedBits > 0 ? 6 : 1;
+    
+    plan.samples.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        plan.samples[i] = samples[i] >> plan.wastedBits;
+    }
+    int shiftedBits = sampleBits - plan.wastedBits;
+    
+    // Predictor candidates are compared with a single parameter per subframe;
+    // the partitioning of the chosen one is refined at the end
+    if (nearLossless) {
+        calculateNearLosslessResiduals(plan.samples.data(), n, sampleRangeBits, nearLosslessDelta, plan.residuals);
+    } else {
+        calculateResiduals(plan.samples.data(), n, plan.residuals);
+    }
+    size_t fixedBits = headerBits + std::min(n, static_cast<size_t>(PREDICTOR_ORDER)) * shiftedBits +
+                       planResidualCoding(plan.residuals, 0, plan.partitionOrder, plan.parameters);
+    
+    // Run mode cost, with a parameter fitted to the residuals left outside runs
+    plan.literals.clear();
+    for (size_t i = 0; i < plan.residuals.size(); i++) {
+        if (i == 0 || plan.residuals[i] != 0 || plan.residuals[i - 1] != 0) {
+            plan.literals.push_back(plan.residuals[i]);
+        }
+    }
+    int runParam = adaptiveMode ? calculateOptimalParameter(plan.literals, n) : defaultGolombParameter;
+    GolombCoding estimator(runParam);
+    estimator.setEscapeLimit(ESCAPE_LIMIT);
+    size_t runBits = headerBits + std::min(n, static_cast<size_t>(PREDICTOR_ORDER)) * shiftedBits +
+                     (adaptiveMode ? parameterBits(runParam) : 0) +
+                     codeResidualRuns(plan.residuals, estimator, NULL);
+    
+    // Raw PCM cost: this bounds the expansion of incompressible frames
+    plan.verbatimBits = std::min(requiredSampleBits(plan.samples.data(), n), shiftedBits);
+    size_t verbatimBits = headerBits + 6 + n * plan.verbatimBits;
+    
+    if (verbatimBits <= fixedBits && verbatimBits <= runBits) {
+        plan.type = SUBFRAME_VERBATIM;
+        plan.bits = verbatimBits;
+    } else if (runBits < fixedBits) {
+        plan.type = SUBFRAME_RUN;
+        plan.bits = runBits;
+        plan.partitionOrder = 0;
+        plan.parameters.assign(1, runParam);
+    } else {
+        plan.type = SUBFRAME_FIXED;
+        plan.bits = fixedBits;
+    }
+    
+    // The other predictors do not run on reconstructed samples, so they are
+    // lossless only
+    if (maxLPCOrder > 0 && !nearLossless) {
+        planLPCSubframe(n, shiftedBits, headerBits, plan);
+    }
+    
+    // Adaptive cascade cost (extra high mode only: it is much slower)
+    if (extraHighMode && !nearLossless) {
+        {
+            ProfileTimer timer(profile, PROFILE_PREDICTION);
+            cascade.reset();
+            plan.candidate.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                plan.candidate[i] = cascade.compress(plan.samples[i]);
+            }
+        }
+        int partitionOrder;
+        std::vector<int>& parameters = candidateParameters;
+        size_t cascadeBits = headerBits + planResidualCoding(plan.candidate, 0, partitionOrder, parameters);
+        
+        if (cascadeBits < plan.bits) {
+            plan.type = SUBFRAME_NLMS;
+            plan.bits = cascadeBits;
+            plan.partitionOrder = partitionOrder;
+            plan.parameters.swap(parameters);
+            plan.residuals.swap(plan.candidate);
+        }
+    }
+    
+    // Cross-channel cost, when the first channel of the pair is available
+    if (crossChannelPrediction && reference != NULL && !nearLossless) {
+        predictInterChannel(plan.samples.data(), reference, n, plan.candidate);
+        int partitionOrder;
+        std::vector<int>& parameters = candidateParameters;
+        size_t crossBits = headerBits + planResidualCoding(plan.candidate, 0, partitionOrder, parameters);
+        
+        if (crossBits < plan.bits) {
+            plan.type = SUBFRAME_CROSS;
+            plan.bits = crossBits;
+            plan.partitionOrder = partitionOrder;
+            plan.parameters.swap(parameters);
+            plan.residuals.swap(plan.candidate);
+        }
+    }
+    
+    bool predictive = plan.type == SUBFRAME_FIXED || plan.type == SUBFRAME_LPC ||
+                      plan.type == SUBFRAME_NLMS || plan.type == SUBFRAME_CROSS;
+    
+    // Long-term prediction on the residuals of the chosen short-term predictor
+    int lag, gain;
+    if (longTermPrediction && predictive && !nearLossless && findPitch(plan.residuals, lag, gain, pitchSearch)) {
+        plan.candidate = plan.residuals;
+        applyPitchPrediction(plan.candidate, lag, gain);
+        int partitionOrder;
+        std::vector<int>& parameters = candidateParameters;
+        size_t singleBits = planResidualCoding(plan.residuals, 0, plan.partitionOrder, plan.parameters);
+        size_t pitchBits = PITCH_LAG_BITS + PITCH_GAIN_BITS +
+                           planResidualCoding(plan.candidate, 0, partitionOrder, parameters);
+        
+        if (pitchBits < singleBits) {
+            plan.bits = plan.bits - singleBits + pitchBits;
+            plan.pitchLag = lag;
+            plan.pitchGain = gain;
+            plan.partitionOrder = partitionOrder;
+            plan.parameters.swap(parameters);
+            plan.residuals.swap(plan.candidate);
+        }
+    }
+    
+    // Partitioned parameters for the chosen predictor
+    if (adaptiveMode && maxPartitionOrder > 0 && predictive) {
+        size_t singleBits = planResidualCoding(plan.residuals, 0, plan.partitionOrder, plan.parameters);
+        size_t partitionedBits = planResidualCoding(plan.residuals, maxPartitionOrder,
+                                                    plan.partitionOrder, plan.parameters);
+        plan.bits = plan.bits - singleBits + partitionedBits;
+    }
+}
+
+// Try LPC predictors on plan.samples and take the best one if it beats the
+// current plan. Orders are ranked by their expected residual size unless the
+// search is exhaustive; every candidate kept is sized exactly.
+void AudioCodec::planLPCSubframe(size_t n, int shiftedBits, size_t headerBits, SubframePlan& plan) {
+    int maxOrder = static_cast<int>(std::min(static_cast<size_t>(maxLPCOrder), n > 1 ? n - 1 : 0));
+    if (maxOrder < 1) return;
+    
+    std::vector<double>& autocorrelation = autocorrelationScratch;
+    std::vector<double>& errors = errorScratch;
+    std::vector<std::vector<double> >& coefficients = coefficientScratch;
+    int orders;
+    {
+        ProfileTimer timer(profile, PROFILE_PREDICTION);
+        computeAutocorrelation(plan.samples.data(), n, maxOrder, autocorrelation, windowScratch);
+        orders = computeLPCCoefficients(autocorrelation, maxOrder, coefficients, errors);
+    }
+    if (orders == 0) return;
+    
+    // Coefficient precision: FLAC's choice by frame size, or the precisions around it
+    int defaultPrecision = n <= 192 ? 7 : n <= 384 ? 8 : n <= 576 ? 9 : n <= 1152 ? 10 :
+                           n <= 2304 ? 11 : n <= 4608 ? 12 : 13;
+    int firstPrecision = precisionSearch ? std::max(defaultPrecision - 2, MIN_LPC_PRECISION) : defaultPrecision;
+    int lastPrecision = precisionSearch ? std::min(defaultPrecision + 2, MAX_LPC_PRECISION) : defaultPrecision;
+    
+    int firstOrder = 1;
+    int lastOrder = orders;
+    if (!exhaustiveOrderSearch) {
+        double bestEstimate = 0.0;
+        for (int k = 0; k < orders; k++) {
+            double estimate = expectedBitsPerSample(errors[k], n) * (n - k - 1) +
+                              (k + 1) * (defaultPrecision + shiftedBits);
+            if (k == 0 || estimate < bestEstimate) {
+                bestEstimate = estimate;
+                firstOrder = k + 1;
+            }
+        }
+        lastOrder = firstOrder;
+    }
+    
+    std::vector<int32_t>& quantized = quantizedScratch;
+    std::vector<int>& parameters = candidateParameters;
+    int partitionOrder;
+    
+    for (int order = firstOrder; order <= lastOrder; order++) {
+        for (int precision = firstPrecision; precision <= lastPrecision; precision++) {
+            int shift;
+            if (!quantizeLPCCoefficients(coefficients[order - 1], precision, quantized, shift)) continue;
+            
+            {
+                ProfileTimer timer(profile, PROFILE_PREDICTION);
+                computeLPCResiduals(plan.samples.data(), n, quantized, shift, plan.candidate);
+            }
+            
+            // Order, precision and shift fields, coefficients and warm-up samples
+            size_t bits = headerBits + 5 + 4 + 4 + order * precision + order * shiftedBits +
+                          planResidualCoding(plan.candidate, 0, partitionOrder, parameters);
+            
+            if (bits < plan.bits) {
+                plan.type = SUBFRAME_LPC;
+                plan.bits = bits;
+                plan.partitionOrder = partitionOrder;
+                plan.parameters.swap(parameters);
+                plan.lpcPrecision = precision;
+                plan.lpcShift = shift;
+                plan.lpcCoefficients = quantized;
+                plan.residuals.swap(plan.candidate);
+            }
+        }
+    }
+}
+
+// Code residuals with the run mode (after JPEG-LS): a zero residual switches
+// to run-length coding of the zeros that follow it. Each 1 bit stands for a
+// full segment of 2^RUN_SEGMENT_BITS[index] zeros and grows the segment; a 0
+// bit ends the run, followed by the remaining length in that many bits and
+// the nonzero residual that interrupted it, and shrinks the segment. A run
+// reaching the end of the subframe is closed by a single 1 bit instead.
+// Returns the number of bits; they are appended when bitstream is not NULL.
+size_t AudioCodec::codeResidualRuns(const std::vector<int64_t>& residuals, GolombCoding& coder,
+                                    std::vector<bool>* bitstream) {
+    size_t bits = 0;
+    size_t n = residuals.size();
+    size_t i = 0;
+    int runIndex = 0;
+    
+    while (i < n) {
+        int64_t residual = residuals[i++];
+        if (bitstream) {
+            coder.encodeInterleaving(residual, *bitstream);
+        }
+        bits += coder.codeLengthInterleaving(residual);
+        if (residual != 0) continue;
+        
+        size_t run = 0;
+        while (i + run < n && residuals[i + run] == 0) {
+            run++;
+        }
+        i += run;
+        
+        // Full segments
+        while (run >= (static_cast<size_t>(1) << RUN_SEGMENT_BITS[runIndex])) {
+            run -= static_cast<size_t>(1) << RUN_SEGMENT_BITS[runIndex];
+            if (bitstream) bitstream->push_back(true);
+            bits++;
+            if (runIndex < RUN_INDEX_COUNT - 1) runIndex++;
+        }
+        
+        if (i == n) {
+            // Run reaches the end of the subframe
+            if (run > 0) {
+                if (bitstream) bitstream->push_back(true);
+                bits++;
+            }
+            break;
+        }
+        
+        // Interrupted run: the residual is known to be nonzero, so its
+        // interleaved value is coded minus one
+        int64_t interrupt = residuals[i++];
+        uint64_t value = interrupt >= 0 ? 2 * static_cast<uint64_t>(interrupt) - 1
+                                        : 2 * static_cast<uint64_t>(-interrupt) - 2;
+        if (bitstream) {
+            bitstream->push_back(false);
+            writeInteger(*bitstream, static_cast<int>(run), RUN_SEGMENT_BITS[runIndex]);
+            coder.encode(value, *bitstream);
+        }
+        bits += 1 + RUN_SEGMENT_BITS[runIndex] + coder.codeLength(value);
+        if (runIndex > 0) runIndex--;
+    }
+    
+    return bits;
+}
+
+// Inverse of codeResidualRuns for count residuals
+void AudioCodec::decodeResidualRuns(const std::vector<bool>& bitstream, size_t& pos, size_t count,
+                                    std::vector<int64_t>& residuals) {
+    int runIndex = 0;
+    
+    while (residuals.size() < count) {
+        int64_t residual = golomb.decodeInterleaving(bitstream, pos);
+        residuals.push_back(residual);
+        if (residual != 0) continue;
+        
+        while (residuals.size() < count) {
+            if (pos >= bitstream.size()) {
+                throw std::out_of_range("Unexpected end of stream in run");
+            }
+            size_t remaining = count - residuals.size();
+            size_t segment = static_cast<size_t>(1) << RUN_SEGMENT_BITS[runIndex];
+            
+            if (bitstream[pos++]) {
+                residuals.insert(residuals.end(), std::min(segment, remaining), 0);
+                if (segment <= remaining && runIndex < RUN_INDEX_COUNT - 1) runIndex++;
+                continue;
+            }
+            
+            size_t run = static_cast<size_t>(readInteger(bitstream, pos, RUN_SEGMENT_BITS[runIndex]));
+            if (run >= remaining) {
+                throw std::invalid_argument("Invalid run length in stream");
+            }
+            residuals.insert(residuals.end(), run, 0);
+            
+            uint64_t value = golomb.decode(bitstream, pos) + 1;
+            residuals.push_back((value & 1) ? -static_cast<int64_t>((value + 1) >> 1)
+                                            : static_cast<int64_t>(value >> 1));
+            if (runIndex > 0) runIndex--;
+            break;
+        }
+    }
+}
+
+// Write a planned subframe
+void AudioCodec::writeSubframe(std::vector<bool>& bitstream, const int32_t* samples, size_t n,
+                               int sampleBits, const SubframePlan& plan) {
+    ProfileTimer timer(profile, PROFILE_ENTROPY_CODING);
+    writeInteger(bitstream, plan.type, SUBFRAME_TYPE_BITS);
+    subframeTypeCount[plan.type]++;
+    if (profile) profile->subframeTypeCount[plan.type]++;
+    if (trace) {
+        traceRecord.subframes.push_back(SubframeTrace());
+        SubframeTrace& traced = traceRecord.subframes.back();
+        traced.type = plan.type;
+        traced.order = plan.type == SUBFRAME_LPC ? static_cast<int>(plan.lpcCoefficients.size()) :
+                       plan.type == SUBFRAME_FIXED || plan.type == SUBFRAME_RUN ? PREDICTOR_ORDER : 0;
+        traced.bits = plan.bits;
+        if (plan.type != SUBFRAME_CONSTANT && plan.type != SUBFRAME_VERBATIM) {
+            traced.parameters = plan.parameters;
+        }
+    }
+    
+    if (plan.type == SUBFRAME_CONSTANT) {
+        writeInteger(bitstream, samples[0], sampleBits);
+        return;
+    }
+    
+    // Wasted bits: a flag, then the count if any
+    bitstream.push_back(plan.wastedBits > 0);
+    if (plan.wastedBits > 0) {
+        writeInteger(bitstream, plan.wastedBits, 5);
+    }
+    
+    if (plan.type == SUBFRAME_VERBATIM) {
+        writeInteger(bitstream, plan.verbatimBits, 6);
+        for (size_t i = 0; i < n; i++) {
+            writeInteger(bitstream, plan.samples[i], plan.verbatimBits);
+        }
+        return;
+    }
+    
+    if (plan.type == SUBFRAME_NLMS || plan.type == SUBFRAME_CROSS) {
+        // No warm-up: the adaptive predictors start from zero state
+        writeResiduals(bitstream, plan.residuals, plan.partitionOrder, plan.parameters,
+                       plan.pitchLag, plan.pitchGain);
+        return;
+    }
+    
+    // Warm-up samples, stored as two's complement without the wasted bits
+    int shiftedBits = sampleBits - plan.wastedBits;
+    size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+    
+    if (plan.type == SUBFRAME_LPC) {
+        warmup = plan.lpcCoefficients.size();
+        writeInteger(bitstream, static_cast<int>(warmup) - 1, 5);
+        writeInteger(bitstream, plan.lpcPrecision - 1, 4);
+        writeInteger(bitstream, plan.lpcShift, 4);
+        for (size_t j = 0; j < warmup; j++) {
+            writeInteger(bitstream, plan.lpcCoefficients[j], plan.lpcPrecision);
+        }
+    }
+    for (size_t i = 0; i < warmup; i++) {
+        writeInteger(bitstream, plan.samples[i], shiftedBits);
+    }
+    
+    if (plan.type == SUBFRAME_RUN) {
+        if (adaptiveMode) {
+            writeGolombParameter(bitstream, plan.parameters[0]);
+        }
+        size_t escapes = golomb.getEscapeCount();
+        golomb.setParameter(plan.parameters[0]);
+        codeResidualRuns(plan.residuals, golomb, &bitstream);
+        if (profile) {
+            profile->addParameter(plan.parameters[0], plan.residuals.size());
+            profile->escapeCodes += golomb.getEscapeCount() - escapes;
+        }
+        return;
+    }
+    writeResiduals(bitstream, plan.residuals, plan.partitionOrder, plan.parameters,
+                       plan.pitchLag, plan.pitchGain);
+}
+
+// Residual section: a pitch flag (then lag and signed gain if set), the
+// partition order and one parameter per partition in adaptive mode, then the
+// Golomb codes (interleaved, so negative values work)
+void AudioCodec::writeResiduals(std::vector<bool>& bitstream, const std::vector<int64_t>& residuals,
+                                int partitionOrder, const std::vector<int>& parameters,
+                                int pitchLag, int pitchGain) {
+    bitstream.push_back(pitchGain != 0);
+    if (pitchGain != 0) {
+        writeInteger(bitstream, pitchLag, PITCH_LAG_BITS);
+        writeInteger(bitstream, pitchGain, PITCH_GAIN_BITS);
+    }
+    
+    size_t escapes = golomb.getEscapeCount();
+    if (!adaptiveMode) {
+        golomb.setParameter(defaultGolombParameter);
+        for (size_t i = 0; i < residuals.size(); i++) {
+            golomb.encodeInterleaving(residuals[i], bitstream);
+        }
+        if (profile) profile->addParameter(defaultGolombParameter, residuals.size());
+    } else {
+        writeInteger(bitstream, partitionOrder, PARTITION_ORDER_BITS);
+        for (size_t p = 0; p < parameters.size(); p++) {
+            size_t first, last;
+            partitionBounds(residuals.size(), partitionOrder, p, first, last);
+            writeGolombParameter(bitstream, parameters[p]);
+            golomb.setParameter(parameters[p]);
+            for (size_t i = first; i < last; i++) {
+                golomb.encodeInterleaving(residuals[i], bitstream);
+            }
+            if (profile) profile->addParameter(parameters[p], last - first);
+        }
+    }
+    if (profile) profile->escapeCodes += golomb.getEscapeCount() - escapes;
+}
+
+void AudioCodec::readResiduals(const std::vector<bool>& bitstream, size_t& pos, size_t count,
+                               int golombParam, bool adaptive, std::vector<int64_t>& residuals) {
+    residuals.clear();
+    residuals.reserve(count);
+    
+    int pitchLag = 0;
+    int pitchGain = 0;
+    if (pos < bitstream.size() && bitstream[pos++]) {
+        pitchLag = readInteger(bitstream, pos, PITCH_LAG_BITS);
+        pitchGain = readSignedInteger(bitstream, pos, PITCH_GAIN_BITS);
+        if (pitchLag < MIN_PITCH_LAG) {
+            throw std::invalid_argument("Invalid pitch lag in stream");
+        }
+    }
+    
+    size_t escapes = golomb.getEscapeCount();
+    if (!adaptive) {
+        if (golombParam <= 0) {
+            throw std::invalid_argument("Invalid Golomb parameter in stream");
+        }
+        golomb.setParameter(golombParam);
+        for (size_t i = 0; i < count; i++) {
+            residuals.push_back(golomb.decodeInterleaving(bitstream, pos));
+        }
+        if (profile) profile->addParameter(golombParam, count);
+    } else {
+        int partitionOrder = readInteger(bitstream, pos, PARTITION_ORDER_BITS);
+        size_t partitions = static_cast<size_t>(1) << partitionOrder;
+        for (size_t p = 0; p < partitions; p++) {
+            size_t first, last;
+            partitionBounds(count, partitionOrder, p, first, last);
+            golomb.setParameter(readGolombParameter(bitstream, pos));
+            for (size_t i = first; i < last; i++) {
+                residuals.push_back(golomb.decodeInterleaving(bitstream, pos));
+            }
+            if (profile) profile->addParameter(golomb.getParameter(), last - first);
+        }
+    }
+    if (profile) profile->escapeCodes += golomb.getEscapeCount() - escapes;
+    
+    if (pitchGain != 0) {
+        ProfileTimer timer(profile, PROFILE_PREDICTION);
+        removePitchPrediction(residuals, pitchLag, pitchGain);
+    }
+}
+
+// Golomb parameter as its bit length (5 bits) and the bits below the leading one
+void AudioCodec::writeGolombParameter(std::vector<bool>& bitstream, int param) {
+    int length = static_cast<int>(parameterBits(param)) - 4;
+    writeInteger(bitstream, length, 5);
+    writeInteger(bitstream, param, length - 1);
+}
+
+int AudioCodec::readGolombParameter(const std::vector<bool>& bitstream, size_t& pos) {
+    int length = readInteger(bitstream, pos, 5);
+    if (length < 1 || length > MAX_GOLOMB_PARAMETER_BITS) {
+        throw std::invalid_argument("Invalid Golomb parameter in stream");
+    }
+    return (1 << (length - 1)) | readInteger(bitstream, pos, length - 1);
+}
+
+// Exact size in bits that encodeSubframe would produce
+size_t AudioCodec::estimateSubframeBits(const int32_t* samples, size_t n, int sampleBits,
+                                        const int32_t* reference) {
+    planSubframe(samples, n, sampleBits, scratchPlan, reference);
+    return scratchPlan.bits;
+}
+
+// Encode one channel of one frame
+void AudioCodec::encodeSubframe(std::vector<bool>& bitstream, const int32_t* samples, size_t n, int sampleBits,
+                                const int32_t* reference) {
+    planSubframe(samples, n, sampleBits, scratchPlan, reference);
+    writeSubframe(bitstream, samples, n, sampleBits, scratchPlan);
+}
+
+// Decode one channel of one frame
+void AudioCodec::decodeSubframe(const std::vector<bool>& bitstream, size_t& pos, int32_t* samples, size_t n,
+                                int sampleBits, int golombParam, bool adaptive, int delta,
+                                const int32_t* reference) {
+    ProfileTimer timer(profile, PROFILE_ENTROPY_CODING);
+    SubframeType type = static_cast<SubframeType>(readInteger(bitstream, pos, SUBFRAME_TYPE_BITS));
+    if (profile && type < SUBFRAME_TYPE_COUNT) profile->subframeTypeCount[type]++;
+    
+    if (type == SUBFRAME_CONSTANT) {
+        std::fill(samples, samples + n, readSignedInteger(bitstream, pos, sampleBits));
+        return;
+    }
+    
+    int wastedBits = 0;
+    if (pos < bitstream.size() && bitstream[pos++]) {
+        wastedBits = readInteger(bitstream, pos, 5);
+    }
+    int shiftedBits = sampleBits - wastedBits;
+    if (shiftedBits < 1) {
+        throw std::invalid_argument("Invalid wasted bits in stream");
+    }
+    
+    if (type == SUBFRAME_VERBATIM) {
+        int width = readInteger(bitstream, pos, 6);
+        if (width < 1 || width > 32) {
+            throw std::invalid_argument("Invalid verbatim sample width in stream");
+        }
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = readSignedInteger(bitstream, pos, width);
+        }
+    } else if (type == SUBFRAME_NLMS) {
+        std::vector<int64_t>& residuals = residualScratch;
+        readResiduals(bitstream, pos, n, golombParam, adaptive, residuals);
+        ProfileTimer predictionTimer(profile, PROFILE_PREDICTION);
+        cascade.reset();
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = static_cast<int32_t>(cascade.decompress(residuals[i]));
+        }
+    } else if (type == SUBFRAME_CROSS) {
+        if (reference == NULL) {
+            throw std::invalid_argument("Cross-channel subframe outside a channel pair");
+        }
+        std::vector<int64_t>& residuals = residualScratch;
+        readResiduals(bitstream, pos, n, golombParam, adaptive, residuals);
+        restoreInterChannel(residuals, reference, samples, n);
+    } else if (type == SUBFRAME_LPC) {
+        size_t order = static_cast<size_t>(readInteger(bitstream, pos, 5)) + 1;
+        int precision = readInteger(bitstream, pos, 4) + 1;
+        int shift = readInteger(bitstream, pos, 4);
+        if (order > n) {
+            throw std::invalid_argument("Invalid LPC order in stream");
+        }
+        std::vector<int32_t>& coefficients = quantizedScratch;
+        coefficients.resize(order);
+        for (size_t j = 0; j < order; j++) {
+            coefficients[j] = readSignedInteger(bitstream, pos, precision);
+        }
+        for (size_t i = 0; i < order; i++) {
+            samples[i] = readSignedInteger(bitstream, pos, shiftedBits);
+        }
+        
+        std::vector<int64_t>& residuals = residualScratch;
+        readResiduals(bitstream, pos, n - order, golombParam, adaptive, residuals);
+        ProfileTimer predictionTimer(profile, PROFILE_PREDICTION);
+        restoreLPCSignal(residuals, coefficients, shift, samples, n);
+    } else if (type == SUBFRAME_FIXED || type == SUBFRAME_RUN) {
+        size_t warmup = std::min(n, static_cast<size_t>(PREDICTOR_ORDER));
+        for (size_t i = 0; i < warmup; i++) {
+            samples[i] = readSignedInteger(bitstream, pos, shiftedBits);
+        }
+        
+        std::vector<int64_t>& residuals = residualScratch;
+        if (type == SUBFRAME_RUN) {
+            int param = adaptive ? readGolombParameter(bitstream, pos) : golombParam;
+            if (param <= 0) {
+                throw std::invalid_argument("Invalid Golomb parameter in stream");
+            }
+            size_t escapes = golomb.getEscapeCount();
+            golomb.setParameter(param);
+            residuals.clear();
+            residuals.reserve(n - warmup);
+            decodeResidualRuns(bitstream, pos, n - warmup, residuals);
+            if (profile) {
+                profile->addParameter(param, residuals.size());
+                profile->escapeCodes += golomb.getEscapeCount() - escapes;
+            }
+        } else {
+            readResiduals(bitstream, pos, n - warmup, golombParam, adaptive, residuals);
+        }
+        
+        if (delta > 0) {
+            reconstructNearLossless(residuals, samples, n, sampleRangeBits, delta);
+        } else {
+            reconstructFromResiduals(residuals, samples, n);
+        }
+    } else {
+        throw std::invalid_argument("Invalid subframe type in stream");
+    }
+    
+    if (wastedBits > 0) {
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = static_cast<int32_t>(static_cast<uint32_t>(samples[i]) << wastedBits);
+        }
+    }
+}
+
+// Write bits to bitstream
+void AudioCodec::writeBits(std::vector<bool>& bitstream, const std::vector<bool>& bits) {
+    bitstream.insert(bitstream.end(), bits.begin(), bits.end());
+}
+
+// Write integer with fixed number of bits
+void AudioCodec::writeInteger(std::vector<bool>& bitstream, int value, int numBits) {
+    for (int i = numBits - 1; i >= 0; i--) {
+        bitstream.push_back((value >> i) & 1);
+    }
+}
+
+// Read integer from bitstream
+int AudioCodec::readInteger(const std::vector<bool>& bitstream, size_t& pos, int numBits) {
+    uint32_t value = 0;
+    for (int i = 0; i < numBits && pos < bitstream.size(); i++) {
+        value = (value << 1) | (bitstream[pos++] ? 1 : 0);
+    }
+    return static_cast<int>(value);
+}
+
+// Read a two's complement integer of numBits bits
+int AudioCodec::readSignedInteger(const std::vector<bool>& bitstream, size_t& pos, int numBits) {
+    int64_t value = static_cast<uint32_t>(readInteger(bitstream, pos, numBits));
+    if ((value >> (numBits - 1)) & 1) {
+        value -= static_cast<int64_t>(1) << numBits;
+    }
+    return static_cast<int>(value);
+}
+
+// Write stream header
+void AudioCodec::writeHeader(std::vector<bool>& bitstream, const AudioInfo& info, int golombParam, bool adaptive,
+                             int frameSize, int delta, bool resync, bool wide, bool lossy) {
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    writeInteger(bitstream, info.sampleRate, 32);
+    writeInteger(bitstream, info.channels, 16);
+    writeInteger(bitstream, info.bitsPerSample, 16);
+    writeInteger(bitstream, info.numSamples, 32);
+    writeInteger(bitstream, golombParam, 16);
+    bitstream.push_back(adaptive);
+    writeInteger(bitstream, frameSize, 16);
+    writeInteger(bitstream, delta, 16);
+    bitstream.push_back(resync);
+    bitstream.push_back(wide);
+    bitstream.push_back(lossy);
+}
+
+// Read stream header
+void AudioCodec::readHeader(const std::vector<bool>& bitstream, size_t& pos, AudioInfo& info,
+                            int& golombParam, bool& adaptive, int& frameSize, int& delta, bool& resync,
+                            bool& wide, bool lossy) {
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    info.sampleRate = readInteger(bitstream, pos, 32);
+    info.channels = readInteger(bitstream, pos, 16);
+    info.bitsPerSample = readInteger(bitstream, pos, 16);
+    info.numSamples = readInteger(bitstream, pos, 32);
+    golombParam = readInteger(bitstream, pos, 16);
+    adaptive = pos < bitstream.size() && bitstream[pos++];
+    frameSize = readInteger(bitstream, pos, 16);
+    delta = readInteger(bitstream, pos, 16);
+    resync = pos < bitstream.size() && bitstream[pos++];
+    wide = pos < bitstream.size() && bitstream[pos++];
+    bool streamLossy = pos < bitstream.size() && bitstream[pos++];
+    if (streamLossy != lossy) {
+        throw std::invalid_argument(streamLossy ? "Lossy stream (use decodeLossy)" : "Not a lossy stream");
+    }
+}
+
+// Append one resynchronizable frame (FrameSync.h) holding payload
+void AudioCodec::writeSyncFrame(std::vector<bool>& bitstream, uint32_t frameNumber,
+                                const std::vector<bool>& payload) {
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    while (bitstream.size() % 8 != 0) {
+        bitstream.push_back(false);
+    }
+    
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    uint8_t header[FRAME_HEADER_BYTES] = {
+        static_cast<uint8_t>(FRAME_SYNC_CODE >> 8), static_cast<uint8_t>(FRAME_SYNC_CODE & 0xFF),
+        static_cast<uint8_t>(frameNumber >> 24), static_cast<uint8_t>(frameNumber >> 16),
+        static_cast<uint8_t>(frameNumber >> 8), static_cast<uint8_t>(frameNumber),
+        static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+        static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length), 0};
+    header[FRAME_HEADER_BYTES - 1] = crc8(header, FRAME_HEADER_BYTES - 1);
+    for (size_t i = 0; i < FRAME_HEADER_BYTES; i++) {
+        writeInteger(bitstream, header[i], 8);
+    }
+    
+    writeBits(bitstream, payload);
+    while (bitstream.size() % 8 != 0) {
+        bitstream.push_back(false);
+    }
+    std::vector<uint8_t> bytes;
+    packBits(payload, bytes);
+    writeInteger(bitstream, crc16(bytes.data(), bytes.size()), 16);
+}
+
+// Find the payload of every frame of a stream with sync codes, starting at
+// pos (the end of the stream header). payloads[f] is the bit position of
+// frame f's payload, or 0 if no intact copy of it was found. A candidate
+// must have a valid header CRC, an in-range frame number and a valid
+// payload CRC; otherwise the search resumes one byte after its sync code.
+void AudioCodec::locateSyncFrames(const std::vector<bool>& bitstream, size_t pos, size_t frameCount,
+                                  std::vector<size_t>& payloads) {
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    payloads.assign(frameCount, 0);
+    
+    std::vector<uint8_t> bytes;
+    packBits(bitstream, bytes);
+    size_t size = bytes.size();
+    size_t next = (pos + 7) / 8;
+    
+    while (true) {
+        size_t start = findSyncCode(bytes.data(), size, next);
+        if (start + FRAME_HEADER_BYTES > size) break;
+        next = start + 1;
+        
+        const uint8_t* header = bytes.data() + start;
+        if (crc8(header, FRAME_HEADER_BYTES - 1) != header[FRAME_HEADER_BYTES - 1]) continue;
+        uint32_t frameNumber = (static_cast<uint32_t>(header[2]) << 24) | (static_cast<uint32_t>(header[3]) << 16) |
+                               (static_cast<uint32_t>(header[4]) << 8) | header[5];
+        uint32_t length = (static_cast<uint32_t>(header[6]) << 24) | (static_cast<uint32_t>(header[7]) << 16) |
+                          (static_cast<uint32_t>(header[8]) << 8) | header[9];
+        size_t payloadBytes = (static_cast<size_t>(length) + 7) / 8;
+        size_t payloadStart = start + FRAME_HEADER_BYTES;
+        if (frameNumber >= frameCount || payloadBytes + FRAME_TRAILER_BYTES > size - payloadStart) continue;
+        
+        const uint8_t* trailer = bytes.data() + payloadStart + payloadBytes;
+        uint16_t storedCRC = static_cast<uint16_t>((trailer[0] << 8) | trailer[1]);
+        if (crc16(bytes.data() + payloadStart, payloadBytes) != storedCRC) continue;
+        
+        if (payloads[frameNumber] == 0) {
+            payloads[frameNumber] = payloadStart * 8;
+        }
+        next = payloadStart + payloadBytes + FRAME_TRAILER_BYTES;
+    }
+}
+
+// Reset per-stream statistics
+void AudioCodec::beginEncode() {
+    std::fill(subframeTypeCount, subframeTypeCount + SUBFRAME_TYPE_COUNT, 0);
+}
+
+// Fill in the sizes and statistics of a finished stream
+void AudioCodec::finishEncode(CompressedAudio& compressed) {
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    compressed.compressedSize = compressed.data.size();
+    compressed.compressionRatio = static_cast<double>(compressed.originalSize) / compressed.compressedSize;
+    compressed.golombParameter = defaultGolombParameter;
+    compressed.maxSampleError = nearLosslessDelta;
+    std::copy(subframeTypeCount, subframeTypeCount + SUBFRAME_TYPE_COUNT, compressed.subframeTypeCount);
+}
+
+// Main encoding function (mono or interleaved stereo)
+CompressedAudio AudioCodec::encode(const std::vector<int16_t>& audioData, const AudioInfo& info) {
+    return encode(std::vector<int32_t>(audioData.begin(), audioData.end()), info);
+}
+
+CompressedAudio AudioCodec::encode(const std::vector<int32_t>& audioData, const AudioInfo& info) {
+    CompressedAudio compressed;
+    compressed.info = info;
+    compressed.info.numSamples = audioData.size() / std::max<uint16_t>(info.channels, 1);
+    compressed.useAdaptiveParameter = adaptiveMode;
+    compressed.originalSize = audioData.size() * info.bitsPerSample; // in bits
+    bool wide = widerThanSource(audioData.data(), audioData.size(), info);
+    sampleRangeBits = sampleRange(info, wide);
+    
+    // Write header information to bitstream
+    beginEncode();
+    writeHeader(compressed.data, compressed.info, defaultGolombParameter, adaptiveMode, blockSize, nearLosslessDelta,
+                resyncFrames, wide, false);
+    
+    // Interleaved data is coded as a single sequence
+    int sampleBits = codedSampleBits(info);
+    size_t frameSize = static_cast<size_t>(blockSize);
+    
+    for (size_t start = 0; start < audioData.size(); start += frameSize) {
+        size_t n = std::min(frameSize, audioData.size() - start);
+        if (profile) profile->frames++;
+        if (trace) beginTraceFrame(start / frameSize, start, n);
+        size_t frameStart = compressed.data.size();
+        framePayload.clear();
+        encodeSubframe(resyncFrames ? framePayload : compressed.data, audioData.data() + start, n, sampleBits);
+        if (resyncFrames) {
+            writeSyncFrame(compressed.data, static_cast<uint32_t>(start / frameSize), framePayload);
+        }
+        if (trace) endTraceFrame(compressed.data.size() - frameStart);
+    }
+    
+    finishEncode(compressed);
+    
+    return compressed;
+}
+
+// Main decoding function (for streams of at most 16 bits per sample)
+std::vector<int16_t> AudioCodec::decode(const CompressedAudio& compressed, AudioInfo& info) {
+    std::vector<int32_t> samples;
+    decode(compressed, samples, info);
+    return std::vector<int16_t>(samples.begin(), samples.end());
+}
+
+void AudioCodec::decode(const CompressedAudio& compressed, std::vector<int32_t>& samples, AudioInfo& info) {
+    info = compressed.info;
+    
+    // Read header
+    size_t pos = 0;
+    int golombParam;
+    bool adaptive;
+    int frameSize;
+    int delta;
+    bool resync;
+    bool wide;
+    readHeader(compressed.data, pos, info, golombParam, adaptive, frameSize, delta, resync, wide, false);
+    sampleRangeBits = sampleRange(info, wide);
+    lostFrames = 0;
+    
+    int sampleBits = codedSampleBits(info);
+    size_t totalSamples = static_cast<size_t>(info.numSamples) * std::max<uint16_t>(info.channels, 1);
+    samples.assign(totalSamples, 0);
+    size_t decoded = 0;
+    
+    std::vector<size_t> payloads;
+    if (resync) {
+        locateSyncFrames(compressed.data, pos, frameSize > 0 ? (totalSamples + frameSize - 1) / frameSize : 0,
+                         payloads);
+    }
+    
+    for (size_t frame = 0; decoded < totalSamples && frameSize > 0; frame++) {
+        size_t n = std::min(static_cast<size_t>(frameSize), totalSamples - decoded);
+        if (profile) profile->frames++;
+        try {
+            if (resync) pos = payloads[frame];
+            if (pos == 0) throw std::invalid_argument("Frame lost");
+            decodeSubframe(compressed.data, pos, samples.data() + decoded, n,
+                           sampleBits, golombParam, adaptive, delta);
+        } catch (...) {
+            // Truncated stream: keep the frames decoded so far. With sync
+            // codes only this frame is lost, and it is left silent.
+            if (!resync) break;
+            std::fill(samples.begin() + decoded, samples.begin() + decoded + n, 0);
+            lostFrames++;
+        }
+        decoded += n;
+    }
+    
+    samples.resize(decoded);
+}
+
+// Stereo encoding with per-frame stereo decorrelation
+CompressedAudio AudioCodec::encodeStereo(const std::vector<int16_t>& leftChannel,
+                                         const std::vector<int16_t>& rightChannel,
+                                         const AudioInfo& info,
+                                         bool useInterChannelPrediction) {
+    return encodeStereo(std::vector<int32_t>(leftChannel.begin(), leftChannel.end()),
+                        std::vector<int32_t>(rightChannel.begin(), rightChannel.end()),
+                        info, useInterChannelPrediction);
+}
+
+CompressedAudio AudioCodec::encodeStereo(const std::vector<int32_t>& leftChannel,
+                                         const std::vector<int32_t>& rightChannel,
+                                         const AudioInfo& info,
+                                         bool useInterChannelPrediction) {
+    CompressedAudio compressed;
+    compressed.info = info;
+    compressed.info.channels = 2;
+    compressed.info.numSamples = std::min(leftChannel.size(), rightChannel.size());
+    compressed.useAdaptiveParameter = adaptiveMode;
+    compressed.originalSize = (leftChannel.size() + rightChannel.size()) * info.bitsPerSample;
+    bool wide = widerThanSource(leftChannel.data(), compressed.info.numSamples, info) ||
+                widerThanSource(rightChannel.data(), compressed.info.numSamples, info);
+    sampleRangeBits = sampleRange(info, wide);
+    
+    // Write header
+    beginEncode();
+    writeHeader(compressed.data, compressed.info, defaultGolombParameter, adaptiveMode, blockSize, nearLosslessDelta,
+                resyncFrames, wide, false);
+    compressed.data.push_back(useInterChannelPrediction);
+    
+    size_t numSamples = compressed.info.numSamples;
+    int sampleBits = codedSampleBits(info);
+    size_t frameSize = static_cast<size_t>(blockSize);
+    
+    for (size_t start = 0; start < numSamples; start += frameSize) {
+        size_t n = std::min(frameSize, numSamples - start);
+        if (profile) profile->frames++;
+        if (trace) beginTraceFrame(start / frameSize, start, n);
+        size_t frameStart = compressed.data.size();
+        framePayload.clear();
+        StereoMode mode = encodePairFrame(resyncFrames ? framePayload : compressed.data, leftChannel.data() + start,
+                                          rightChannel.data() + start, n, sampleBits, useInterChannelPrediction);
+        compressed.stereoModeCount[mode]++;
+        if (resyncFrames) {
+            writeSyncFrame(compressed.data, static_cast<uint32_t>(start / frameSize), framePayload);
+        }
+        if (trace) endTraceFrame(compressed.data.size() - frameStart);
+    }
+    
+    finishEncode(compressed);
+    
+    return compressed;
+}
+
+// Stereo decoding
+void AudioCodec::decodeStereo(const CompressedAudio& compressed,
+                              std::vector<int16_t>& leftChannel,
+                              std::vector<int16_t>& rightChannel,
+                              AudioInfo& info) {
+    std::vector<int32_t> left, right;
+    decodeStereo(compressed, left, right, info);
+    leftChannel.assign(left.begin(), left.end());
+    rightChannel.assign(right.begin(), right.end());
+}
+
+void AudioCodec::decodeStereo(const CompressedAudio& compressed,
+                              std::vector<int32_t>& leftChannel,
+                              std::vector<int32_t>& rightChannel,
+                              AudioInfo& info) {
+    // Read header
+    size_t pos = 0;
+    int golombParam;
+    bool adaptive;
+    int frameSize;
+    int delta;
+    bool resync;
+    bool wide;
+    readHeader(compressed.data, pos, info, golombParam, adaptive, frameSize, delta, resync, wide, false);
+    sampleRangeBits = sampleRange(info, wide);
+    lostFrames = 0;
+    bool useInterChannelPred = pos < compressed.data.size() && compressed.data[pos++];
+    
+    size_t numSamples = info.numSamples;
+    int sampleBits = codedSampleBits(info);
+    leftChannel.assign(numSamples, 0);
+    rightChannel.assign(numSamples, 0);
+    size_t decoded = 0;
+    
+    std::vector<size_t> payloads;
+    if (resync) {
+        locateSyncFrames(compressed.data, pos, frameSize > 0 ? (numSamples + frameSize - 1) / frameSize : 0,
+                         payloads);
+    }
+    
+    for (size_t frame = 0; decoded < numSamples && frameSize > 0; frame++) {
+        size_t n = std::min(static_cast<size_t>(frameSize), numSamples - decoded);
+        if (profile) profile->frames++;
+        try {
+            if (resync) pos = payloads[frame];
+            if (pos == 0) throw std::invalid_argument("Frame lost");
+            decodePairFrame(compressed.data, pos, leftChannel.data() + decoded, rightChannel.data() + decoded,
+                            n, sampleBits, useInterChannelPred, golombParam, adaptive, delta);
+        } catch (...) {
+            // Truncated stream: keep the frames decoded so far (a lost frame
+            // of a stream with sync codes is left silent)
+            if (!resync) break;
+            std::fill(leftChannel.begin() + decoded, leftChannel.begin() + decoded + n, 0);
+            std::fill(rightChannel.begin() + decoded, rightChannel.begin() + decoded + n, 0);
+            lostFrames++;
+        }
+        decoded += n;
+    }
+    
+    leftChannel.resize(decoded);
+    rightChannel.resize(decoded);
+}
+
+// Default channel pairing for common layouts
+std::vector<ChannelPair> AudioCodec::defaultChannelPairs(int channels) {
+    std::vector<ChannelPair> pairs;
+    fillDefaultChannelPairs(channels, pairs);
+    return pairs;
+}
+
+void AudioCodec::fillDefaultChannelPairs(int channels, std::vector<ChannelPair>& pairs) {
+    pairs.clear();
+    if (channels == 6 || channels == 8) {
+        // 5.1: FL FR FC LFE BL BR, 7.1: FL FR FC LFE BL BR SL SR
+        // (center and LFE correlate poorly with everything else)
+        pairs.push_back(ChannelPair(0, 1));
+        pairs.push_back(ChannelPair(4, 5));
+        if (channels == 8) {
+            pairs.push_back(ChannelPair(6, 7));
+        }
+    } else {
+        for (int c = 0; c + 1 < channels; c += 2) {
+            pairs.push_back(ChannelPair(c, c + 1));
+        }
+    }
+}
+
+// Validate the pairing and list the coding units: pairs first, then the
+// unpaired channels (second = -1) in channel order
+void AudioCodec::buildCodingUnits(int channels, const std::vector<ChannelPair>& pairs,
+                                  std::vector<ChannelPair>& units) {
+    if (channels > 255) {
+        throw std::invalid_argument("Unsupported number of channels");
+    }
+    bool used[255] = {false};
+    units.clear();
+    
+    for (size_t i = 0; i < pairs.size(); i++) {
+        int a = pairs[i].first;
+        int b = pairs[i].second;
+        if (a < 0 || b < 0 || a >= channels || b >= channels || a == b || used[a] || used[b]) {
+            throw std::invalid_argument("Invalid channel pairing");
+        }
+        used[a] = used[b] = true;
+        units.push_back(pairs[i]);
+    }
+    
+    for (int c = 0; c < channels; c++) {
+        if (!used[c]) {
+            units.push_back(ChannelPair(c, -1));
+        }
+    }
+}
+
+// Multichannel encoding with the default channel pairing
+CompressedAudio AudioCodec::encodeMultichannel(const std::vector<std::vector<int16_t> >& channels,
+                                               const AudioInfo& info) {
+    return encodeMultichannel(channels, info, defaultChannelPairs(static_cast<int>(channels.size())));
+}
+
+CompressedAudio AudioCodec::encodeMultichannel(const std::vector<std::vector<int32_t> >& channels,
+                                               const AudioInfo& info) {
+    return encodeMultichannel(channels, info, defaultChannelPairs(static_cast<int>(channels.size())));
+}
+
+// Multichannel encoding
+CompressedAudio AudioCodec::encodeMultichannel(const std::vector<std::vector<int16_t> >& channels,
+                                               const AudioInfo& info,
+                                               const std::vector<ChannelPair>& pairs) {
+    std::vector<std::vector<int32_t> > wide(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        wide[c].assign(channels[c].begin(), channels[c].end());
+    }
+    return encodeMultichannel(wide, info, pairs);
+}
+
+// Stream header, channel graph and (for edited streams) the frame table
+void AudioCodec::writeMultichannelHeader(std::vector<bool>& bitstream, const MultichannelLayout& layout) {
+    writeHeader(bitstream, layout.info, layout.golombParam, layout.adaptive, layout.frameSize, layout.delta,
+                layout.resync, layout.wide, false);
+    writeInteger(bitstream, static_cast<int>(layout.pairs.size()), 8);
+    for (size_t i = 0; i < layout.pairs.size(); i++) {
+        writeInteger(bitstream, layout.pairs[i].first, 8);
+        writeInteger(bitstream, layout.pairs[i].second, 8);
+    }
+    
+    bitstream.push_back(layout.hasFrameTable);
+    if (layout.hasFrameTable) {
+        writeInteger(bitstream, static_cast<int>(layout.frameSamples.size()), 32);
+        for (size_t f = 0; f < layout.frameSamples.size(); f++) {
+            writeInteger(bitstream, static_cast<int>(layout.frameSamples[f]), FRAME_TABLE_BITS);
+        }
+    }
+}
+
+void AudioCodec::readMultichannelHeader(const std::vector<bool>& bitstream, size_t& pos, MultichannelLayout& layout) {
+    readHeader(bitstream, pos, layout.info, layout.golombParam, layout.adaptive, layout.frameSize, layout.delta,
+               layout.resync, layout.wide, false);
+    layout.pairs.clear();
+    int numPairs = readInteger(bitstream, pos, 8);
+    for (int i = 0; i < numPairs; i++) {
+        int a = readInteger(bitstream, pos, 8);
+        int b = readInteger(bitstream, pos, 8);
+        layout.pairs.push_back(ChannelPair(a, b));
+    }
+    
+    layout.hasFrameTable = pos < bitstream.size() && bitstream[pos++];
+    layout.frameSamples.clear();
+    if (layout.hasFrameTable) {
+        size_t frameCount = static_cast<uint32_t>(readInteger(bitstream, pos, 32));
+        if (frameCount > bitstream.size() - std::min(pos, bitstream.size())) {
+            throw std::invalid_argument("Invalid frame table in stream");
+        }
+        for (size_t f = 0; f < frameCount; f++) {
+            layout.frameSamples.push_back(static_cast<size_t>(readInteger(bitstream, pos, FRAME_TABLE_BITS)));
+        }
+    } else if (layout.frameSize > 0) {
+        for (size_t start = 0; start < layout.info.numSamples; start += layout.frameSize) {
+            layout.frameSamples.push_back(std::min(static_cast<size_t>(layout.frameSize),
+                                                   layout.info.numSamples - start));
+        }
+    }
+}
+
+// One frame of every coding unit, each a length-prefixed substream
+void AudioCodec::encodeMultichannelFrame(std::vector<bool>& frameData, const int32_t* const* channels,
+                                         const std::vector<ChannelPair>& units, size_t start, size_t n,
+                                         int sampleBits, CompressedAudio& compressed) {
+    substream.clear();
+    for (size_t u = 0; u < units.size(); u++) {
+        if (units[u].second < 0) {
+            encodeSubframe(substream, channels[units[u].first] + start, n, sampleBits);
+        } else {
+            StereoMode mode = encodePairFrame(substream, channels[units[u].first] + start,
+                                              channels[units[u].second] + start, n, sampleBits, true);
+            compressed.stereoModeCount[mode]++;
+        }
+        
+        // Length prefix lets a decoder skip substreams it does not need
+        ProfileTimer timer(profile, PROFILE_OUTPUT);
+        writeInteger(frameData, static_cast<int>(substream.size()), 32);
+        writeBits(frameData, substream);
+        substream.clear();
+    }
+}
+
+void AudioCodec::decodeMultichannelFrame(const std::vector<bool>& bitstream, size_t& pos,
+                                         const MultichannelLayout& layout, const std::vector<ChannelPair>& units,
+                                         const std::vector<bool>& wanted, int32_t* const* samples, size_t offset,
+                                         size_t n) {
+    int sampleBits = codedSampleBits(layout.info);
+    sampleRangeBits = sampleRange(layout.info, layout.wide);
+    for (size_t u = 0; u < units.size(); u++) {
+        size_t length = static_cast<uint32_t>(readInteger(bitstream, pos, 32));
+        size_t next = pos + length;
+        int a = units[u].first;
+        int b = units[u].second;
+        
+        if (wanted[a] || (b >= 0 && wanted[b])) {
+            if (b < 0) {
+                decodeSubframe(bitstream, pos, samples[a] + offset, n, sampleBits, layout.golombParam,
+                               layout.adaptive, layout.delta);
+            } else {
+                decodePairFrame(bitstream, pos, samples[a] + offset, samples[b] + offset, n,
+                                sampleBits, true, layout.golombParam, layout.adaptive, layout.delta);
+            }
+        }
+        pos = next;
+    }
+}
+
+CompressedAudio AudioCodec::encodeMultichannel(const std::vector<std::vector<int32_t> >& channels,
+                                               const AudioInfo& info,
+                                               const std::vector<ChannelPair>& pairs) {
+    size_t numSamples = channels.empty() ? 0 : channels[0].size();
+    std::vector<const int32_t*> planes(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        numSamples = std::min(numSamples, channels[c].size());
+        planes[c] = channels[c].data();
+    }
+    CompressedAudio compressed;
+    SampleSpan span(planes.data(), numSamples, static_cast<uint16_t>(std::min<size_t>(channels.size(), 0xFFFF)));
+    encodeMultichannelSource(&span, NULL, info, pairs, compressed);
+    return compressed;
+}
+
+CompressedAudio AudioCodec::encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info,
+                                               const std::vector<ChannelPair>& pairs) {
+    CompressedAudio compressed;
+    encodeMultichannel(pcm, info, pairs, compressed);
+    return compressed;
+}
+
+CompressedAudio AudioCodec::encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info) {
+    return encodeMultichannel(pcm, info, defaultChannelPairs(pcm.channels));
+}
+
+void AudioCodec::encodeMultichannel(const SampleSpan& samples, const AudioInfo& info,
+                                    const std::vector<ChannelPair>& pairs, CompressedAudio& compressed) {
+    encodeMultichannelSource(&samples, NULL, info, pairs, compressed);
+}
+
+void AudioCodec::encodeMultichannel(const SampleSpan& samples, const AudioInfo& info, CompressedAudio& compressed) {
+    fillDefaultChannelPairs(samples.channels, defaultPairs);
+    encodeMultichannelSource(&samples, NULL, info, defaultPairs, compressed);
+}
+
+void AudioCodec::encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info,
+                                    const std::vector<ChannelPair>& pairs, CompressedAudio& compressed) {
+    if (pcm.channels != info.channels || pcm.bitsPerSample != info.bitsPerSample) {
+        throw std::invalid_argument("PCM span does not match the audio format");
+    }
+    encodeMultichannelSource(NULL, &pcm, info, pairs, compressed);
+}
+
+void AudioCodec::encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info, CompressedAudio& compressed) {
+    fillDefaultChannelPairs(pcm.channels, defaultPairs);
+    encodeMultichannel(pcm, info, defaultPairs, compressed);
+}
+
+void AudioCodec::encodeMultichannelSource(const SampleSpan* channels, const PCMSpan* pcm, const AudioInfo& info,
+                                          const std::vector<ChannelPair>& pairs, CompressedAudio& compressed) {
+    int numChannels = channels ? channels->channels : pcm->channels;
+    if (numChannels == 0 || numChannels > 255 || pairs.size() > 127) {
+        throw std::invalid_argument("Unsupported number of channels");
+    }
+    buildCodingUnits(numChannels, pairs, codingUnits);
+    size_t numSamples = channels ? channels->frames : pcm->frames;
+    
+    // Start afresh, keeping the capacity of the bit buffer
+    std::vector<bool> data;
+    data.swap(compressed.data);
+    compressed = CompressedAudio();
+    compressed.data.swap(data);
+    compressed.data.clear();
+    compressed.info = info;
+    compressed.info.channels = numChannels;
+    compressed.info.numSamples = numSamples;
+    compressed.useAdaptiveParameter = adaptiveMode;
+    compressed.originalSize = numSamples * numChannels * info.bitsPerSample;
+    
+    // Header and channel graph
+    MultichannelLayout& layout = layoutScratch;
+    layout.info = compressed.info;
+    layout.golombParam = defaultGolombParameter;
+    layout.adaptive = adaptiveMode;
+    layout.frameSize = blockSize;
+    layout.delta = nearLosslessDelta;
+    layout.resync = resyncFrames;
+    // PCM holds samples at the source depth
+    layout.wide = false;
+    for (int c = 0; channels && c < numChannels && !layout.wide; c++) {
+        layout.wide = widerThanSource(channels->data[c], numSamples, info);
+    }
+    sampleRangeBits = sampleRange(info, layout.wide);
+    layout.pairs = pairs;
+    layout.hasFrameTable = false;
+    layout.frameSamples.clear();
+    beginEncode();
+    writeMultichannelHeader(compressed.data, layout);
+    
+    int sampleBits = codedSampleBits(info);
+    size_t frameSize = static_cast<size_t>(blockSize);
+    if (pcm) {
+        frameSamples.resize(numChannels);
+        inputPlanes.resize(numChannels);
+        outputPlanes.resize(numChannels);
+        for (int c = 0; c < numChannels; c++) {
+            frameSamples[c].resize(std::min(frameSize, numSamples));
+            inputPlanes[c] = outputPlanes[c] = frameSamples[c].data();
+        }
+    }
+    
+    for (size_t start = 0; start < numSamples; start += frameSize) {
+        size_t n = std::min(frameSize, numSamples - start);
+        if (profile) profile->frames++;
+        if (trace) beginTraceFrame(start / frameSize, start, n);
+        size_t frameStart = compressed.data.size();
+        framePayload.clear();
+        if (pcm) {
+            ProfileTimer timer(profile, PROFILE_WAV_IO);
+            size_t bytesPerFrame = static_cast<size_t>(numChannels) * (pcm->bitsPerSample / 8);
+            deinterleavePcm(pcm->data + start * bytesPerFrame, outputPlanes.data(), n, numChannels, pcm->bitsPerSample);
+        }
+        encodeMultichannelFrame(resyncFrames ? framePayload : compressed.data,
+                                pcm ? inputPlanes.data() : channels->data, codingUnits, pcm ? 0 : start, n,
+                                sampleBits, compressed);
+        if (resyncFrames) {
+            writeSyncFrame(compressed.data, static_cast<uint32_t>(start / frameSize), framePayload);
+        }
+        if (trace) endTraceFrame(compressed.data.size() - frameStart);
+    }
+    
+    finishEncode(compressed);
+}
+
+// Multichannel decoding
+void AudioCodec::decodeMultichannel(const CompressedAudio& compressed,
+                                    std::vector<std::vector<int16_t> >& channels,
+                                    AudioInfo& info,
+                                    uint64_t channelMask) {
+    std::vector<std::vector<int32_t> > wide;
+    decodeMultichannel(compressed, wide, info, channelMask);
+    channels.assign(wide.size(), std::vector<int16_t>());
+    for (size_t c = 0; c < wide.size(); c++) {
+        channels[c].assign(wide[c].begin(), wide[c].end());
+    }
 }
 
-// Temporal prediction (order 1 by default)
-int16_t AudioCodec::predictTemporal(const std::vector<int16_t>& samples, size_t index, int order) {
-    if (index == 0) {
-        return 0; // No prediction for first sample
+void AudioCodec::decodeMultichannel(const CompressedAudio& compressed,
+                                    std::vector<std::vector<int32_t> >& channels,
+                                    AudioInfo& info,
+                                    uint64_t channelMask) {
+    size_t pos = 0;
+    MultichannelLayout& layout = layoutScratch;
+    readMultichannelHeader(compressed.data, pos, layout);
+    info = layout.info;
+    lostFrames = 0;
+    
+    int numChannels = info.channels;
+    buildCodingUnits(numChannels, layout.pairs, codingUnits);
+    const std::vector<ChannelPair>& units = codingUnits;
+    
+    std::vector<bool>& wanted = wantedChannels;
+    wanted.resize(numChannels);
+    for (int c = 0; c < numChannels; c++) {
+        wanted[c] = c >= 64 || ((channelMask >> c) & 1);
     }
     
-    if (order == 1) {
-        // First-order prediction: predict current sample as previous sample
-        return samples[index - 1];
-    } else if (order == 2 && index >= 2) {
-        // Second-order prediction: linear extrapolation
-        return 2 * samples[index - 1] - samples[index - 2];
-    } else if (order == 3 && index >= 3) {
-        // Third-order prediction
-        return 3 * samples[index - 1] - 3 * samples[index - 2] + samples[index - 3];
+    // Decoded in place (the other channel of a wanted pair too, as it is
+    // needed to undo the stereo decorrelation)
+    size_t numSamples = info.numSamples;
+    channels.resize(numChannels);
+    outputPlanes.resize(numChannels);
+    for (int c = 0; c < numChannels; c++) {
+        channels[c].resize(numSamples);
+        outputPlanes[c] = channels[c].data();
     }
+    size_t decoded = 0;
     
-    return samples[index - 1]; // Fallback to order 1
+    std::vector<size_t>& payloads = payloadScratch;
+    if (layout.resync) {
+        locateSyncFrames(compressed.data, pos, layout.frameSamples.size(), payloads);
+    }
+    
+    for (size_t frame = 0; frame < layout.frameSamples.size() && decoded < numSamples; frame++) {
+        size_t n = std::min(layout.frameSamples[frame], numSamples - decoded);
+        if (profile) profile->frames++;
+        try {
+            if (layout.resync) pos = payloads[frame];
+            if (pos == 0) throw std::invalid_argument("Frame lost");
+            decodeMultichannelFrame(compressed.data, pos, layout, units, wanted, outputPlanes.data(), decoded, n);
+        } catch (...) {
+            // Truncated stream: keep the frames decoded so far (a lost frame
+            // of a stream with sync codes is left silent)
+            if (!layout.resync) break;
+            for (int c = 0; c < numChannels; c++) {
+                std::fill(channels[c].begin() + decoded, channels[c].begin() + decoded + n, 0);
+            }
+            lostFrames++;
+        }
+        decoded += n;
+    }
+    
+    ProfileTimer timer(profile, PROFILE_OUTPUT);
+    for (int c = 0; c < numChannels; c++) {
+        channels[c].resize(wanted[c] ? decoded : 0);
+    }
 }
 
-// Inter-channel prediction for stereo
-int16_t AudioCodec::predictInterChannel(const std::vector<int16_t>& leftChannel, 
-                                        const std::vector<int16_t>& rightChannel, 
-                                        size_t index) {
-    // Predict right channel from left channel
-    // Simple approach: assume right channel is similar to left
-    if (index < leftChannel.size()) {
-        return leftChannel[index];
+// Locate the payload of every frame of a multichannel stream without
+// decoding it (from the sync frame headers, or by walking the substream
+// length prefixes). Throws std::invalid_argument for a damaged or truncated
+// stream, as a frame that cannot be found cannot be copied.
+void AudioCodec::locateMultichannelFrames(const CompressedAudio& compressed, MultichannelLayout& layout,
+                                          std::vector<size_t>& begins, std::vector<size_t>& ends) {
+    const std::vector<bool>& data = compressed.data;
+    size_t pos = 0;
+    readMultichannelHeader(data, pos, layout);
+    size_t frameCount = layout.frameSamples.size();
+    std::vector<ChannelPair> codingUnitList;
+    buildCodingUnits(layout.info.channels, layout.pairs, codingUnitList);
+    size_t units = codingUnitList.size();
+    begins.assign(frameCount, 0);
+    ends.assign(frameCount, 0);
+    
+    if (layout.resync) {
+        locateSyncFrames(data, pos, frameCount, begins);
+    }
+    for (size_t f = 0; f < frameCount; f++) {
+        if (layout.resync) {
+            if (begins[f] == 0) {
+                throw std::invalid_argument("Damaged frame in stream");
+            }
+            // The payload length is the last field of the sync frame header
+            size_t lengthPos = begins[f] - 40;
+            ends[f] = begins[f] + static_cast<uint32_t>(readInteger(data, lengthPos, 32));
+        } else {
+            begins[f] = pos;
+            for (size_t u = 0; u < units; u++) {
+                size_t length = static_cast<uint32_t>(readInteger(data, pos, 32));
+                pos += length;
+            }
+            if (pos > data.size()) {
+                throw std::invalid_argument("Truncated stream");
+            }
+            ends[f] = pos;
+        }
     }
-    return 0;
 }
 
-// Calculate optimal Golomb parameter based on residual statistics
-int AudioCodec::calculateOptimalParameter(const std::vector<int>& residuals, size_t windowSize) {
-    if (residuals.empty()) return defaultGolombParameter;
-    
-    // Calculate mean absolute value of residuals in a window
-    size_t start = residuals.size() > windowSize ? residuals.size() - windowSize : 0;
-    double sum = 0.0;
-    int count = 0;
-    
-    for (size_t i = start; i < residuals.size(); i++) {
-        sum += std::abs(residuals[i]);
-        count++;
+// Decode one frame and re-encode samples [from, to) of it as a frame of its
+// own, with the stream's own coding parameters and this codec's search effort
+void AudioCodec::reencodeFramePart(const std::vector<bool>& bitstream, size_t begin, const MultichannelLayout& layout,
+                                   size_t frameSamples, size_t from, size_t to, std::vector<bool>& payload) {
+    int numChannels = layout.info.channels;
+    std::vector<ChannelPair> units;
+    buildCodingUnits(numChannels, layout.pairs, units);
+    std::vector<bool> wanted(numChannels, true);
+    std::vector<std::vector<int32_t> > samples(numChannels, std::vector<int32_t>(frameSamples));
+    std::vector<int32_t*> planes(numChannels);
+    for (int c = 0; c < numChannels; c++) {
+        planes[c] = samples[c].data();
+    }
+    decodeMultichannelFrame(bitstream, begin, layout, units, wanted, planes.data(), 0, frameSamples);
+    for (int c = 0; c < numChannels; c++) {
+        planes[c] += from; // The kept part
     }
     
-    if (count == 0) return defaultGolombParameter;
+    // A fresh coder with the stream's settings and this codec's search
+    // effort; no profile or trace, so edits are not counted as encodes
+    AudioCodec coder(layout.golombParam, layout.adaptive, layout.frameSize);
+    coder.nearLosslessDelta = layout.delta;
+    coder.sampleRangeBits = sampleRange(layout.info, layout.wide);
+    coder.extraHighMode = extraHighMode;
+    coder.stereoSearch = stereoSearch;
+    coder.maxLPCOrder = maxLPCOrder;
+    coder.exhaustiveOrderSearch = exhaustiveOrderSearch;
+    coder.precisionSearch = precisionSearch;
+    coder.maxPartitionOrder = maxPartitionOrder;
+    coder.longTermPrediction = longTermPrediction;
+    coder.crossChannelPrediction = crossChannelPrediction;
+    CompressedAudio statistics;
+    payload.clear();
+    coder.encodeMultichannelFrame(payload, planes.data(), units, 0, to - from, codedSampleBits(layout.info),
+                                  statistics);
+}
+
+// Start and finish the trace record of one encoded frame
+void AudioCodec::beginTraceFrame(size_t frame, size_t start, size_t n) {
+    traceRecord.frame = frame;
+    traceRecord.start = start;
+    traceRecord.samples = n;
+    traceRecord.stereoModes.clear();
+    traceRecord.subframes.clear();
+    traceStart = std::chrono::steady_clock::now();
+}
+
+void AudioCodec::endTraceFrame(size_t bits) {
+    traceRecord.bits = bits;
+    traceRecord.encodeMicroseconds =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceStart).count();
+    trace->write(traceRecord);
+}
+
+// Write a multichannel stream made of existing frames. The frame table is
+// only written when the frames are not all of the stream's frame size.
+CompressedAudio AudioCodec::assembleMultichannel(const MultichannelLayout& layout,
+                                                 const std::vector<FramePiece>& pieces) {
+    MultichannelLayout output = layout;
+    output.frameSamples.clear();
+    output.hasFrameTable = false;
+    size_t numSamples = 0;
+    for (size_t f = 0; f < pieces.size(); f++) {
+        size_t expected = static_cast<size_t>(layout.frameSize);
+        if (pieces[f].samples > expected || (f + 1 < pieces.size() && pieces[f].samples != expected)) {
+            output.hasFrameTable = true;
+        }
+        output.frameSamples.push_back(pieces[f].samples);
+        numSamples += pieces[f].samples;
+    }
+    if (numSamples > 0xFFFFFFFFULL) {
+        throw std::invalid_argument("Edited stream is too long");
+    }
+    output.info.numSamples = static_cast<uint32_t>(numSamples);
     
-    double mean = sum / count;
+    CompressedAudio compressed;
+    compressed.info = output.info;
+    compressed.golombParameter = layout.golombParam;
+    compressed.useAdaptiveParameter = layout.adaptive;
+    compressed.maxSampleError = layout.delta;
+    compressed.originalSize = numSamples * output.info.channels * output.info.bitsPerSample;
+    writeMultichannelHeader(compressed.data, output);
     
-    // Estimate optimal m for Golomb coding
-    // For geometric distribution with parameter p, optimal m ≈ -1/log2(p)
-    // We estimate p from mean: mean ≈ (1-p)/p, so p ≈ 1/(1+mean)
-    if (mean > 0) {
-        double p = 1.0 / (1.0 + mean);
-        int m = static_cast<int>(std::max(1.0, -1.0 / std::log2(p)));
-        
-        // Clamp to reasonable range
-        m = std::max(1, std::min(m, 256));
-        return m;
+    std::vector<bool> payload;
+    for (size_t f = 0; f < pieces.size(); f++) {
+        std::vector<bool>::const_iterator first = pieces[f].data->begin() + pieces[f].begin;
+        std::vector<bool>::const_iterator last = pieces[f].data->begin() + pieces[f].end;
+        if (layout.resync) {
+            payload.assign(first, last);
+            writeSyncFrame(compressed.data, static_cast<uint32_t>(f), payload);
+        } else {
+            compressed.data.insert(compressed.data.end(), first, last);
+        }
     }
     
-    return defaultGolombParameter;
+    compressed.compressedSize = compressed.data.size();
+    compressed.compressionRatio = compressed.compressedSize > 0 ?
+        static_cast<double>(compressed.originalSize) / compressed.compressedSize : 0.0;
+    return compressed;
 }
 
-// Calculate residuals using temporal prediction
-std::vector<int> AudioCodec::calculateResiduals(const std::vector<int16_t>& samples) {
-    std::vector<int> residuals;
-    residuals.reserve(samples.size());
-    
-    for (size_t i = 0; i < samples.size(); i++) {
-        int16_t predicted = predictTemporal(samples, i, 2); // Use order 2 prediction
-        int residual = samples[i] - predicted;
-        residuals.push_back(residual);
+CompressedAudio AudioCodec::cutMultichannel(const CompressedAudio& compressed, size_t start, size_t end) {
+    MultichannelLayout layout;
+    std::vector<size_t> begins, ends;
+    locateMultichannelFrames(compressed, layout, begins, ends);
+    if (start > end || end > layout.info.numSamples) {
+        throw std::invalid_argument("Cut range outside the stream");
     }
     
-    return residuals;
+    // Whole frames are copied; only the frames holding start and end are
+    // decoded and re-encoded
+    std::vector<FramePiece> pieces;
+    std::vector<bool> edges[2];
+    int edgeCount = 0;
+    size_t frameStart = 0;
+    for (size_t f = 0; f < layout.frameSamples.size() && frameStart < end; f++) {
+        size_t frameEnd = frameStart + layout.frameSamples[f];
+        size_t from = std::max(start, frameStart);
+        size_t to = std::min(end, frameEnd);
+        if (from < to) {
+            if (from == frameStart && to == frameEnd) {
+                pieces.push_back(FramePiece(&compressed.data, begins[f], ends[f], to - from));
+            } else {
+                std::vector<bool>& edge = edges[edgeCount++];
+                reencodeFramePart(compressed.data, begins[f], layout, layout.frameSamples[f], from - frameStart,
+                                  to - frameStart, edge);
+                pieces.push_back(FramePiece(&edge, 0, edge.size(), to - from));
+            }
+        }
+        frameStart = frameEnd;
+    }
+    return assembleMultichannel(layout, pieces);
 }
 
-// Reconstruct samples from residuals
-std::vector<int16_t> AudioCodec::reconstructFromResiduals(const std::vector<int>& residuals, 
-                                                          const std::vector<int16_t>& original, 
-                                                          size_t numSamples) {
-    std::vector<int16_t> reconstructed;
-    reconstructed.reserve(numSamples);
+static bool sameChannelPairs(const std::vector<ChannelPair>& a, const std::vector<ChannelPair>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].first != b[i].first || a[i].second != b[i].second) return false;
+    }
+    return true;
+}
+
+CompressedAudio AudioCodec::concatenateMultichannel(const CompressedAudio& first, const CompressedAudio& second) {
+    MultichannelLayout layout, secondLayout;
+    std::vector<size_t> begins, ends, secondBegins, secondEnds;
+    locateMultichannelFrames(first, layout, begins, ends);
+    locateMultichannelFrames(second, secondLayout, secondBegins, secondEnds);
     
-    for (size_t i = 0; i < numSamples && i < residuals.size(); i++) {
-        int16_t predicted = predictTemporal(reconstructed, i, 1);
-        int16_t sample = predicted + residuals[i];
-        reconstructed.push_back(sample);
+    const AudioInfo& a = layout.info;
+    const AudioInfo& b = secondLayout.info;
+    if (a.sampleRate != b.sampleRate || a.channels != b.channels || a.bitsPerSample != b.bitsPerSample ||
+        layout.adaptive != secondLayout.adaptive || layout.delta != secondLayout.delta ||
+        (layout.delta > 0 && layout.wide != secondLayout.wide) ||
+        (!layout.adaptive && layout.golombParam != secondLayout.golombParam) ||
+        !sameChannelPairs(layout.pairs, secondLayout.pairs)) {
+        throw std::invalid_argument("Streams have incompatible parameters");
     }
     
-    return reconstructed;
+    std::vector<FramePiece> pieces;
+    for (size_t f = 0; f < layout.frameSamples.size(); f++) {
+        pieces.push_back(FramePiece(&first.data, begins[f], ends[f], layout.frameSamples[f]));
+    }
+    for (size_t f = 0; f < secondLayout.frameSamples.size(); f++) {
+        pieces.push_back(FramePiece(&second.data, secondBegins[f], secondEnds[f], secondLayout.frameSamples[f]));
+    }
+    // An empty first stream contributes nothing, not even its frame size
+    return assembleMultichannel(layout.frameSamples.empty() ? secondLayout : layout, pieces);
 }
 
-// Write bits to bitstream
-void AudioCodec::writeBits(std::vector<bool>& bitstream, const std::vector<bool>& bits) {
-    bitstream.insert(bitstream.end(), bits.begin(), bits.end());
+CompressedAudio AudioCodec::spliceMultichannel(const CompressedAudio& target, size_t start, size_t end,
+                                               const CompressedAudio& insert) {
+    size_t pos = 0;
+    MultichannelLayout layout;
+    readMultichannelHeader(target.data, pos, layout);
+    CompressedAudio head = cutMultichannel(target, 0, start);
+    CompressedAudio tail = cutMultichannel(target, end, layout.info.numSamples);
+    return concatenateMultichannel(concatenateMultichannel(head, insert), tail);
 }
 
-// Write integer with fixed number of bits
-void AudioCodec::writeInteger(std::vector<bool>& bitstream, int value, int numBits) {
-    for (int i = numBits - 1; i >= 0; i--) {
-        bitstream.push_back((value >> i) & 1);
+// Hybrid mode: the correction of one channel of one frame (original minus
+// near-lossless sample, within +/- delta) is coded in whichever of three
+// forms is smallest: nothing if every difference is zero (constant and
+// verbatim subframes are exact), Golomb codes, or a fixed width covering
+// 0..2 * delta (the differences are close to uniform in busy frames)
+size_t AudioCodec::codeCorrection(const std::vector<int64_t>& differences, int delta,
+                                  std::vector<bool>* bitstream) {
+    bool exact = true;
+    for (size_t i = 0; i < differences.size() && exact; i++) {
+        exact = differences[i] == 0;
+    }
+    if (exact) {
+        if (bitstream) writeInteger(*bitstream, CORRECTION_ZERO, CORRECTION_MODE_BITS);
+        return CORRECTION_MODE_BITS;
+    }
+    
+    int width = correctionWidth(delta);
+    size_t fixedBits = differences.size() * width;
+    int param = calculateOptimalParameter(differences.data(), differences.size());
+    golomb.setParameter(param);
+    size_t golombBits = parameterBits(param);
+    for (size_t i = 0; i < differences.size(); i++) {
+        golombBits += golomb.codeLengthInterleaving(differences[i]);
+    }
+    
+    if (golombBits < fixedBits) {
+        if (bitstream) {
+            writeInteger(*bitstream, CORRECTION_GOLOMB, CORRECTION_MODE_BITS);
+            writeGolombParameter(*bitstream, param);
+            for (size_t i = 0; i < differences.size(); i++) {
+                golomb.encodeInterleaving(differences[i], *bitstream);
+            }
+        }
+        return CORRECTION_MODE_BITS + golombBits;
     }
+    if (bitstream) {
+        writeInteger(*bitstream, CORRECTION_FIXED, CORRECTION_MODE_BITS);
+        for (size_t i = 0; i < differences.size(); i++) {
+            writeInteger(*bitstream, static_cast<int>(differences[i] + delta), width);
+        }
+    }
+    return CORRECTION_MODE_BITS + fixedBits;
 }
 
-// Read integer from bitstream
-int AudioCodec::readInteger(const std::vector<bool>& bitstream, size_t& pos, int numBits) {
-    int value = 0;
-    for (int i = 0; i < numBits && pos < bitstream.size(); i++) {
-        value = (value << 1) | (bitstream[pos++] ? 1 : 0);
+// Add the correction of one channel of one frame to its samples
+void AudioCodec::readCorrection(const std::vector<bool>& bitstream, size_t& pos, int delta, int32_t* samples,
+                                size_t n) {
+    int mode = readInteger(bitstream, pos, CORRECTION_MODE_BITS);
+    if (mode == CORRECTION_ZERO) return;
+    if (mode == CORRECTION_GOLOMB) {
+        golomb.setParameter(readGolombParameter(bitstream, pos));
+        for (size_t i = 0; i < n; i++) {
+            samples[i] += static_cast<int32_t>(golomb.decodeInterleaving(bitstream, pos));
+        }
+    } else if (mode == CORRECTION_FIXED) {
+        int width = correctionWidth(delta);
+        for (size_t i = 0; i < n; i++) {
+            samples[i] += readInteger(bitstream, pos, width) - delta;
+        }
+    } else {
+        throw std::invalid_argument("Invalid correction mode in stream");
     }
-    return value;
 }
 
-// Main encoding function (mono or interleaved stereo)
-CompressedAudio AudioCodec::encode(const std::vector<int16_t>& audioData, const AudioInfo& info) {
+// CRC-16 of a whole stream, packed into bytes, to tie a correction stream
+// to its main stream
+static uint16_t streamChecksum(const std::vector<bool>& bitstream) {
+    std::vector<uint8_t> bytes;
+    packBits(bitstream, bytes);
+    return crc16(bytes.data(), bytes.size());
+}
+
+// The main stream is an ordinary near-lossless multichannel stream. The
+// samples it decodes to are recovered by decoding it, so the correction
+// is exactly what the decoder will be missing.
+CompressedAudio AudioCodec::encodeHybrid(const std::vector<std::vector<int32_t> >& channels, const AudioInfo& info,
+                                         int delta, CompressedAudio& correction) {
+    if (delta < 1 || delta > 65535) {
+        throw std::invalid_argument("Hybrid delta must be between 1 and 65535");
+    }
+    int previousDelta = nearLosslessDelta;
+    nearLosslessDelta = delta;
     CompressedAudio compressed;
-    compressed.info = info;
-    compressed.useAdaptiveParameter = false; // Disable adaptive for now
-    compressed.originalSize = audioData.size() * sizeof(int16_t) * 8; // in bits
+    try {
+        compressed = encodeMultichannel(channels, info);
+    } catch (...) {
+        nearLosslessDelta = previousDelta;
+        throw;
+    }
+    nearLosslessDelta = previousDelta;
     
-    // Calculate residuals
-    std::vector<int> residuals = calculateResiduals(audioData);
+    std::vector<std::vector<int32_t> > approximate;
+    AudioInfo decodedInfo;
+    decodeMultichannel(compressed, approximate, decodedInfo);
     
-    // Write header information to bitstream
-    writeInteger(compressed.data, info.sampleRate, 32);
-    writeInteger(compressed.data, info.channels, 16);
-    writeInteger(compressed.data, info.bitsPerSample, 16);
-    writeInteger(compressed.data, info.numSamples, 32);
-    writeInteger(compressed.data, defaultGolombParameter, 16);
-    compressed.data.push_back(false); // Always non-adaptive
+    correction = CompressedAudio();
+    correction.info = compressed.info;
+    correction.useAdaptiveParameter = true;
+    correction.originalSize = compressed.originalSize;
     
-    // Encode residuals
-    golomb.setParameter(defaultGolombParameter);
+    // Header: the size and CRC-16 of the main stream (to catch a mismatched
+    // pair), then the layout needed to walk the frames
+    std::vector<bool>& data = correction.data;
+    writeInteger(data, static_cast<int>(static_cast<uint32_t>(compressed.compressedSize)), 32);
+    writeInteger(data, streamChecksum(compressed.data), 16);
+    writeInteger(data, compressed.info.channels, 16);
+    writeInteger(data, compressed.info.numSamples, 32);
+    writeInteger(data, blockSize, 16);
+    writeInteger(data, delta, 16);
     
-    for (size_t i = 0; i < residuals.size(); i++) {
-        // Encode residual using interleaving method (handles negative values)
-        std::vector<bool> encoded = golomb.encodeInterleaving(residuals[i]);
-        writeBits(compressed.data, encoded);
+    size_t numSamples = compressed.info.numSamples;
+    size_t frameSize = static_cast<size_t>(blockSize);
+    std::vector<int64_t> differences;
+    for (size_t start = 0; start < numSamples; start += frameSize) {
+        size_t n = std::min(frameSize, numSamples - start);
+        for (size_t c = 0; c < approximate.size(); c++) {
+            differences.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                differences[i] = static_cast<int64_t>(channels[c][start + i]) - approximate[c][start + i];
+            }
+            codeCorrection(differences, delta, &data);
+        }
     }
     
-    compressed.compressedSize = compressed.data.size();
-    compressed.compressionRatio = static_cast<double>(compressed.originalSize) / compressed.compressedSize;
-    compressed.golombParameter = defaultGolombParameter;
-    
+    correction.compressedSize = data.size();
+    correction.compressionRatio = static_cast<double>(correction.originalSize) / correction.compressedSize;
+    correction.golombParameter = defaultGolombParameter;
     return compressed;
 }
 
-// Main decoding function
-std::vector<int16_t> AudioCodec::decode(const CompressedAudio& compressed, AudioInfo& info) {
-    info = compressed.info;
-    
-    // Read header
+CompressedAudio AudioCodec::encodeHybrid(const std::vector<std::vector<int16_t> >& channels, const AudioInfo& info,
+                                         int delta, CompressedAudio& correction) {
+    std::vector<std::vector<int32_t> > wide(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        wide[c].assign(channels[c].begin(), channels[c].end());
+    }
+    return encodeHybrid(wide, info, delta, correction);
+}
+
+void AudioCodec::decodeHybrid(const CompressedAudio& compressed, const CompressedAudio& correction,
+                              std::vector<std::vector<int32_t> >& channels, AudioInfo& info) {
+    const std::vector<bool>& data = correction.data;
     size_t pos = 0;
-    uint32_t sampleRate = readInteger(compressed.data, pos, 32);
-    uint16_t channels = readInteger(compressed.data, pos, 16);
-    uint16_t bitsPerSample = readInteger(compressed.data, pos, 16);
-    uint32_t numSamples = readInteger(compressed.data, pos, 32);
-    int golombParam = readInteger(compressed.data, pos, 16);
-    bool adaptive = compressed.data[pos++];
-    
-    info.sampleRate = sampleRate;
-    info.channels = channels;
-    info.bitsPerSample = bitsPerSample;
-    info.numSamples = numSamples;
-    
-    // Decode residuals
-    std::vector<int> residuals;
-    residuals.reserve(numSamples);
-    
-    golomb.setParameter(golombParam);
-    golomb.setParameter(golombParam);
-    
-    size_t sampleCount = 0;
-    while (sampleCount < numSamples && pos < compressed.data.size()) {
-        // Decode residual
-        std::vector<bool> encodedBits;
-        
-        // Read unary part: read until we hit a '1'
-        while (pos < compressed.data.size() && !compressed.data[pos]) {
-            encodedBits.push_back(false);
-            pos++;
+    uint32_t mainSize = static_cast<uint32_t>(readInteger(data, pos, 32));
+    uint16_t mainChecksum = static_cast<uint16_t>(readInteger(data, pos, 16));
+    int numChannels = readInteger(data, pos, 16);
+    size_t numSamples = static_cast<uint32_t>(readInteger(data, pos, 32));
+    size_t frameSize = static_cast<size_t>(readInteger(data, pos, 16));
+    int delta = readInteger(data, pos, 16);
+    if (mainSize != static_cast<uint32_t>(compressed.data.size()) ||
+        mainChecksum != streamChecksum(compressed.data)) {
+        throw std::invalid_argument("Correction stream does not belong to this main stream");
+    }
+    
+    decodeMultichannel(compressed, channels, info);
+    if (numChannels != info.channels || numSamples != info.numSamples || frameSize == 0) {
+        throw std::invalid_argument("Correction stream does not match the main stream layout");
+    }
+    
+    try {
+        for (size_t start = 0; start < numSamples; start += frameSize) {
+            size_t n = std::min(frameSize, numSamples - start);
+            for (int c = 0; c < numChannels; c++) {
+                if (start + n > channels[c].size()) return; // Main stream truncated
+                readCorrection(data, pos, delta, channels[c].data() + start, n);
+            }
         }
-        if (pos < compressed.data.size()) {
-            encodedBits.push_back(true); // Terminator
-            pos++;
+    } catch (...) {
+        // Truncated correction: the remaining frames keep the near-lossless samples
+    }
+}
+
+void AudioCodec::decodeHybrid(const CompressedAudio& compressed, const CompressedAudio& correction,
+                              std::vector<std::vector<int16_t> >& channels, AudioInfo& info) {
+    std::vector<std::vector<int32_t> > wide;
+    decodeHybrid(compressed, correction, wide, info);
+    channels.assign(wide.size(), std::vector<int16_t>());
+    for (size_t c = 0; c < wide.size(); c++) {
+        channels[c].assign(wide[c].begin(), wide[c].end());
+    }
+}
+
+// Choose the step of every band of one block and quantize it. The masking
+// threshold of a band is its own RMS or a fraction of a neighbour's,
+// whichever is larger (lower bands mask higher ones more); the step keeps
+// the quantization noise a quality-dependent margin below it, but never
+// below a floor that rises towards high frequencies. Bands above a cutoff
+// (4 kHz at quality 0 to 20 kHz at 100) are not coded.
+void AudioCodec::quantizeLossyBlock(const std::vector<double>& coefficients, double fullScale, uint32_t sampleRate,
+                                    int quality, std::vector<int>& scaleFactors, std::vector<int64_t>& quantized,
+                                    int& bandCount) {
+    std::vector<double> rms(LOSSY_BAND_COUNT);
+    for (int b = 0; b < LOSSY_BAND_COUNT; b++) {
+        double energy = 0.0;
+        for (size_t k = LOSSY_BAND_EDGES[b]; k < LOSSY_BAND_EDGES[b + 1]; k++) {
+            energy += coefficients[k] * coefficients[k];
         }
+        rms[b] = std::sqrt(energy / (LOSSY_BAND_EDGES[b + 1] - LOSSY_BAND_EDGES[b]));
+    }
+    
+    // Noise-to-mask margin and absolute floor, both from the quality
+    double margin = std::pow(10.0, -(quality * 0.45) / 20.0) * std::sqrt(12.0);
+    double floor = fullScale * std::pow(10.0, -(50.0 + quality * 0.5) / 20.0);
+    double cutoff = 4000.0 + quality * 160.0;
+    double bandwidth = sampleRate / (2.0 * coefficients.size()); // Hz per coefficient
+    
+    scaleFactors.assign(LOSSY_BAND_COUNT, 0);
+    quantized.assign(coefficients.size(), 0);
+    bandCount = 0;
+    for (int b = 0; b < LOSSY_BAND_COUNT && LOSSY_BAND_EDGES[b] * bandwidth < cutoff; b++) {
+        double mask = rms[b];
+        if (b > 0) mask = std::max(mask, 0.3 * rms[b - 1]);
+        if (b + 1 < LOSSY_BAND_COUNT) mask = std::max(mask, 0.1 * rms[b + 1]);
         
-        // Binary part: read b or b-1 bits
-        int b = static_cast<int>(std::ceil(std::log2(golombParam)));
-        int bitsToRead = b; // Maximum bits needed
-        for (int i = 0; i < bitsToRead && pos < compressed.data.size(); i++) {
-            encodedBits.push_back(compressed.data[pos++]);
-        }
+        double ratio = (LOSSY_BAND_EDGES[b] + LOSSY_BAND_EDGES[b + 1]) * 0.5 * bandwidth / 12000.0;
+        double step = std::max(mask * margin, floor * (1.0 + 30.0 * ratio * ratio * ratio * ratio));
         
-        try {
-            int residual = golomb.decodeInterleaving(encodedBits);
-            residuals.push_back(residual);
-            sampleCount++;
-        } catch (...) {
-            // If decode fails, we might have read too many bits
-            break;
+        int scale = static_cast<int>(std::ceil(4.0 * std::log(std::max(step, 1.0)) / std::log(2.0)));
+        scale = std::min(scale, (1 << LOSSY_SCALE_BITS) - 1);
+        scaleFactors[b] = scale;
+        
+        // Rounding slightly towards zero: small values cost more than they add
+        double inverse = 1.0 / std::pow(2.0, scale / 4.0);
+        for (size_t k = LOSSY_BAND_EDGES[b]; k < LOSSY_BAND_EDGES[b + 1]; k++) {
+            double value = std::fabs(coefficients[k]) * inverse + 0.4;
+            int64_t q = static_cast<int64_t>(value);
+            quantized[k] = coefficients[k] < 0 ? -q : q;
+            if (q != 0) bandCount = b + 1;
         }
     }
+}
+
+// Block layout: number of coded bands (the rest are zero), the first scale
+// factor and differences for the others, then one Golomb parameter and the
+// quantized coefficients of the coded bands. Returns the size in bits, and
+// writes the block if bitstream is not NULL.
+size_t AudioCodec::codeLossyBlock(const std::vector<int>& scaleFactors, const std::vector<int64_t>& quantized,
+                                  int bandCount, std::vector<bool>* bitstream) {
+    size_t bits = LOSSY_BAND_COUNT_BITS;
+    if (bitstream) writeInteger(*bitstream, bandCount, LOSSY_BAND_COUNT_BITS);
+    if (bandCount == 0) return bits;
+    
+    bits += LOSSY_SCALE_BITS;
+    if (bitstream) writeInteger(*bitstream, scaleFactors[0], LOSSY_SCALE_BITS);
+    golomb.setParameter(LOSSY_SCALE_PARAMETER);
+    for (int b = 1; b < bandCount; b++) {
+        int64_t difference = scaleFactors[b] - scaleFactors[b - 1];
+        if (bitstream) golomb.encodeInterleaving(difference, *bitstream);
+        bits += golomb.codeLengthInterleaving(difference);
+    }
     
-    // Reconstruct audio samples from residuals
-    std::vector<int16_t> reconstructed;
-    reconstructed.reserve(numSamples);
+    size_t count = LOSSY_BAND_EDGES[bandCount];
+    int param = calculateOptimalParameter(quantized.data(), count);
+    if (bitstream) writeGolombParameter(*bitstream, param);
+    bits += parameterBits(param);
+    golomb.setParameter(param);
+    for (size_t k = 0; k < count; k++) {
+        if (bitstream) golomb.encodeInterleaving(quantized[k], *bitstream);
+        bits += golomb.codeLengthInterleaving(quantized[k]);
+    }
+    return bits;
+}
+
+// Exact coded size of one block of every channel at a quality (the cost
+// estimate the rate control looks ahead with)
+size_t AudioCodec::lossyBlockBits(const std::vector<std::vector<double> >& coefficients, double fullScale,
+                                  uint32_t sampleRate, int quality) {
+    std::vector<int> scaleFactors;
+    std::vector<int64_t> quantized;
+    size_t bits = 0;
+    for (size_t c = 0; c < coefficients.size(); c++) {
+        int bandCount;
+        quantizeLossyBlock(coefficients[c], fullScale, sampleRate, quality, scaleFactors, quantized, bandCount);
+        bits += codeLossyBlock(scaleFactors, quantized, bandCount, NULL);
+    }
+    return bits;
+}
+
+void AudioCodec::readLossyBlock(const std::vector<bool>& bitstream, size_t& pos, std::vector<double>& coefficients) {
+    std::fill(coefficients.begin(), coefficients.end(), 0.0);
+    int bandCount = readInteger(bitstream, pos, LOSSY_BAND_COUNT_BITS);
+    if (bandCount > LOSSY_BAND_COUNT || LOSSY_BAND_EDGES[bandCount] > coefficients.size()) {
+        throw std::invalid_argument("Invalid band count in stream");
+    }
+    if (bandCount == 0) return;
     
-    for (size_t i = 0; i < residuals.size(); i++) {
-        int16_t predicted = predictTemporal(reconstructed, i, 2); // Use order 2 prediction
-        int16_t sample = predicted + residuals[i];
-        reconstructed.push_back(sample);
+    std::vector<int> scaleFactors(bandCount);
+    scaleFactors[0] = readInteger(bitstream, pos, LOSSY_SCALE_BITS);
+    golomb.setParameter(LOSSY_SCALE_PARAMETER);
+    for (int b = 1; b < bandCount; b++) {
+        scaleFactors[b] = scaleFactors[b - 1] + static_cast<int>(golomb.decodeInterleaving(bitstream, pos));
+        if (scaleFactors[b] < 0 || scaleFactors[b] >= (1 << LOSSY_SCALE_BITS)) {
+            throw std::invalid_argument("Invalid scale factor in stream");
+        }
     }
     
-    return reconstructed;
+    golomb.setParameter(readGolombParameter(bitstream, pos));
+    for (int b = 0; b < bandCount; b++) {
+        double step = std::pow(2.0, scaleFactors[b] / 4.0);
+        for (size_t k = LOSSY_BAND_EDGES[b]; k < LOSSY_BAND_EDGES[b + 1]; k++) {
+            coefficients[k] = static_cast<double>(golomb.decodeInterleaving(bitstream, pos)) * step;
+        }
+    }
 }
 
-// Stereo encoding with inter-channel prediction
-CompressedAudio AudioCodec::encodeStereo(const std::vector<int16_t>& leftChannel,
-                                         const std::vector<int16_t>& rightChannel,
-                                         const AudioInfo& info,
-                                         bool useInterChannelPrediction) {
+// Blocks advance by LOSSY_BLOCK_SIZE samples and span twice that, starting
+// one block before the signal (zeros outside it), so every sample is
+// covered by two blocks. The blocks of all channels are interleaved.
+CompressedAudio AudioCodec::encodeLossy(const std::vector<std::vector<int32_t> >& channels, const AudioInfo& info) {
+    size_t numSamples = channels.empty() ? 0 : channels[0].size();
+    for (size_t c = 1; c < channels.size(); c++) {
+        numSamples = std::min(numSamples, channels[c].size());
+    }
     CompressedAudio compressed;
     compressed.info = info;
-    compressed.useAdaptiveParameter = adaptiveMode;
-    compressed.originalSize = (leftChannel.size() + rightChannel.size()) * sizeof(int16_t) * 8;
-    
-    // Write header
-    writeInteger(compressed.data, info.sampleRate, 32);
-    writeInteger(compressed.data, info.channels, 16);
-    writeInteger(compressed.data, info.bitsPerSample, 16);
-    writeInteger(compressed.data, info.numSamples, 32);
-    writeInteger(compressed.data, defaultGolombParameter, 16);
-    compressed.data.push_back(adaptiveMode);
-    compressed.data.push_back(useInterChannelPrediction);
-    
-    // Encode left channel (temporal prediction only)
-    std::vector<int> leftResiduals = calculateResiduals(leftChannel);
-    
-    golomb.setParameter(defaultGolombParameter);
-    for (size_t i = 0; i < leftResiduals.size(); i++) {
-        std::vector<bool> encoded = golomb.encodeInterleaving(leftResiduals[i]);
-        writeBits(compressed.data, encoded);
+    compressed.info.channels = static_cast<uint16_t>(channels.size());
+    compressed.info.numSamples = static_cast<uint32_t>(numSamples);
+    compressed.useAdaptiveParameter = true;
+    compressed.originalSize = numSamples * channels.size() * info.bitsPerSample;
+    bool wide = false;
+    for (size_t c = 0; c < channels.size() && !wide; c++) {
+        wide = widerThanSource(channels[c].data(), numSamples, info);
     }
     
-    // Encode right channel
-    std::vector<int> rightResiduals;
-    rightResiduals.reserve(rightChannel.size());
+    beginEncode();
+    writeHeader(compressed.data, compressed.info, defaultGolombParameter, true, blockSize, nearLosslessDelta, false,
+                wide, true);
+    writeInteger(compressed.data, static_cast<int>(LOSSY_BLOCK_SIZE), 16);
     
-    if (useInterChannelPrediction) {
-        // Use both temporal and inter-channel prediction
-        for (size_t i = 0; i < rightChannel.size(); i++) {
-            int16_t temporalPred = predictTemporal(rightChannel, i, 1);
-            int16_t interChannelPred = predictInterChannel(leftChannel, rightChannel, i);
-            // Average both predictions
-            int16_t predicted = (temporalPred + interChannelPred) / 2;
-            int residual = rightChannel[i] - predicted;
-            rightResiduals.push_back(residual);
-        }
-    } else {
-        rightResiduals = calculateResiduals(rightChannel);
-    }
+    // Levels are relative to the full scale of the source bit depth
+    double fullScale = std::ldexp(static_cast<double>(LOSSY_BLOCK_SIZE) / 2.0,
+                                  std::max<int>(info.bitsPerSample, 8) - 1);
     
-    for (size_t i = 0; i < rightResiduals.size(); i++) {
-        std::vector<bool> encoded = golomb.encodeInterleaving(rightResiduals[i]);
-        writeBits(compressed.data, encoded);
-    }
+    MDCT transform(LOSSY_BLOCK_SIZE);
+    size_t blocks = numSamples == 0 ? 0 : (numSamples + LOSSY_BLOCK_SIZE - 1) / LOSSY_BLOCK_SIZE + 1;
+    std::vector<double> block(2 * LOSSY_BLOCK_SIZE);
+    std::vector<std::vector<double> > coefficients(channels.size(), std::vector<double>(LOSSY_BLOCK_SIZE));
+    std::vector<int> scaleFactors;
+    std::vector<int64_t> quantized;
     
-    compressed.compressedSize = compressed.data.size();
-    compressed.compressionRatio = static_cast<double>(compressed.originalSize) / compressed.compressedSize;
-    compressed.golombParameter = defaultGolombParameter;
+    // Rate control: a leaky bucket drained at the target rate every block.
+    // It starts half full, the level the budget steers towards, so the
+    // stream as a whole averages the target rate.
+    bool rateControlled = targetBitrate > 0.0 && info.sampleRate > 0;
+    RateControlStats& stats = compressed.rateControl;
+    double drain = rateControlled ? targetBitrate * 1000.0 * LOSSY_BLOCK_SIZE / info.sampleRate : 0.0;
+    double bufferSize = targetBitrate * 1000.0 * bufferSeconds;
+    double buffer = bufferSize / 2.0;
+    double bufferSum = 0.0;
+    double qualitySum = 0.0;
+    stats.minQuality = lossyQuality;
     
-    return compressed;
-}
-
-// Stereo decoding
-void AudioCodec::decodeStereo(const CompressedAudio& compressed,
-                              std::vector<int16_t>& leftChannel,
-                              std::vector<int16_t>& rightChannel,
-                              AudioInfo& info) {
-    // Read header
-    size_t pos = 0;
-    uint32_t sampleRate = readInteger(compressed.data, pos, 32);
-    uint16_t channels = readInteger(compressed.data, pos, 16);
-    uint16_t bitsPerSample = readInteger(compressed.data, pos, 16);
-    uint32_t numSamples = readInteger(compressed.data, pos, 32);
-    int golombParam = readInteger(compressed.data, pos, 16);
-    bool adaptive = compressed.data[pos++];
-    bool useInterChannelPred = compressed.data[pos++];
-    
-    info.sampleRate = sampleRate;
-    info.channels = channels;
-    info.bitsPerSample = bitsPerSample;
-    info.numSamples = numSamples;
-    
-    golomb.setParameter(golombParam);
-    
-    // Decode left channel
-    std::vector<int> leftResiduals;
-    leftResiduals.reserve(numSamples);
-    
-    for (size_t i = 0; i < numSamples && pos < compressed.data.size(); i++) {
-        std::vector<bool> encodedBits;
-        
-        // Read unary part
-        while (pos < compressed.data.size() && !compressed.data[pos]) {
-            encodedBits.push_back(false);
-            pos++;
+    for (size_t f = 0; f < blocks; f++) {
+        for (size_t c = 0; c < channels.size(); c++) {
+            for (size_t n = 0; n < 2 * LOSSY_BLOCK_SIZE; n++) {
+                size_t index = f * LOSSY_BLOCK_SIZE + n;
+                bool inside = index >= LOSSY_BLOCK_SIZE && index - LOSSY_BLOCK_SIZE < numSamples;
+                block[n] = inside ? channels[c][index - LOSSY_BLOCK_SIZE] : 0.0;
+            }
+            transform.forward(block.data(), coefficients[c].data());
         }
-        if (pos < compressed.data.size()) {
-            encodedBits.push_back(true);
-            pos++;
+        
+        // Budget: the drain plus half the distance to a half-full bucket,
+        // never more than the space left. The block then takes the highest
+        // quality that fits (the size grows with the quality).
+        int quality = lossyQuality;
+        if (rateControlled) {
+            double budget = drain + 0.5 * (bufferSize / 2.0 - buffer);
+            budget = std::min(budget, bufferSize - buffer + drain);
+            if (lossyBlockBits(coefficients, fullScale, info.sampleRate, quality) > budget) {
+                int low = 0;
+                int high = quality - 1;
+                while (low < high) {
+                    int middle = (low + high + 1) / 2;
+                    if (lossyBlockBits(coefficients, fullScale, info.sampleRate, middle) <= budget) {
+                        low = middle;
+                    } else {
+                        high = middle - 1;
+                    }
+                }
+                quality = low;
+            }
         }
         
-        // Read binary part
-        int b = static_cast<int>(std::ceil(std::log2(golombParam)));
-        for (int j = 0; j < b && pos < compressed.data.size(); j++) {
-            encodedBits.push_back(compressed.data[pos++]);
+        size_t start = compressed.data.size();
+        for (size_t c = 0; c < channels.size(); c++) {
+            int bandCount;
+            quantizeLossyBlock(coefficients[c], fullScale, info.sampleRate, quality, scaleFactors, quantized,
+                               bandCount);
+            codeLossyBlock(scaleFactors, quantized, bandCount, &compressed.data);
         }
         
-        try {
-            int residual = golomb.decodeInterleaving(encodedBits);
-            leftResiduals.push_back(residual);
-        } catch (...) {
-            break;
+        if (rateControlled) {
+            buffer += static_cast<double>(compressed.data.size() - start) - drain;
+            if (buffer > bufferSize) {
+                stats.overflowBlocks++;
+                buffer = bufferSize;
+            } else if (buffer <= 0.0) {
+                stats.underflowBlocks++;
+                buffer = 0.0;
+            }
+            stats.maxBuffer = std::max(stats.maxBuffer, static_cast<size_t>(buffer));
+            bufferSum += buffer;
         }
+        stats.minQuality = std::min(stats.minQuality, quality);
+        stats.maxQuality = std::max(stats.maxQuality, quality);
+        qualitySum += quality;
     }
     
-    // Reconstruct left channel
-    leftChannel.clear();
-    leftChannel.reserve(numSamples);
-    for (size_t i = 0; i < leftResiduals.size(); i++) {
-        int16_t predicted = predictTemporal(leftChannel, i, 1);
-        int16_t sample = predicted + leftResiduals[i];
-        leftChannel.push_back(sample);
+    finishEncode(compressed);
+    
+    if (rateControlled) {
+        double duration = static_cast<double>(numSamples) / info.sampleRate;
+        stats.targetBitrate = targetBitrate;
+        stats.achievedBitrate = duration > 0.0 ? compressed.compressedSize / duration / 1000.0 : 0.0;
+        stats.bufferSize = static_cast<size_t>(bufferSize);
+        stats.meanBuffer = blocks > 0 ? bufferSum / blocks : 0.0;
+        stats.meanQuality = blocks > 0 ? qualitySum / blocks : 0.0;
+    }
+    return compressed;
+}
+
+CompressedAudio AudioCodec::encodeLossy(const std::vector<std::vector<int16_t> >& channels, const AudioInfo& info) {
+    std::vector<std::vector<int32_t> > wide(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        wide[c].assign(channels[c].begin(), channels[c].end());
+    }
+    return encodeLossy(wide, info);
+}
+
+void AudioCodec::decodeLossy(const CompressedAudio& compressed, std::vector<std::vector<int32_t> >& channels,
+                             AudioInfo& info) {
+    size_t pos = 0;
+    int golombParam;
+    bool adaptive;
+    int frameSize;
+    int delta;
+    bool resync;
+    bool wide;
+    readHeader(compressed.data, pos, info, golombParam, adaptive, frameSize, delta, resync, wide, true);
+    lostFrames = 0;
+    size_t transformSize = static_cast<size_t>(readInteger(compressed.data, pos, 16));
+    if (transformSize != LOSSY_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid lossy block size in stream");
     }
     
-    // Decode right channel
-    std::vector<int> rightResiduals;
-    rightResiduals.reserve(numSamples);
+    MDCT transform(transformSize);
+    size_t numSamples = info.numSamples;
+    int numChannels = info.channels;
+    size_t blocks = numSamples == 0 ? 0 : (numSamples + transformSize - 1) / transformSize + 1;
     
-    for (size_t i = 0; i < numSamples && pos < compressed.data.size(); i++) {
-        std::vector<bool> encodedBits;
-        
-        // Read unary part
-        while (pos < compressed.data.size() && !compressed.data[pos]) {
-            encodedBits.push_back(false);
-            pos++;
-        }
-        if (pos < compressed.data.size()) {
-            encodedBits.push_back(true);
-            pos++;
-        }
-        
-        // Read binary part
-        int b = static_cast<int>(std::ceil(std::log2(golombParam)));
-        for (int j = 0; j < b && pos < compressed.data.size(); j++) {
-            encodedBits.push_back(compressed.data[pos++]);
-        }
-        
-        try {
-            int residual = golomb.decodeInterleaving(encodedBits);
-            rightResiduals.push_back(residual);
-        } catch (...) {
-            break;
+    // Overlap-add buffers, with one block of padding in front
+    std::vector<std::vector<double> > output(numChannels, std::vector<double>((blocks + 1) * transformSize, 0.0));
+    std::vector<double> coefficients(transformSize);
+    std::vector<double> block(2 * transformSize);
+    
+    try {
+        for (size_t f = 0; f < blocks; f++) {
+            for (int c = 0; c < numChannels; c++) {
+                readLossyBlock(compressed.data, pos, coefficients);
+                transform.inverse(coefficients.data(), block.data());
+                for (size_t n = 0; n < 2 * transformSize; n++) {
+                    output[c][f * transformSize + n] += block[n];
+                }
+            }
         }
+    } catch (...) {
+        // Truncated stream: the missing blocks decode as silence
     }
     
-    // Reconstruct right channel
-    rightChannel.clear();
-    rightChannel.reserve(numSamples);
-    
-    if (useInterChannelPred) {
-        for (size_t i = 0; i < rightResiduals.size(); i++) {
-            int16_t temporalPred = predictTemporal(rightChannel, i, 1);
-            int16_t interChannelPred = predictInterChannel(leftChannel, rightChannel, i);
-            int16_t predicted = (temporalPred + interChannelPred) / 2;
-            int16_t sample = predicted + rightResiduals[i];
-            rightChannel.push_back(sample);
-        }
-    } else {
-        for (size_t i = 0; i < rightResiduals.size(); i++) {
-            int16_t predicted = predictTemporal(rightChannel, i, 1);
-            int16_t sample = predicted + rightResiduals[i];
-            rightChannel.push_back(sample);
+    double maxValue = std::ldexp(1.0, sampleRange(info, wide) - 1) - 1.0;
+    channels.assign(numChannels, std::vector<int32_t>(numSamples));
+    for (int c = 0; c < numChannels; c++) {
+        for (size_t i = 0; i < numSamples; i++) {
+            double value = std::floor(output[c][i + transformSize] + 0.5);
+            channels[c][i] = static_cast<int32_t>(std::max(-maxValue - 1.0, std::min(maxValue, value)));
         }
     }
 }
 
+void AudioCodec::decodeLossy(const CompressedAudio& compressed, std::vector<std::vector<int16_t> >& channels,
+                             AudioInfo& info) {
+    std::vector<std::vector<int32_t> > wide;
+    decodeLossy(compressed, wide, info);
+    channels.assign(wide.size(), std::vector<int16_t>());
+    for (size_t c = 0; c < wide.size(); c++) {
+        channels[c].assign(wide[c].begin(), wide[c].end());
+    }
+}
+
 // Configuration methods
 void AudioCodec::setGolombParameter(int param) {
     defaultGolombParameter = param;
@@ -419,6 +2560,133 @@ bool AudioCodec::isAdaptiveMode() const {
     return adaptiveMode;
 }
 
+void AudioCodec::setBlockSize(int frameSize) {
+    if (frameSize < 1 || frameSize > 65535) {
+        throw std::invalid_argument("Block size must be between 1 and 65535");
+    }
+    blockSize = frameSize;
+}
+
+int AudioCodec::getBlockSize() const {
+    return blockSize;
+}
+
+// Apply an effort preset (see AudioCodec.h for the trade-offs)
+void AudioCodec::setPreset(int level) {
+    if (level < 0 || level > 8) {
+        throw std::invalid_argument("Preset level must be between 0 and 8");
+    }
+    
+    //                               0     1     2     3     4     5     6     7      8
+    static const int frameSizes[] = {1152, 1152, 1152, 4096, 4096, 4096, 4096, 4096, 16384};
+    static const int lpcOrders[] =  {0,    0,    0,    6,    8,    8,    8,    12,    12};
+    static const int partitions[] = {2,    2,    3,    4,    4,    5,    6,    6,     6};
+    
+    blockSize = frameSizes[level];
+    stereoSearch = level >= 1;
+    maxLPCOrder = lpcOrders[level];
+    maxPartitionOrder = partitions[level];
+    exhaustiveOrderSearch = level >= 5;
+    precisionSearch = level >= 6;
+    longTermPrediction = level >= 7;
+    crossChannelPrediction = level >= 6;
+    extraHighMode = level >= 8;
+}
+
+void AudioCodec::setMaxPartitionOrder(int order) {
+    maxPartitionOrder = std::max(0, std::min(order, (1 << PARTITION_ORDER_BITS) - 1));
+}
+
+int AudioCodec::getMaxPartitionOrder() const {
+    return maxPartitionOrder;
+}
+
+void AudioCodec::setExtraHighMode(bool enabled) {
+    extraHighMode = enabled;
+}
+
+bool AudioCodec::isExtraHighMode() const {
+    return extraHighMode;
+}
+
+void AudioCodec::setLongTermPrediction(bool enabled) {
+    longTermPrediction = enabled;
+}
+
+bool AudioCodec::isLongTermPrediction() const {
+    return longTermPrediction;
+}
+
+void AudioCodec::setCrossChannelPrediction(bool enabled) {
+    crossChannelPrediction = enabled;
+}
+
+bool AudioCodec::isCrossChannelPrediction() const {
+    return crossChannelPrediction;
+}
+
+void AudioCodec::setNearLossless(int delta) {
+    if (delta < 0 || delta > 65535) {
+        throw std::invalid_argument("Near-lossless delta must be between 0 and 65535");
+    }
+    nearLosslessDelta = delta;
+}
+
+int AudioCodec::getNearLossless() const {
+    return nearLosslessDelta;
+}
+
+void AudioCodec::setLossyQuality(int quality) {
+    if (quality < 0 || quality > 100) {
+        throw std::invalid_argument("Lossy quality must be between 0 and 100");
+    }
+    lossyQuality = quality;
+}
+
+int AudioCodec::getLossyQuality() const {
+    return lossyQuality;
+}
+
+void AudioCodec::setTargetBitrate(double kbps, double seconds) {
+    if (kbps < 0.0 || seconds <= 0.0) {
+        throw std::invalid_argument("Target bitrate must be non-negative and the buffer positive");
+    }
+    targetBitrate = kbps;
+    bufferSeconds = seconds;
+}
+
+double AudioCodec::getTargetBitrate() const {
+    return targetBitrate;
+}
+
+void AudioCodec::setResyncFrames(bool enabled) {
+    resyncFrames = enabled;
+}
+
+bool AudioCodec::isResyncFrames() const {
+    return resyncFrames;
+}
+
+void AudioCodec::setProfile(CodecProfile* target) {
+    profile = target;
+}
+
+CodecProfile* AudioCodec::getProfile() const {
+    return profile;
+}
+
+void AudioCodec::setTrace(FrameTrace* target) {
+    trace = target;
+}
+
+FrameTrace* AudioCodec::getTrace() const {
+    return trace;
+}
+
+size_t AudioCodec::getLostFrames() const {
+    return lostFrames;
+}
+
 // Get compression ratio
 double AudioCodec::getCompressionRatio(const CompressedAudio& compressed) const {
     return compressed.compressionRatio;
@@ -433,10 +2701,41 @@ void AudioCodec::printStatistics(const CompressedAudio& compressed) const {
     std::cout << "Number of Samples: " << compressed.info.numSamples << std::endl;
     std::cout << "Golomb Parameter: " << compressed.golombParameter << std::endl;
     std::cout << "Adaptive Mode: " << (compressed.useAdaptiveParameter ? "Yes" : "No") << std::endl;
+    if (compressed.maxSampleError > 0) {
+        std::cout << "Near-Lossless: +/- " << compressed.maxSampleError << std::endl;
+    }
+    if (compressed.rateControl.targetBitrate > 0.0) {
+        const RateControlStats& rate = compressed.rateControl;
+        std::cout << "Bitrate: " << rate.achievedBitrate << " kbit/s (target " << rate.targetBitrate << ")"
+                  << std::endl;
+        std::cout << "Buffer: " << rate.bufferSize << " bits, mean " << rate.meanBuffer << ", max "
+                  << rate.maxBuffer << ", " << rate.overflowBlocks << " overflows, " << rate.underflowBlocks
+                  << " underflows" << std::endl;
+        std::cout << "Quality: " << rate.minQuality << " to " << rate.maxQuality << ", mean " << rate.meanQuality
+                  << std::endl;
+    }
+    if (compressed.info.channels >= 2) {
+        std::cout << "Stereo Modes (L/R, M/S, L/S, R/S): "
+                  << compressed.stereoModeCount[STEREO_LEFT_RIGHT] << ", "
+                  << compressed.stereoModeCount[STEREO_MID_SIDE] << ", "
+                  << compressed.stereoModeCount[STEREO_LEFT_SIDE] << ", "
+                  << compressed.stereoModeCount[STEREO_RIGHT_SIDE] << " frames" << std::endl;
+    }
+    std::cout << "Subframes (constant, verbatim, fixed, run, NLMS, LPC, cross): "
+              << compressed.subframeTypeCount[SUBFRAME_CONSTANT] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_VERBATIM] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_FIXED] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_RUN] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_NLMS] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_LPC] << ", "
+              << compressed.subframeTypeCount[SUBFRAME_CROSS] << std::endl;
     std::cout << "Original Size: " << compressed.originalSize << " bits (" 
               << compressed.originalSize / 8 << " bytes)" << std::endl;
     std::cout << "Compressed Size: " << compressed.compressedSize << " bits (" 
               << compressed.compressedSize / 8 << " bytes)" << std::endl;
     std::cout << "Compression Ratio: " << compressed.compressionRatio << ":1" << std::endl;
     std::cout << "Space Savings: " << (1.0 - 1.0/compressed.compressionRatio) * 100.0 << "%" << std::endl;
+    if (profile) {
+        profile->print();
+    }
 }
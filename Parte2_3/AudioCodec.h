@@ -2,31 +2,111 @@
 #define AUDIO_CODEC_H
 
 #include "GolombCoding.h"
+#include "NLMSPredictor.h"
+#include "LPCPredictor.h"
+#include "PitchPredictor.h"
+#include "MDCT.h"
+#include "FrameTrace.h"
+#include "PCMConvert.h"
 #include <vector>
 #include <string>
+#include <chrono>
 #include <cstdint>
 
+struct CodecProfile;
+
 // Structure to hold audio information
 struct AudioInfo {
     uint32_t sampleRate;
-    uint16_t channels;      // 1 = mono, 2 = stereo
-    uint16_t bitsPerSample; // Typically 16
+    uint16_t channels;      // 1 = mono, 2 = stereo, more = multichannel
+    uint16_t bitsPerSample; // 8, 16, 24 or 32
     uint32_t numSamples;
     
     AudioInfo() : sampleRate(44100), channels(1), bitsPerSample(16), numSamples(0) {}
 };
 
+// Read-only view of planar samples held elsewhere (std::span-style; the code
+// is C++11): data[c] points at frames samples of channel c
+struct SampleSpan {
+    const int32_t* const* data;
+    size_t frames;
+    uint16_t channels;
+    
+    SampleSpan() : data(NULL), frames(0), channels(0) {}
+    SampleSpan(const int32_t* const* planes, size_t count, uint16_t numChannels)
+        : data(planes), frames(count), channels(numChannels) {}
+};
+
+// Stereo decorrelation modes, chosen per frame
+// (side = left - right, mid = (left + right) >> 1; all modes are lossless)
+enum StereoMode {
+    STEREO_LEFT_RIGHT = 0,
+    STEREO_MID_SIDE = 1,
+    STEREO_LEFT_SIDE = 2,
+    STEREO_RIGHT_SIDE = 3
+};
+
+// How a subframe (one channel of one frame) is coded
+enum SubframeType {
+    SUBFRAME_CONSTANT = 0, // A single value repeated over the frame
+    SUBFRAME_VERBATIM = 1, // Raw samples, used when prediction does not pay off
+    SUBFRAME_FIXED = 2,    // Fixed predictor with Golomb-coded residuals
+    SUBFRAME_RUN = 3,      // As SUBFRAME_FIXED, with runs of zero residuals run-length coded
+    SUBFRAME_NLMS = 4,     // Adaptive LMS cascade (extra high mode)
+    SUBFRAME_LPC = 5,      // Quantized linear predictor with Golomb-coded residuals
+    SUBFRAME_CROSS = 6,    // Cross-channel LMS predictor (second channel of a pair only)
+    SUBFRAME_TYPE_COUNT
+};
+
+// Short names of the stereo modes and subframe types, for profiles and traces
+const char* stereoModeName(StereoMode mode);
+const char* subframeTypeName(SubframeType type);
+
+// Two channels of a multichannel stream coded together with per-frame stereo
+// decorrelation (first takes the role of left, second of right)
+struct ChannelPair {
+    int first;
+    int second;
+    
+    ChannelPair(int a, int b) : first(a), second(b) {}
+};
+
+// Constant-bitrate statistics of a rate-controlled lossy stream (the buffer
+// is the encoder's leaky bucket, drained at the target rate every block)
+struct RateControlStats {
+    double targetBitrate;   // kbit/s, 0 if the stream was not rate controlled
+    double achievedBitrate; // kbit/s
+    size_t bufferSize;      // bits
+    size_t maxBuffer;       // Highest occupancy after a block, in bits
+    double meanBuffer;      // Mean occupancy after a block, in bits
+    size_t overflowBlocks;  // Blocks over the buffer even at quality 0
+    size_t underflowBlocks; // Blocks that left the buffer empty (link idle)
+    int minQuality;
+    int maxQuality;
+    double meanQuality;
+    
+    RateControlStats() : targetBitrate(0.0), achievedBitrate(0.0), bufferSize(0), maxBuffer(0), meanBuffer(0.0),
+                         overflowBlocks(0), underflowBlocks(0), minQuality(0), maxQuality(0), meanQuality(0.0) {}
+};
+
 // Structure for compressed audio data
 struct CompressedAudio {
     AudioInfo info;
     int golombParameter;
     bool useAdaptiveParameter;
+    int maxSampleError; // Near-lossless bound (0 = lossless)
     std::vector<bool> data;
     
     // Statistics
     size_t originalSize;
     size_t compressedSize;
     double compressionRatio;
+    size_t stereoModeCount[4];   // Frames coded with each StereoMode
+    size_t subframeTypeCount[SUBFRAME_TYPE_COUNT]; // Subframes coded with each SubframeType
+    RateControlStats rateControl;
+    
+    CompressedAudio() : golombParameter(0), useAdaptiveParameter(false), maxSampleError(0), originalSize(0),
+                        compressedSize(0), compressionRatio(0.0), stereoModeCount(), subframeTypeCount() {}
 };
 
 class AudioCodec {
@@ -34,51 +114,442 @@ private:
     GolombCoding golomb;
     int defaultGolombParameter;
     bool adaptiveMode;
+    int blockSize; // Samples per frame (per channel)
+    bool extraHighMode; // Also try the adaptive LMS cascade for every subframe
+    CascadePredictor cascade;
+    CrossChannelPredictor crossPredictor;
+    
+    // Encoder search effort (set together by setPreset)
+    bool stereoSearch;          // Choose the stereo mode per frame (otherwise L/R)
+    int maxLPCOrder;            // 0 = fixed predictor only
+    bool exhaustiveOrderSearch; // Size every LPC order instead of the estimated best
+    bool precisionSearch;       // Also try coefficient precisions near the default
+    int maxPartitionOrder;      // Residuals split into up to 2^maxPartitionOrder partitions
+    bool longTermPrediction;    // Try a pitch predictor on the short-term residuals
+    bool crossChannelPrediction; // Try the cross-channel LMS on the second channel of pairs
+    
+    int nearLosslessDelta; // Largest sample error allowed (0 = lossless)
+    int sampleRangeBits;   // Near-lossless reconstructions are clamped to this many bits
+    int lossyQuality;      // 0..100, for encodeLossy
+    double targetBitrate;  // kbit/s for encodeLossy (0 = fixed quality)
+    double bufferSeconds;  // Rate control buffer, in seconds at the target rate
+    bool resyncFrames;     // Frames start with a sync code and carry CRCs (FrameSync.h)
+    size_t lostFrames;     // Frames the last decode could not recover
+    std::vector<bool> framePayload; // One frame, before it is wrapped in a sync frame
+    CodecProfile* profile; // Instrumentation target (NULL = off)
+    FrameTrace* trace;     // Per-frame trace target (NULL = off)
+    FrameTraceRecord traceRecord; // Frame being traced
+    std::chrono::steady_clock::time_point traceStart;
     
-    // Prediction methods
-    int16_t predictTemporal(const std::vector<int16_t>& samples, size_t index, int order = 1);
-    int16_t predictInterChannel(const std::vector<int16_t>& leftChannel, 
-                                 const std::vector<int16_t>& rightChannel, 
-                                 size_t index);
+    // Coding decision for one subframe, with everything needed to write it
+    struct SubframePlan {
+        SubframeType type;
+        int wastedBits;      // Zero low bits shared by every sample, not coded
+        int verbatimBits;    // Sample width for SUBFRAME_VERBATIM
+        int partitionOrder;          // Residual partitions (2^partitionOrder)
+        std::vector<int> parameters; // Golomb parameter of each partition
+        size_t bits;         // Exact coded size
+        std::vector<int32_t> samples;   // Samples without the wasted bits
+        std::vector<int64_t> residuals; // Prediction residuals (after warm-up)
+        std::vector<int64_t> literals;  // Residuals not absorbed by zero runs
+        std::vector<int64_t> candidate; // Residuals of the predictor being tried
+        std::vector<int32_t> lpcCoefficients;
+        int lpcPrecision;
+        int lpcShift;
+        int pitchLag;        // Long-term predictor (pitchGain 0 = none)
+        int pitchGain;
+    };
+    SubframePlan scratchPlan;
+    size_t subframeTypeCount[SUBFRAME_TYPE_COUNT]; // Statistics for the stream being encoded
+    
+    // Prediction methods (samples points at the start of the current frame)
+    int64_t predictTemporal(const int32_t* samples, size_t index, int order = 2);
+    
+    // Stereo decorrelation
+    void decorrelateStereo(const int32_t* left, const int32_t* right, size_t n, StereoMode mode,
+                           std::vector<int32_t>& first, std::vector<int32_t>& second);
+    void correlateStereo(const int32_t* first, const int32_t* second, size_t n, StereoMode mode,
+                         int32_t* left, int32_t* right);
+    void predictInterChannel(const int32_t* samples, const int32_t* reference, size_t n,
+                             std::vector<int64_t>& residuals);
+    void restoreInterChannel(const std::vector<int64_t>& residuals, const int32_t* reference,
+                             int32_t* samples, size_t n);
+    StereoMode chooseStereoMode(const int32_t* left, const int32_t* right, size_t n, int sampleBits);
+    StereoMode encodePairFrame(std::vector<bool>& bitstream, const int32_t* left, const int32_t* right,
+                               size_t n, int sampleBits, bool searchMode);
+    void decodePairFrame(const std::vector<bool>& bitstream, size_t& pos, int32_t* left, int32_t* right,
+                         size_t n, int sampleBits, bool hasMode, int golombParam, bool adaptive, int delta);
     
     // Adaptive parameter calculation
-    int calculateOptimalParameter(const std::vector<int>& residuals, size_t windowSize = 1000);
+    int calculateOptimalParameter(const std::vector<int64_t>& residuals, size_t windowSize = 1000);
+    int calculateOptimalParameter(const int64_t* residuals, size_t count);
+    size_t planResidualCoding(const std::vector<int64_t>& residuals, int maxPartitionOrder,
+                              int& partitionOrder, std::vector<int>& parameters);
+    static void partitionBounds(size_t count, int order, size_t partition, size_t& first, size_t& last);
     
     // Bit stream operations
     void writeBits(std::vector<bool>& bitstream, const std::vector<bool>& bits);
     void writeInteger(std::vector<bool>& bitstream, int value, int numBits);
     int readInteger(const std::vector<bool>& bitstream, size_t& pos, int numBits);
+    int readSignedInteger(const std::vector<bool>& bitstream, size_t& pos, int numBits);
     
     // Encoding/decoding helpers
-    std::vector<int> calculateResiduals(const std::vector<int16_t>& samples);
-    std::vector<int16_t> reconstructFromResiduals(const std::vector<int>& residuals, 
-                                                   const std::vector<int16_t>& original, 
-                                                   size_t numSamples);
+    void calculateResiduals(const int32_t* samples, size_t n, std::vector<int64_t>& residuals);
+    void reconstructFromResiduals(const std::vector<int64_t>& residuals, int32_t* samples, size_t n);
+    void calculateNearLosslessResiduals(const int32_t* samples, size_t n, int rangeBits, int delta,
+                                        std::vector<int64_t>& residuals);
+    void reconstructNearLossless(const std::vector<int64_t>& residuals, int32_t* samples, size_t n,
+                                 int rangeBits, int delta);
+    void planSubframe(const int32_t* samples, size_t n, int sampleBits, SubframePlan& plan,
+                      const int32_t* reference = NULL);
+    void planLPCSubframe(size_t n, int shiftedBits, size_t headerBits, SubframePlan& plan);
+    void writeSubframe(std::vector<bool>& bitstream, const int32_t* samples, size_t n, int sampleBits,
+                       const SubframePlan& plan);
+    void writeResiduals(std::vector<bool>& bitstream, const std::vector<int64_t>& residuals,
+                        int partitionOrder, const std::vector<int>& parameters, int pitchLag, int pitchGain);
+    void readResiduals(const std::vector<bool>& bitstream, size_t& pos, size_t count,
+                       int golombParam, bool adaptive, std::vector<int64_t>& residuals);
+    void writeGolombParameter(std::vector<bool>& bitstream, int param);
+    int readGolombParameter(const std::vector<bool>& bitstream, size_t& pos);
+    size_t codeResidualRuns(const std::vector<int64_t>& residuals, GolombCoding& coder,
+                            std::vector<bool>* bitstream);
+    void decodeResidualRuns(const std::vector<bool>& bitstream, size_t& pos, size_t count,
+                            std::vector<int64_t>& residuals);
+    // reference: the already coded first channel of a pair, if any
+    size_t estimateSubframeBits(const int32_t* samples, size_t n, int sampleBits,
+                                const int32_t* reference = NULL);
+    void encodeSubframe(std::vector<bool>& bitstream, const int32_t* samples, size_t n, int sampleBits,
+                        const int32_t* reference = NULL);
+    void decodeSubframe(const std::vector<bool>& bitstream, size_t& pos, int32_t* samples, size_t n,
+                        int sampleBits, int golombParam, bool adaptive, int delta,
+                        const int32_t* reference = NULL);
+    
+    void beginEncode();
+    void finishEncode(CompressedAudio& compressed);
+    
+    void buildCodingUnits(int channels, const std::vector<ChannelPair>& pairs, std::vector<ChannelPair>& units);
+    static void fillDefaultChannelPairs(int channels, std::vector<ChannelPair>& pairs);
+    
+    // Lossy transform coding: one block of MDCT coefficients of one channel
+    void quantizeLossyBlock(const std::vector<double>& coefficients, double fullScale, uint32_t sampleRate,
+                            int quality, std::vector<int>& scaleFactors, std::vector<int64_t>& quantized,
+                            int& bandCount);
+    size_t codeLossyBlock(const std::vector<int>& scaleFactors, const std::vector<int64_t>& quantized,
+                          int bandCount, std::vector<bool>* bitstream);
+    size_t lossyBlockBits(const std::vector<std::vector<double> >& coefficients, double fullScale,
+                          uint32_t sampleRate, int quality);
+    void readLossyBlock(const std::vector<bool>& bitstream, size_t& pos, std::vector<double>& coefficients);
+    
+    // Hybrid mode: one channel of one frame of the correction stream
+    size_t codeCorrection(const std::vector<int64_t>& differences, int delta, std::vector<bool>* bitstream);
+    void readCorrection(const std::vector<bool>& bitstream, size_t& pos, int delta, int32_t* samples, size_t n);
+    
+    // The header ends with the sample range flag (wide: samples wider than
+    // bitsPerSample) and the stream mode (lossless or lossy); readHeader
+    // throws std::invalid_argument if the mode is not the one the decoder expects
+    void writeHeader(std::vector<bool>& bitstream, const AudioInfo& info, int golombParam, bool adaptive,
+                     int frameSize, int delta, bool resync, bool wide, bool lossy);
+    void readHeader(const std::vector<bool>& bitstream, size_t& pos, AudioInfo& info,
+                    int& golombParam, bool& adaptive, int& frameSize, int& delta, bool& resync, bool& wide,
+                    bool lossy);
+    void writeSyncFrame(std::vector<bool>& bitstream, uint32_t frameNumber, const std::vector<bool>& payload);
+    void locateSyncFrames(const std::vector<bool>& bitstream, size_t pos, size_t frameCount,
+                          std::vector<size_t>& payloads);
+    
+    // Header fields, channel pairs and frame lengths of a multichannel stream
+    // (frame lengths come from the frame table of edited streams, otherwise
+    // from the frame size)
+    struct MultichannelLayout {
+        AudioInfo info;
+        int golombParam;
+        bool adaptive;
+        int frameSize;
+        int delta;
+        bool resync;
+        bool wide;
+        std::vector<ChannelPair> pairs;
+        bool hasFrameTable;
+        std::vector<size_t> frameSamples;
+    };
+    // One frame of an edited stream: the bit range of its payload in data
+    struct FramePiece {
+        const std::vector<bool>* data;
+        size_t begin;
+        size_t end;
+        size_t samples;
+        
+        FramePiece(const std::vector<bool>* bits, size_t first, size_t last, size_t count)
+            : data(bits), begin(first), end(last), samples(count) {}
+    };
+    
+    // Scratch buffers kept between frames and calls, so that coding streams
+    // of the same shape again does not allocate
+    std::vector<int32_t> stereoFirst, stereoSecond; // Decorrelated pair
+    std::vector<int32_t> stereoMid, stereoSide;     // Stereo mode search
+    std::vector<int32_t> reconstructedScratch;      // Near-lossless prediction
+    std::vector<int32_t> quantizedScratch;          // LPC coefficients being tried
+    std::vector<int> trialParameters, candidateParameters;
+    std::vector<double> autocorrelationScratch, errorScratch, windowScratch; // LPC analysis
+    std::vector<std::vector<double> > coefficientScratch;
+    PitchSearch pitchSearch;                        // Long-term prediction
+    std::vector<int64_t> residualScratch;           // Decoder
+    std::vector<bool> substream;                    // One coding unit of a multichannel frame
+    std::vector<ChannelPair> codingUnits, defaultPairs;
+    std::vector<bool> wantedChannels;
+    std::vector<size_t> payloadScratch;
+    std::vector<std::vector<int32_t> > frameSamples; // One frame converted from PCM
+    std::vector<const int32_t*> inputPlanes;
+    std::vector<int32_t*> outputPlanes;              // Into frameSamples, or the decoder's output
+    MultichannelLayout layoutScratch;
+    
+    void writeMultichannelHeader(std::vector<bool>& bitstream, const MultichannelLayout& layout);
+    void readMultichannelHeader(const std::vector<bool>& bitstream, size_t& pos, MultichannelLayout& layout);
+    void encodeMultichannelFrame(std::vector<bool>& frameData, const int32_t* const* channels,
+                                 const std::vector<ChannelPair>& units, size_t start, size_t n, int sampleBits,
+                                 CompressedAudio& compressed);
+    void decodeMultichannelFrame(const std::vector<bool>& bitstream, size_t& pos, const MultichannelLayout& layout,
+                                 const std::vector<ChannelPair>& units, const std::vector<bool>& wanted,
+                                 int32_t* const* samples, size_t offset, size_t n);
+    void locateMultichannelFrames(const CompressedAudio& compressed, MultichannelLayout& layout,
+                                  std::vector<size_t>& begins, std::vector<size_t>& ends);
+    void reencodeFramePart(const std::vector<bool>& bitstream, size_t begin, const MultichannelLayout& layout,
+                           size_t frameSamples, size_t from, size_t to, std::vector<bool>& payload);
+    CompressedAudio assembleMultichannel(const MultichannelLayout& layout, const std::vector<FramePiece>& pieces);
+    // Samples come from channels, or (channels NULL) from pcm a frame at a time
+    void encodeMultichannelSource(const SampleSpan* channels, const PCMSpan* pcm, const AudioInfo& info,
+                                  const std::vector<ChannelPair>& pairs, CompressedAudio& compressed);
+    
+    void beginTraceFrame(size_t frame, size_t start, size_t n);
+    void endTraceFrame(size_t bits);
 
 public:
     // Constructor
-    explicit AudioCodec(int golombParam = 16, bool adaptive = true);
+    explicit AudioCodec(int golombParam = 16, bool adaptive = true, int frameSize = 4096);
     
     // Main encoding/decoding functions
+    // Samples are carried as int32_t (8 to 32 bits per sample); the int16_t
+    // overloads are kept for 16-bit callers
+    CompressedAudio encode(const std::vector<int32_t>& audioData, const AudioInfo& info);
     CompressedAudio encode(const std::vector<int16_t>& audioData, const AudioInfo& info);
+    void decode(const CompressedAudio& compressed, std::vector<int32_t>& samples, AudioInfo& info);
     std::vector<int16_t> decode(const CompressedAudio& compressed, AudioInfo& info);
     
     // Stereo-specific encoding/decoding
+    CompressedAudio encodeStereo(const std::vector<int32_t>& leftChannel,
+                                  const std::vector<int32_t>& rightChannel,
+                                  const AudioInfo& info,
+                                  bool useInterChannelPrediction = true);
     CompressedAudio encodeStereo(const std::vector<int16_t>& leftChannel,
                                   const std::vector<int16_t>& rightChannel,
                                   const AudioInfo& info,
                                   bool useInterChannelPrediction = true);
     
+    void decodeStereo(const CompressedAudio& compressed,
+                     std::vector<int32_t>& leftChannel,
+                     std::vector<int32_t>& rightChannel,
+                     AudioInfo& info);
     void decodeStereo(const CompressedAudio& compressed,
                      std::vector<int16_t>& leftChannel,
                      std::vector<int16_t>& rightChannel,
                      AudioInfo& info);
     
+    // Multichannel encoding/decoding: each pair is coded with per-frame stereo
+    // decorrelation, the remaining channels on their own; every channel (or pair)
+    // is a separate length-prefixed substream within each frame
+    CompressedAudio encodeMultichannel(const std::vector<std::vector<int32_t> >& channels,
+                                       const AudioInfo& info,
+                                       const std::vector<ChannelPair>& pairs);
+    CompressedAudio encodeMultichannel(const std::vector<std::vector<int32_t> >& channels,
+                                       const AudioInfo& info);
+    CompressedAudio encodeMultichannel(const std::vector<std::vector<int16_t> >& channels,
+                                       const AudioInfo& info,
+                                       const std::vector<ChannelPair>& pairs);
+    CompressedAudio encodeMultichannel(const std::vector<std::vector<int16_t> >& channels,
+                                       const AudioInfo& info);
+    
+    // Multichannel encoding straight from packed PCM, such as a memory-mapped
+    // WAV file (WAVFile::map): each frame is converted just before it is
+    // coded, so no full-length sample vectors are made. Produces the same
+    // stream as the vector overloads. Throws std::invalid_argument if info's
+    // channels or sample width differ from the span's.
+    CompressedAudio encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info,
+                                       const std::vector<ChannelPair>& pairs);
+    CompressedAudio encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info);
+    
+    // Batch variants: the input is a view and the stream is written into
+    // compressed, whose buffer (like the codec's scratch buffers) keeps its
+    // capacity. After a first file, encoding and decoding files of the same
+    // shape make no heap allocations (with no profile or trace attached).
+    void encodeMultichannel(const SampleSpan& samples, const AudioInfo& info,
+                            const std::vector<ChannelPair>& pairs, CompressedAudio& compressed);
+    void encodeMultichannel(const SampleSpan& samples, const AudioInfo& info, CompressedAudio& compressed);
+    void encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info,
+                            const std::vector<ChannelPair>& pairs, CompressedAudio& compressed);
+    void encodeMultichannel(const PCMSpan& pcm, const AudioInfo& info, CompressedAudio& compressed);
+    
+    // Channels not set in channelMask are skipped (left empty) without being
+    // decoded. Samples are decoded straight into channels, reusing the
+    // capacity of its vectors.
+    void decodeMultichannel(const CompressedAudio& compressed,
+                            std::vector<std::vector<int32_t> >& channels,
+                            AudioInfo& info,
+                            uint64_t channelMask = ~0ULL);
+    void decodeMultichannel(const CompressedAudio& compressed,
+                            std::vector<std::vector<int16_t> >& channels,
+                            AudioInfo& info,
+                            uint64_t channelMask = ~0ULL);
+    
+    // Frame-level editing of multichannel streams without re-encoding them.
+    // Whole frames are copied bit for bit (re-wrapped if the stream has sync
+    // codes); only the frames holding a cut point are decoded and their kept
+    // part re-encoded, with the stream's own parameters. Streams whose
+    // frames no longer all have the same length carry a frame table in the
+    // header. In near-lossless streams the re-encoded edge samples are within
+    // delta of the decoded ones. Throw std::invalid_argument for damaged
+    // streams, a range outside the stream, or streams whose sample format,
+    // channel pairs or coding parameters differ.
+    CompressedAudio cutMultichannel(const CompressedAudio& compressed, size_t start, size_t end);
+    CompressedAudio concatenateMultichannel(const CompressedAudio& first, const CompressedAudio& second);
+    // Replace samples [start, end) of target with insert
+    CompressedAudio spliceMultichannel(const CompressedAudio& target, size_t start, size_t end,
+                                       const CompressedAudio& insert);
+    
+    // Default pairing: front L/R plus the surround pairs for 5.1 and 7.1 layouts,
+    // adjacent channels otherwise
+    static std::vector<ChannelPair> defaultChannelPairs(int channels);
+    
     // Configuration
     void setGolombParameter(int param);
     int getGolombParameter() const;
     void setAdaptiveMode(bool adaptive);
     bool isAdaptiveMode() const;
+    // Samples per frame, 1..65535 (the size is stored in 16 bits); throws
+    // std::invalid_argument outside that range
+    void setBlockSize(int frameSize);
+    int getBlockSize() const;
+    
+    // Effort presets, from fastest (0) to smallest output (8). Each level
+    // includes the searches of the levels below it:
+    //   0: 1152-sample frames, fixed predictor, no stereo mode search
+    //   1: stereo mode search per frame
+    //   2: up to 8 residual partitions (4 at levels 0 and 1)
+    //   3: 4096-sample frames, LPC up to order 6 (order chosen by estimate),
+    //      up to 16 partitions
+    //   4: LPC up to order 8
+    //   5: every LPC order sized exactly, up to 32 partitions
+    //   6: coefficient precision searched (default +/- 2 bits), up to 64 partitions,
+    //      cross-channel prediction
+    //   7: LPC up to order 12, long-term (pitch) prediction
+    //   8: 16384-sample frames plus the adaptive LMS cascade (extra high mode)
+    // The constructor's defaults are 4096-sample frames, the fixed predictor,
+    // stereo search and up to 16 partitions. Throws std::invalid_argument
+    // outside 0..8.
+    void setPreset(int level);
+    
+    // Residuals of each subframe are split into up to 2^order partitions with
+    // their own Golomb parameter (adaptive mode only; 0 = one parameter)
+    void setMaxPartitionOrder(int order);
+    int getMaxPartitionOrder() const;
+    
+    // Extra high compression: adds the adaptive LMS cascade (NLMSPredictor.h)
+    // to the predictors searched per subframe, at a large cost in speed
+    void setExtraHighMode(bool enabled);
+    bool isExtraHighMode() const;
+    
+    // Long-term prediction: after the short-term predictor, subtract a scaled
+    // copy of the residual one pitch period back (PitchPredictor.h) when it
+    // makes the subframe smaller. Helps tonal and periodic material.
+    void setLongTermPrediction(bool enabled);
+    bool isLongTermPrediction() const;
+    
+    // Cross-channel prediction: the second channel of every stereo pair may
+    // be predicted by an adaptive LMS filter from its own past and the first
+    // channel (CrossChannelPredictor). Suits time-aligned but different
+    // channels, such as spaced microphones.
+    void setCrossChannelPrediction(bool enabled);
+    bool isCrossChannelPrediction() const;
+    
+    // Near-lossless coding: every decoded sample is within +/- delta of the
+    // original. Residuals of the fixed predictor are quantized with step
+    // 2 * delta + 1 and prediction runs on the reconstructed samples, so the
+    // error does not accumulate. Only constant, verbatim, fixed and run
+    // subframes are used, and stereo pairs stay L/R (a side channel would
+    // double the error). 0 (the default) is lossless; throws
+    // std::invalid_argument outside 0..65535.
+    void setNearLossless(int delta);
+    int getNearLossless() const;
+    
+    // Lossy transform coding: MDCT (MDCT.h) blocks of 1024 coefficients,
+    // quantized per band with a step set by a simple masking model (each
+    // band's energy spread to its neighbours, a frequency-dependent floor and
+    // a quality-dependent low-pass), and Golomb-coded. Not bit-exact: decoded samples only
+    // approximate the input. The stream is read by decodeLossy only; the
+    // header marks it as lossy, so the other decoders reject it (and
+    // decodeLossy rejects lossless streams) with std::invalid_argument.
+    CompressedAudio encodeLossy(const std::vector<std::vector<int32_t> >& channels, const AudioInfo& info);
+    CompressedAudio encodeLossy(const std::vector<std::vector<int16_t> >& channels, const AudioInfo& info);
+    void decodeLossy(const CompressedAudio& compressed, std::vector<std::vector<int32_t> >& channels,
+                     AudioInfo& info);
+    void decodeLossy(const CompressedAudio& compressed, std::vector<std::vector<int16_t> >& channels,
+                     AudioInfo& info);
+    
+    // Hybrid coding (like WavPack's hybrid mode): a near-lossless main stream,
+    // every sample within +/- delta, plus a correction stream holding the
+    // difference to the original. decodeMultichannel reads the main stream on
+    // its own; decodeHybrid adds the correction to give the lossless original,
+    // and throws std::invalid_argument if the correction belongs to another
+    // main stream (the correction header holds the main stream's size and
+    // CRC-16). Throws std::invalid_argument for delta outside 1..65535.
+    CompressedAudio encodeHybrid(const std::vector<std::vector<int32_t> >& channels, const AudioInfo& info,
+                                 int delta, CompressedAudio& correction);
+    CompressedAudio encodeHybrid(const std::vector<std::vector<int16_t> >& channels, const AudioInfo& info,
+                                 int delta, CompressedAudio& correction);
+    void decodeHybrid(const CompressedAudio& compressed, const CompressedAudio& correction,
+                      std::vector<std::vector<int32_t> >& channels, AudioInfo& info);
+    void decodeHybrid(const CompressedAudio& compressed, const CompressedAudio& correction,
+                      std::vector<std::vector<int16_t> >& channels, AudioInfo& info);
+    
+    // Quality of encodeLossy, from 0 (smallest) to 100 (most transparent);
+    // the default is 50. Throws std::invalid_argument outside 0..100.
+    void setLossyQuality(int quality);
+    int getLossyQuality() const;
+    
+    // Constant bitrate for encodeLossy over a link of kbps kbit/s: a leaky
+    // bucket of bufferSeconds at that rate, starting half full, is drained
+    // every block, and each block takes the highest quality whose exact coded
+    // size (sized before writing) steers the bucket back towards half full
+    // without overflowing it. setLossyQuality is then only the upper limit. kbps 0 disables it;
+    // statistics are in CompressedAudio::rateControl. Throws
+    // std::invalid_argument for a negative rate or a non-positive buffer.
+    void setTargetBitrate(double kbps, double bufferSeconds = 0.5);
+    double getTargetBitrate() const;
+    
+    // Resynchronizable frames for encode, encodeStereo and encodeMultichannel:
+    // every frame is byte aligned and starts with a sync code, its number,
+    // its length and a header CRC, and ends with a CRC of its contents
+    // (FrameSync.h). The decoder locates frames by scanning for sync codes,
+    // so a damaged frame is lost (decoded as silence, counted by
+    // getLostFrames) while the frames around it decode normally. Costs about
+    // 14 bytes per frame. Off by default.
+    void setResyncFrames(bool enabled);
+    bool isResyncFrames() const;
+    // Frames lost to damage or truncation in the last decode of a stream with sync codes
+    size_t getLostFrames() const;
+    
+    // Instrumentation for encode, encodeStereo, encodeMultichannel and their
+    // decoders (and so the hybrid and frame editing paths built on them):
+    // time per stage and coding counters are added to profile
+    // (CodecProfile.h) until it is detached with NULL, the default. The
+    // profile is not owned and must outlive its use; a WAVFile can share it.
+    void setProfile(CodecProfile* profile);
+    CodecProfile* getProfile() const;
+    
+    // Per-frame trace of the same encoders (FrameTrace.h): one record per
+    // frame with its size, subframe types, predictor orders, Golomb
+    // parameters, stereo modes and encode time, written as the frame is
+    // finished. Not owned; NULL (the default) turns it off.
+    void setTrace(FrameTrace* trace);
+    FrameTrace* getTrace() const;
     
     // Utility functions
     double getCompressionRatio(const CompressedAudio& compressed) const;
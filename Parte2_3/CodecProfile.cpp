@@ -0,0 +1,116 @@
+#include "CodecProfile.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+CodecProfile::CodecProfile() {
+    clear();
+}
+
+void CodecProfile::clear() {
+    std::fill(stageSeconds, stageSeconds + PROFILE_STAGE_COUNT, 0.0);
+    frames = 0;
+    std::fill(subframeTypeCount, subframeTypeCount + SUBFRAME_TYPE_COUNT, 0);
+    std::fill(stereoModeCount, stereoModeCount + 4, 0);
+    residuals = 0;
+    escapeCodes = 0;
+    parameters = 0;
+    parameterSum = 0.0;
+    riceParameterSum = 0.0;
+    activeStage = PROFILE_STAGE_COUNT;
+    mark = std::chrono::steady_clock::now();
+}
+
+ProfileStage CodecProfile::enter(ProfileStage stage) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (activeStage != PROFILE_STAGE_COUNT) {
+        stageSeconds[activeStage] += std::chrono::duration<double>(now - mark).count();
+    }
+    ProfileStage previous = activeStage;
+    activeStage = stage;
+    mark = now;
+    return previous;
+}
+
+void CodecProfile::leave(ProfileStage previous) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (activeStage != PROFILE_STAGE_COUNT) {
+        stageSeconds[activeStage] += std::chrono::duration<double>(now - mark).count();
+    }
+    activeStage = previous;
+    mark = now;
+}
+
+// One Golomb parameter and the number of residuals coded with it
+void CodecProfile::addParameter(int param, size_t count) {
+    parameters++;
+    parameterSum += param;
+    riceParameterSum += std::log2(static_cast<double>(std::max(param, 1)));
+    residuals += count;
+}
+
+double CodecProfile::totalSeconds() const {
+    double total = 0.0;
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        total += stageSeconds[s];
+    }
+    return total;
+}
+
+double CodecProfile::averageGolombParameter() const {
+    return parameters > 0 ? parameterSum / parameters : 0.0;
+}
+
+double CodecProfile::averageRiceParameter() const {
+    return parameters > 0 ? riceParameterSum / parameters : 0.0;
+}
+
+const char* CodecProfile::stageName(ProfileStage stage) {
+    switch (stage) {
+        case PROFILE_WAV_IO: return "wavIO";
+        case PROFILE_PREDICTION: return "prediction";
+        case PROFILE_PARAMETER_SEARCH: return "parameterSearch";
+        case PROFILE_ENTROPY_CODING: return "entropyCoding";
+        case PROFILE_OUTPUT: return "output";
+        default: return "unknown";
+    }
+}
+
+std::string CodecProfile::toJSON() const {
+    std::ostringstream json;
+    json << "{\n  \"stageSeconds\": {";
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        json << (s > 0 ? ", " : "") << "\"" << stageName(static_cast<ProfileStage>(s)) << "\": "
+             << stageSeconds[s];
+    }
+    json << "},\n  \"totalSeconds\": " << totalSeconds() << ",\n";
+    json << "  \"frames\": " << frames << ",\n  \"subframeTypes\": {";
+    for (int t = 0; t < SUBFRAME_TYPE_COUNT; t++) {
+        json << (t > 0 ? ", " : "") << "\"" << subframeTypeName(static_cast<SubframeType>(t)) << "\": " << subframeTypeCount[t];
+    }
+    json << "},\n  \"stereoModes\": {";
+    for (int m = 0; m < 4; m++) {
+        json << (m > 0 ? ", " : "") << "\"" << stereoModeName(static_cast<StereoMode>(m)) << "\": " << stereoModeCount[m];
+    }
+    json << "},\n";
+    json << "  \"residuals\": " << residuals << ",\n";
+    json << "  \"escapeCodes\": " << escapeCodes << ",\n";
+    json << "  \"golombParameters\": " << parameters << ",\n";
+    json << "  \"averageGolombParameter\": " << averageGolombParameter() << ",\n";
+    json << "  \"averageRiceParameter\": " << averageRiceParameter() << "\n}";
+    return json.str();
+}
+
+void CodecProfile::print() const {
+    double total = totalSeconds();
+    std::cout << "=== Codec Profile ===" << std::endl;
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        std::cout << stageName(static_cast<ProfileStage>(s)) << ": " << stageSeconds[s] * 1000.0 << " ms ("
+                  << (total > 0.0 ? 100.0 * stageSeconds[s] / total : 0.0) << "%)" << std::endl;
+    }
+    std::cout << "Frames: " << frames << std::endl;
+    std::cout << "Residuals: " << residuals << " (" << escapeCodes << " escape codes)" << std::endl;
+    std::cout << "Golomb Parameters: " << parameters << ", mean " << averageGolombParameter()
+              << " (Rice k " << averageRiceParameter() << ")" << std::endl;
+}
@@ -0,0 +1,74 @@
+#ifndef CODEC_PROFILE_H
+#define CODEC_PROFILE_H
+
+#include "AudioCodec.h"
+#include <chrono>
+#include <string>
+#include <cstddef>
+
+// Where the time of an encode or decode goes
+enum ProfileStage {
+    PROFILE_WAV_IO = 0,           // Reading and writing WAV files, converting mapped PCM
+    PROFILE_PREDICTION = 1,       // Residuals, reconstruction and stereo decorrelation
+    PROFILE_PARAMETER_SEARCH = 2, // Choosing subframe types, predictors, partitions and parameters
+    PROFILE_ENTROPY_CODING = 3,   // Writing and reading subframes (Golomb codes)
+    PROFILE_OUTPUT = 4,           // Stream headers, sync frames, frame assembly and copying out
+    PROFILE_STAGE_COUNT
+};
+
+// Per-stage timing and coding counters, filled in by an AudioCodec and/or a
+// WAVFile it is attached to (setProfile). Nothing is recorded, and the cost is
+// a null pointer test per instrumented call, while no profile is attached.
+// Counts accumulate over every encode and decode until clear().
+struct CodecProfile {
+    double stageSeconds[PROFILE_STAGE_COUNT];
+    size_t frames;
+    size_t subframeTypeCount[SUBFRAME_TYPE_COUNT];
+    size_t stereoModeCount[4];
+    size_t residuals;        // Golomb-coded values
+    size_t escapeCodes;      // Of those, sent as escape codes
+    size_t parameters;       // Golomb parameters used (one per partition or run subframe)
+    double parameterSum;
+    double riceParameterSum; // log2 of each parameter
+    
+    // Timer state (see ProfileTimer)
+    ProfileStage activeStage;
+    std::chrono::steady_clock::time_point mark;
+    
+    CodecProfile();
+    void clear();
+    
+    // Stage changes: charge the time since the last change to the active
+    // stage. enter returns the stage to give back to leave.
+    ProfileStage enter(ProfileStage stage);
+    void leave(ProfileStage previous);
+    
+    void addParameter(int param, size_t count);
+    
+    double totalSeconds() const;
+    double averageGolombParameter() const;
+    double averageRiceParameter() const; // Rice k of the mean parameter width
+    static const char* stageName(ProfileStage stage);
+    
+    std::string toJSON() const;
+    void print() const;
+};
+
+// Charges the time until it goes out of scope to one stage (nothing if
+// profile is NULL). Timers nest: an inner stage's time is not charged to
+// the stage around it.
+class ProfileTimer {
+private:
+    CodecProfile* profile;
+    ProfileStage previous;
+
+public:
+    ProfileTimer(CodecProfile* target, ProfileStage stage) : profile(target), previous(PROFILE_STAGE_COUNT) {
+        if (profile) previous = profile->enter(stage);
+    }
+    ~ProfileTimer() {
+        if (profile) profile->leave(previous);
+    }
+};
+
+#endif // CODEC_PROFILE_H
@@ -0,0 +1,42 @@
+#include "FFT.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void fft(std::vector<std::complex<double> >& data, bool inverse) {
+    size_t n = data.size();
+    
+    // Bit-reversal permutation
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) std::swap(data[i], data[j]);
+    }
+    
+    for (size_t length = 2; length <= n; length <<= 1) {
+        double angle = 2.0 * M_PI / length * (inverse ? 1.0 : -1.0);
+        std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (size_t start = 0; start < n; start += length) {
+            std::complex<double> w(1.0, 0.0);
+            for (size_t k = 0; k < length / 2; k++) {
+                std::complex<double> even = data[start + k];
+                std::complex<double> odd = data[start + k + length / 2] * w;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                w *= step;
+            }
+        }
+    }
+    
+    if (inverse) {
+        for (size_t i = 0; i < n; i++) {
+            data[i] /= static_cast<double>(n);
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+#include <complex>
+
+// In-place iterative radix-2 FFT; the size must be a power of two. The
+// inverse transform is scaled by 1/size, so fft(fft(x), true) == x.
+void fft(std::vector<std::complex<double> >& data, bool inverse);
+
+#endif // FFT_H
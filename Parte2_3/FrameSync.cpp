@@ -0,0 +1,90 @@
+#include "FrameSync.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const uint8_t SYNC_HIGH = static_cast<uint8_t>(FRAME_SYNC_CODE >> 8);
+static const uint8_t SYNC_LOW = static_cast<uint8_t>(FRAME_SYNC_CODE & 0xFF);
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+static int lowestSetBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void packBits(const std::vector<bool>& bits, std::vector<uint8_t>& bytes) {
+    bytes.assign((bits.size() + 7) / 8, 0);
+    for (size_t i = 0; i < bits.size(); i++) {
+        if (bits[i]) {
+            bytes[i >> 3] |= static_cast<uint8_t>(0x80 >> (i & 7));
+        }
+    }
+}
+
+// Compare each position with the first sync byte and the position after it
+// with the second, and take the first position where both match
+size_t findSyncCode(const uint8_t* data, size_t size, size_t start) {
+    size_t i = start;
+
+#if defined(__AVX2__)
+    const __m256i high = _mm256_set1_epi8(static_cast<char>(SYNC_HIGH));
+    const __m256i low = _mm256_set1_epi8(static_cast<char>(SYNC_LOW));
+    for (; i + 33 <= size; i += 32) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(first, high), _mm256_cmpeq_epi8(second, low));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        if (mask != 0) return i + lowestSetBit(mask);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i high = _mm_set1_epi8(static_cast<char>(SYNC_HIGH));
+    const __m128i low = _mm_set1_epi8(static_cast<char>(SYNC_LOW));
+    for (; i + 17 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i match = _mm_and_si128(_mm_cmpeq_epi8(first, high), _mm_cmpeq_epi8(second, low));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+        if (mask != 0) return i + lowestSetBit(mask);
+    }
+#endif
+
+    for (; i + 1 < size; i++) {
+        if (data[i] == SYNC_HIGH && data[i + 1] == SYNC_LOW) return i;
+    }
+    return size;
+}
@@ -0,0 +1,31 @@
+#ifndef FRAME_SYNC_H
+#define FRAME_SYNC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Resynchronizable frames: each frame starts on a byte boundary with
+//   sync code (16) | frame number (32) | payload length in bits (32) | CRC-8 (8)
+// where the CRC-8 covers the 10 bytes before it, followed by the payload
+// (zero-padded to a byte) and a CRC-16 of the padded payload. A decoder that
+// loses its place searches the bytes for the next sync code whose header
+// CRC checks, and resumes there.
+
+const uint16_t FRAME_SYNC_CODE = 0xFFF8;
+const size_t FRAME_HEADER_BYTES = 11;
+const size_t FRAME_TRAILER_BYTES = 2;
+
+// CRC-8 (polynomial 0x07) and CRC-16 (polynomial 0x8005), both starting from
+// zero, as in FLAC frame headers and footers
+uint8_t crc8(const uint8_t* data, size_t length);
+uint16_t crc16(const uint8_t* data, size_t length);
+
+// Pack bits (most significant first) into bytes; the last byte is zero-padded
+void packBits(const std::vector<bool>& bits, std::vector<uint8_t>& bytes);
+
+// Index of the first byte at or after start that begins the sync code, or
+// size if there is none. SSE2/AVX2 compare 16/32 candidate positions at once.
+size_t findSyncCode(const uint8_t* data, size_t size, size_t start);
+
+#endif // FRAME_SYNC_H
@@ -0,0 +1,146 @@
+#include "FrameTrace.h"
+#include "AudioCodec.h"
+#include <cstring>
+
+FrameTrace::FrameTrace(std::ostream& stream, TraceFormat traceFormat)
+    : out(stream), format(traceFormat), frames(0) {
+    if (format == TRACE_CSV) {
+        out << "frame,start,samples,bits,encode_us,stereo_modes,subframe_types,orders,subframe_bits,parameters\n";
+    } else {
+        out.write("ACTR", 4);
+        out.put(static_cast<char>(BINARY_VERSION));
+    }
+}
+
+static void putInteger(std::vector<char>& buffer, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static bool getInteger(std::istream& in, uint32_t& value, int bytes) {
+    unsigned char raw[4];
+    if (!in.read(reinterpret_cast<char*>(raw), bytes)) return false;
+    value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | raw[i];
+    }
+    return true;
+}
+
+void FrameTrace::write(const FrameTraceRecord& record) {
+    frames++;
+    
+    if (format == TRACE_CSV) {
+        out << record.frame << ',' << record.start << ',' << record.samples << ',' << record.bits << ','
+            << record.encodeMicroseconds << ',';
+        for (size_t i = 0; i < record.stereoModes.size(); i++) {
+            out << (i > 0 ? ";" : "") << stereoModeName(static_cast<StereoMode>(record.stereoModes[i]));
+        }
+        out << ',';
+        for (size_t i = 0; i < record.subframes.size(); i++) {
+            out << (i > 0 ? ";" : "") << subframeTypeName(static_cast<SubframeType>(record.subframes[i].type));
+        }
+        out << ',';
+        for (size_t i = 0; i < record.subframes.size(); i++) {
+            out << (i > 0 ? ";" : "") << record.subframes[i].order;
+        }
+        out << ',';
+        for (size_t i = 0; i < record.subframes.size(); i++) {
+            out << (i > 0 ? ";" : "") << record.subframes[i].bits;
+        }
+        out << ',';
+        for (size_t i = 0; i < record.subframes.size(); i++) {
+            const std::vector<int>& parameters = record.subframes[i].parameters;
+            out << (i > 0 ? ";" : "");
+            for (size_t p = 0; p < parameters.size(); p++) {
+                out << (p > 0 ? " " : "") << parameters[p];
+            }
+        }
+        out << '\n';
+        return;
+    }
+    
+    buffer.clear();
+    putInteger(buffer, static_cast<uint32_t>(record.frame), 4);
+    putInteger(buffer, static_cast<uint32_t>(record.start), 4);
+    putInteger(buffer, static_cast<uint32_t>(record.samples), 4);
+    putInteger(buffer, static_cast<uint32_t>(record.bits), 4);
+    float time = static_cast<float>(record.encodeMicroseconds);
+    uint32_t timeBits;
+    std::memcpy(&timeBits, &time, 4);
+    putInteger(buffer, timeBits, 4);
+    
+    putInteger(buffer, static_cast<uint32_t>(record.stereoModes.size()), 1);
+    for (size_t i = 0; i < record.stereoModes.size(); i++) {
+        putInteger(buffer, static_cast<uint32_t>(record.stereoModes[i]), 1);
+    }
+    putInteger(buffer, static_cast<uint32_t>(record.subframes.size()), 1);
+    for (size_t i = 0; i < record.subframes.size(); i++) {
+        const SubframeTrace& subframe = record.subframes[i];
+        putInteger(buffer, static_cast<uint32_t>(subframe.type), 1);
+        putInteger(buffer, static_cast<uint32_t>(subframe.order), 1);
+        putInteger(buffer, static_cast<uint32_t>(subframe.bits), 4);
+        putInteger(buffer, static_cast<uint32_t>(subframe.parameters.size()), 2);
+        for (size_t p = 0; p < subframe.parameters.size(); p++) {
+            putInteger(buffer, static_cast<uint32_t>(subframe.parameters[p]), 4);
+        }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+size_t FrameTrace::getFrameCount() const {
+    return frames;
+}
+
+bool FrameTrace::readBinary(std::istream& in, std::vector<FrameTraceRecord>& records) {
+    records.clear();
+    char signature[5];
+    if (!in.read(signature, 5) || std::memcmp(signature, "ACTR", 4) != 0 ||
+        static_cast<uint8_t>(signature[4]) != BINARY_VERSION) {
+        return false;
+    }
+    
+    uint32_t value;
+    while (in.peek() != std::char_traits<char>::eof()) {
+        FrameTraceRecord record;
+        if (!getInteger(in, value, 4)) return false;
+        record.frame = value;
+        uint32_t timeBits, count;
+        if (!getInteger(in, value, 4)) return false;
+        record.start = value;
+        if (!getInteger(in, value, 4)) return false;
+        record.samples = value;
+        if (!getInteger(in, value, 4)) return false;
+        record.bits = value;
+        if (!getInteger(in, timeBits, 4)) return false;
+        float time;
+        std::memcpy(&time, &timeBits, 4);
+        record.encodeMicroseconds = time;
+        
+        if (!getInteger(in, count, 1)) return false;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!getInteger(in, value, 1)) return false;
+            record.stereoModes.push_back(static_cast<int>(value));
+        }
+        if (!getInteger(in, count, 1)) return false;
+        record.subframes.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            SubframeTrace& subframe = record.subframes[i];
+            uint32_t partitions;
+            if (!getInteger(in, value, 1)) return false;
+            subframe.type = static_cast<int>(value);
+            if (!getInteger(in, value, 1)) return false;
+            subframe.order = static_cast<int>(value);
+            if (!getInteger(in, value, 4)) return false;
+            subframe.bits = value;
+            if (!getInteger(in, partitions, 2)) return false;
+            for (uint32_t p = 0; p < partitions; p++) {
+                if (!getInteger(in, value, 4)) return false;
+                subframe.parameters.push_back(static_cast<int>(value));
+            }
+        }
+        records.push_back(record);
+    }
+    return true;
+}
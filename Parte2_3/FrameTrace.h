@@ -0,0 +1,67 @@
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <vector>
+#include <ostream>
+#include <istream>
+#include <cstdint>
+#include <cstddef>
+
+// How one subframe (one channel of one frame) was coded
+struct SubframeTrace {
+    int type;                    // SubframeType
+    int order;                   // Predictor order (0 for constant, verbatim and the adaptive predictors)
+    size_t bits;
+    std::vector<int> parameters; // Golomb parameter of each residual partition
+};
+
+// One frame of an encode: its subframes in stream order and the stereo mode
+// of each channel pair
+struct FrameTraceRecord {
+    size_t frame;
+    size_t start;  // First sample of the frame (per channel)
+    size_t samples;
+    size_t bits;   // Including the sync frame wrapping, if any
+    double encodeMicroseconds;
+    std::vector<int> stereoModes;
+    std::vector<SubframeTrace> subframes;
+};
+
+enum TraceFormat {
+    TRACE_CSV = 0,
+    TRACE_BINARY = 1
+};
+
+// Per-frame trace of the encoders, written to a stream as each frame is
+// finished (AudioCodec::setTrace).
+//
+// CSV: a header line, then one line per frame with the columns
+//   frame,start,samples,bits,encode_us,stereo_modes,subframe_types,orders,subframe_bits,parameters
+// where the per-pair and per-subframe columns are lists separated by ';'
+// (and the parameters of one subframe by spaces).
+//
+// Binary (little endian): "ACTR" and a version byte, then per frame
+//   frame u32 | start u32 | samples u32 | bits u32 | encode_us f32 |
+//   pairs u8 | mode u8 * pairs | subframes u8 |
+//   per subframe: type u8 | order u8 | bits u32 | partitions u16 | parameter u32 * partitions
+class FrameTrace {
+private:
+    std::ostream& out;
+    TraceFormat format;
+    size_t frames;
+    std::vector<char> buffer; // One binary record
+
+public:
+    static const uint8_t BINARY_VERSION = 1;
+    
+    // Writes the CSV header or the binary signature
+    FrameTrace(std::ostream& out, TraceFormat format);
+    
+    void write(const FrameTraceRecord& record);
+    size_t getFrameCount() const;
+    
+    // Read a whole binary trace; false if it is not one or is truncated
+    static bool readBinary(std::istream& in, std::vector<FrameTraceRecord>& records);
+};
+
+#endif // FRAME_TRACE_H
@@ -4,7 +4,7 @@
 #include <stdexcept>
 
 // Constructor
-GolombCoding::GolombCoding(int parameter) : m(parameter) {
+GolombCoding::GolombCoding(int parameter) : m(parameter), escapeLimit(0), escapes(0) {
     if (m <= 0) {
         throw std::invalid_argument("Golomb parameter m must be positive");
     }
@@ -27,6 +27,31 @@ int GolombCoding::getParameter() const {
     return m;
 }
 
+// Set escape limit (0 disables escape codes)
+void GolombCoding::setEscapeLimit(int limit) {
+    if (limit < 0) {
+        throw std::invalid_argument("Escape limit must not be negative");
+    }
+    escapeLimit = limit;
+}
+
+int GolombCoding::getEscapeLimit() const {
+    return escapeLimit;
+}
+
+size_t GolombCoding::getEscapeCount() const {
+    return escapes;
+}
+
+// Number of significant bits in n (at least 1)
+static int bitLength(uint64_t n) {
+    int length = 1;
+    while (length < 64 && (n >> length) != 0) {
+        length++;
+    }
+    return length;
+}
+
 // Encode a non-negative integer
 std::vector<bool> GolombCoding::encode(int n) {
     if (n < 0) {
@@ -34,32 +59,48 @@ std::vector<bool> GolombCoding::encode(int n) {
     }
 
     std::vector<bool> result;
-    
+    encode(static_cast<uint64_t>(n), result);
+    return result;
+}
+
+// Encode a non-negative integer, appending to the bitstream
+void GolombCoding::encode(uint64_t n, std::vector<bool>& bitstream) {
     // Calculate quotient and remainder
-    int q = n / m;
-    int r = n % m;
+    uint64_t q = n / m;
+    int r = static_cast<int>(n % m);
     
-    // Unary code for quotient: q zeros followed by a 1
-    for (int i = 0; i < q; i++) {
-        result.push_back(false);
+    // Escape: fixed-size prefix followed by the raw value
+    if (escapeLimit > 0 && q >= static_cast<uint64_t>(escapeLimit)) {
+        escapes++;
+        bitstream.insert(bitstream.end(), escapeLimit, false);
+        bitstream.push_back(true);
+        int length = bitLength(n);
+        for (int i = 5; i >= 0; i--) {
+            bitstream.push_back(((length - 1) >> i) & 1);
+        }
+        for (int i = length - 1; i >= 0; i--) {
+            bitstream.push_back((n >> i) & 1);
+        }
+        return;
     }
-    result.push_back(true);
+    
+    // Unary code for quotient: q zeros followed by a 1
+    bitstream.insert(bitstream.end(), q, false);
+    bitstream.push_back(true);
     
     // Binary code for remainder
     if (r < cutoff) {
         // Use b-1 bits
         for (int i = b - 2; i >= 0; i--) {
-            result.push_back((r >> i) & 1);
+            bitstream.push_back((r >> i) & 1);
         }
     } else {
         // Use b bits (add cutoff to remainder)
         int r_adjusted = r + cutoff;
         for (int i = b - 1; i >= 0; i--) {
-            result.push_back((r_adjusted >> i) & 1);
+            bitstream.push_back((r_adjusted >> i) & 1);
         }
     }
-    
-    return result;
 }
 
 // Encode using sign and magnitude approach
@@ -81,19 +122,31 @@ std::vector<bool> GolombCoding::encodeSignMagnitude(int n) {
     return result;
 }
 
-// Encode using positive/negative interleaving approach
-std::vector<bool> GolombCoding::encodeInterleaving(int n) {
-    int mapped;
-    
-    // Map negative and positive numbers to non-negative integers
-    // 0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, 2 -> 4, -3 -> 5, 3 -> 6, ...
-    if (n >= 0) {
-        mapped = 2 * n;
+// Map negative and positive numbers to non-negative integers
+// 0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, 2 -> 4, -3 -> 5, 3 -> 6, ...
+static uint64_t interleave(int64_t n) {
+    return n >= 0 ? 2 * static_cast<uint64_t>(n) : 2 * static_cast<uint64_t>(-(n + 1)) + 1;
+}
+
+// Reverse the interleaving map
+static int64_t deinterleave(uint64_t mapped) {
+    if (mapped % 2 == 0) {
+        return static_cast<int64_t>(mapped / 2);  // Even -> positive
     } else {
-        mapped = -2 * n - 1;
+        return -static_cast<int64_t>(mapped / 2) - 1;  // Odd -> negative
     }
-    
-    return encode(mapped);
+}
+
+// Encode using positive/negative interleaving approach
+std::vector<bool> GolombCoding::encodeInterleaving(int n) {
+    std::vector<bool> result;
+    encode(interleave(n), result);
+    return result;
+}
+
+// Encode using interleaving, appending to the bitstream
+void GolombCoding::encodeInterleaving(int64_t n, std::vector<bool>& bitstream) {
+    encode(interleave(n), bitstream);
 }
 
 // Decode a Golomb-coded sequence
@@ -102,41 +155,72 @@ int GolombCoding::decode(const std::vector<bool>& bits) {
         throw std::invalid_argument("Empty bit sequence");
     }
     
-    // Read unary code for quotient
-    int q = 0;
     size_t pos = 0;
-    while (pos < bits.size() && !bits[pos]) {
+    return static_cast<int>(decode(bits, pos));
+}
+
+// Decode one codeword from a bitstream, starting at pos
+uint64_t GolombCoding::decode(const std::vector<bool>& bitstream, size_t& pos) {
+    // Read unary code for quotient
+    uint64_t q = 0;
+    while (pos < bitstream.size() && !bitstream[pos]) {
         q++;
         pos++;
+        if (escapeLimit > 0 && q > static_cast<uint64_t>(escapeLimit)) {
+            throw std::invalid_argument("Invalid Golomb code: unary part exceeds escape limit");
+        }
     }
     
-    if (pos >= bits.size()) {
+    if (pos >= bitstream.size()) {
         throw std::invalid_argument("Invalid Golomb code: no terminator for unary code");
     }
     
     pos++; // Skip the terminator '1'
     
+    // Escaped value: 6-bit length followed by the raw value
+    if (escapeLimit > 0 && q == static_cast<uint64_t>(escapeLimit)) {
+        if (pos + 6 > bitstream.size()) {
+            throw std::invalid_argument("Invalid Golomb code: truncated escape");
+        }
+        int length = 1;
+        for (int i = 0; i < 6; i++) {
+            length += (bitstream[pos++] ? 1 : 0) << (5 - i);
+        }
+        if (pos + length > bitstream.size()) {
+            throw std::invalid_argument("Invalid Golomb code: truncated escape");
+        }
+        uint64_t n = 0;
+        for (int i = 0; i < length; i++) {
+            n = (n << 1) | (bitstream[pos++] ? 1 : 0);
+        }
+        escapes++;
+        return n;
+    }
+    
+    // m = 1 has no remainder bits at all
+    if (b == 0) {
+        return q;
+    }
+    
     // Read binary code for remainder
     int r = 0;
     
     // First, try to read b-1 bits
-    if (pos + (b - 1) > bits.size()) {
+    if (pos + (b - 1) > bitstream.size()) {
         throw std::invalid_argument("Invalid Golomb code: insufficient bits for remainder");
     }
     
     for (int i = 0; i < b - 1; i++) {
-        r = (r << 1) | (bits[pos++] ? 1 : 0);
+        r = (r << 1) | (bitstream[pos++] ? 1 : 0);
     }
     
     // Check if we need the additional bit
-    if (r < cutoff) {
-        // r is correct with b-1 bits
-    } else {
+    if (r >= cutoff) {
         // Need to read one more bit
-        if (pos >= bits.size()) {
+        if (pos >= bitstream.size()) {
             throw std::invalid_argument("Invalid Golomb code: insufficient bits for remainder");
         }
-        r = (r << 1) | (bits[pos++] ? 1 : 0);
+        r = (r << 1) | (bitstream[pos++] ? 1 : 0);
         r -= cutoff;
     }
     
@@ -161,14 +245,35 @@ int GolombCoding::decodeSignMagnitude(const std::vector<bool>& bits) {
 
 // Decode using positive/negative interleaving approach
 int GolombCoding::decodeInterleaving(const std::vector<bool>& bits) {
-    int mapped = decode(bits);
+    if (bits.empty()) {
+        throw std::invalid_argument("Empty bit sequence");
+    }
     
-    // Reverse the mapping
-    if (mapped % 2 == 0) {
-        return mapped / 2;  // Even -> positive
-    } else {
-        return -(mapped + 1) / 2;  // Odd -> negative
+    size_t pos = 0;
+    return static_cast<int>(deinterleave(decode(bits, pos)));
+}
+
+// Decode one interleaved codeword from a bitstream, starting at pos
+int64_t GolombCoding::decodeInterleaving(const std::vector<bool>& bitstream, size_t& pos) {
+    return deinterleave(decode(bitstream, pos));
+}
+
+// Codeword length for a non-negative integer
+size_t GolombCoding::codeLength(uint64_t n) const {
+    uint64_t q = n / m;
+    if (escapeLimit > 0 && q >= static_cast<uint64_t>(escapeLimit)) {
+        return escapeLimit + 1 + 6 + bitLength(n);
+    }
+    if (b == 0) {
+        return q + 1;
     }
+    int r = static_cast<int>(n % m);
+    return q + 1 + (r < cutoff ? b - 1 : b);
+}
+
+// Codeword length for a signed integer under the interleaving map
+size_t GolombCoding::codeLengthInterleaving(int64_t n) const {
+    return codeLength(interleave(n));
 }
 
 // Convert bit vector to string for display
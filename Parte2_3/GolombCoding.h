@@ -3,12 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 class GolombCoding {
 private:
     int m; // Golomb parameter
     int b; // Number of bits for remainder
     int cutoff; // Cutoff value for unary code
+    int escapeLimit; // Quotients >= escapeLimit are escaped (0 = never)
+    size_t escapes;  // Escape codes written or read
 
 public:
     // Constructor
@@ -19,10 +22,30 @@ public:
     std::vector<bool> encodeSignMagnitude(int n);
     std::vector<bool> encodeInterleaving(int n);
 
+    // Append the codeword directly to an existing bitstream
+    // (64-bit so residuals of 24/32-bit audio cannot overflow)
+    void encode(uint64_t n, std::vector<bool>& bitstream);
+    void encodeInterleaving(int64_t n, std::vector<bool>& bitstream);
+    
     // Decoding functions
     int decode(const std::vector<bool>& bits);
     int decodeSignMagnitude(const std::vector<bool>& bits);
     int decodeInterleaving(const std::vector<bool>& bits);
+    
+    // Decode one codeword starting at pos (pos is advanced past it)
+    uint64_t decode(const std::vector<bool>& bitstream, size_t& pos);
+    int64_t decodeInterleaving(const std::vector<bool>& bitstream, size_t& pos);
+    
+    // Length in bits of the codeword for n, without producing it
+    size_t codeLength(uint64_t n) const;
+    size_t codeLengthInterleaving(int64_t n) const;
+    
+    // Escape codes bound the codeword length: a quotient of escapeLimit or more is
+    // sent as escapeLimit zeros, a one, a 6-bit length L-1 and n in L bits
+    void setEscapeLimit(int limit);
+    int getEscapeLimit() const;
+    // Escape codes written or read since construction
+    size_t getEscapeCount() const;
 
     // Helper functions
     std::string bitsToString(const std::vector<bool>& bits);
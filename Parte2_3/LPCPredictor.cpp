@@ -0,0 +1,136 @@
+#include "LPCPredictor.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Tukey window with half of the frame tapered
+static double tukeyWindow(size_t i, size_t n) {
+    const double p = 0.5;
+    size_t taper = static_cast<size_t>(p / 2.0 * n);
+    if (taper == 0 || n < 2) return 1.0;
+    if (i < taper) {
+        return 0.5 - 0.5 * std::cos(M_PI * i / taper);
+    }
+    if (i >= n - taper) {
+        return 0.5 - 0.5 * std::cos(M_PI * (n - 1 - i) / taper);
+    }
+    return 1.0;
+}
+
+void computeAutocorrelation(const int32_t* samples, size_t n, int maxLag, std::vector<double>& autocorrelation,
+                            std::vector<double>& windowed) {
+    windowed.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        windowed[i] = samples[i] * tukeyWindow(i, n);
+    }
+    
+    autocorrelation.assign(maxLag + 1, 0.0);
+    for (int lag = 0; lag <= maxLag; lag++) {
+        double sum = 0.0;
+        for (size_t i = lag; i < n; i++) {
+            sum += windowed[i] * windowed[i - lag];
+        }
+        autocorrelation[lag] = sum;
+    }
+}
+
+int computeLPCCoefficients(const std::vector<double>& autocorrelation, int maxOrder,
+                           std::vector<std::vector<double> >& coefficients, std::vector<double>& errors) {
+    errors.clear();
+    if (autocorrelation.empty() || autocorrelation[0] <= 0.0) return 0;
+    if (coefficients.size() < static_cast<size_t>(maxOrder)) {
+        coefficients.resize(maxOrder);
+    }
+    double error = autocorrelation[0];
+    
+    // Each order is built from the previous one
+    for (int order = 0; order < maxOrder; order++) {
+        const double* previous = order > 0 ? coefficients[order - 1].data() : NULL;
+        
+        // Reflection coefficient
+        double acc = -autocorrelation[order + 1];
+        for (int j = 0; j < order; j++) {
+            acc += previous[j] * autocorrelation[order - j];
+        }
+        double reflection = acc / error;
+        
+        std::vector<double>& current = coefficients[order];
+        current.resize(order + 1);
+        current[order] = -reflection;
+        for (int j = 0; j < order; j++) {
+            current[j] = previous[j] + reflection * previous[order - 1 - j];
+        }
+        
+        error *= 1.0 - reflection * reflection;
+        if (error <= 0.0 || !std::isfinite(error)) break;
+        errors.push_back(error);
+    }
+    
+    return static_cast<int>(errors.size());
+}
+
+double expectedBitsPerSample(double error, size_t n) {
+    if (error <= 0.0 || n == 0) return 0.0;
+    double bits = 0.5 * std::log(error / n) / std::log(2.0);
+    return std::max(bits, 0.0);
+}
+
+bool quantizeLPCCoefficients(const std::vector<double>& coefficients, int precision,
+                             std::vector<int32_t>& quantized, int& shift) {
+    double maxMagnitude = 0.0;
+    for (size_t j = 0; j < coefficients.size(); j++) {
+        maxMagnitude = std::max(maxMagnitude, std::fabs(coefficients[j]));
+    }
+    if (maxMagnitude <= 0.0) return false;
+    
+    // Largest shift that keeps every coefficient within precision bits
+    int exponent;
+    std::frexp(maxMagnitude, &exponent);
+    shift = std::min(precision - 1 - exponent, MAX_LPC_SHIFT);
+    if (shift < 0) return false;
+    
+    // Round with error feedback so the quantization error does not accumulate
+    int32_t limit = (1 << (precision - 1)) - 1;
+    double carry = 0.0;
+    quantized.resize(coefficients.size());
+    for (size_t j = 0; j < coefficients.size(); j++) {
+        carry += coefficients[j] * (1 << shift);
+        long q = std::lround(carry);
+        q = std::max<long>(-limit - 1, std::min<long>(limit, q));
+        carry -= q;
+        quantized[j] = static_cast<int32_t>(q);
+    }
+    return true;
+}
+
+void computeLPCResiduals(const int32_t* samples, size_t n, const std::vector<int32_t>& coefficients,
+                         int shift, std::vector<int64_t>& residuals) {
+    size_t order = coefficients.size();
+    residuals.clear();
+    if (n <= order) return;
+    residuals.reserve(n - order);
+    
+    for (size_t i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (size_t j = 0; j < order; j++) {
+            sum += static_cast<int64_t>(coefficients[j]) * samples[i - 1 - j];
+        }
+        residuals.push_back(samples[i] - (sum >> shift));
+    }
+}
+
+void restoreLPCSignal(const std::vector<int64_t>& residuals, const std::vector<int32_t>& coefficients,
+                      int shift, int32_t* samples, size_t n) {
+    size_t order = coefficients.size();
+    
+    for (size_t i = order; i < n && i - order < residuals.size(); i++) {
+        int64_t sum = 0;
+        for (size_t j = 0; j < order; j++) {
+            sum += static_cast<int64_t>(coefficients[j]) * samples[i - 1 - j];
+        }
+        samples[i] = static_cast<int32_t>(residuals[i - order] + (sum >> shift));
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LPC_PREDICTOR_H
+#define LPC_PREDICTOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Linear predictive coding with quantized coefficients (as in FLAC):
+//   prediction[i] = (sum_j coefficients[j] * samples[i - 1 - j]) >> shift
+// Coefficients are found in floating point, but prediction and reconstruction
+// use only the quantized integers, so they are exact on every platform.
+
+// Largest predictor order and quantization limits supported by the stream
+const int MAX_LPC_ORDER = 32;
+const int MIN_LPC_PRECISION = 5;
+const int MAX_LPC_PRECISION = 15;
+const int MAX_LPC_SHIFT = 15;
+
+// Autocorrelation of the Tukey(0.5) windowed signal for lags 0..maxLag
+// (windowed is working space, kept by the caller so it can be reused)
+void computeAutocorrelation(const int32_t* samples, size_t n, int maxLag, std::vector<double>& autocorrelation,
+                            std::vector<double>& windowed);
+
+// Levinson-Durbin recursion: coefficients[k] holds the predictor of order
+// k + 1 and errors[k] its prediction error. Returns the number of orders
+// computed, which is less than maxOrder if the recursion becomes unstable.
+// coefficients is only grown (entries past the returned count are stale),
+// so the vectors of a previous call are reused.
+int computeLPCCoefficients(const std::vector<double>& autocorrelation, int maxOrder,
+                           std::vector<std::vector<double> >& coefficients, std::vector<double>& errors);
+
+// Expected bits per residual sample for a prediction error (used to rank
+// orders without coding them)
+double expectedBitsPerSample(double error, size_t n);
+
+// Quantize coefficients to precision bits (including sign). Returns false if
+// no shift in [0, MAX_LPC_SHIFT] fits.
+bool quantizeLPCCoefficients(const std::vector<double>& coefficients, int precision,
+                             std::vector<int32_t>& quantized, int& shift);
+
+// Residuals for samples order..n-1
+void computeLPCResiduals(const int32_t* samples, size_t n, const std::vector<int32_t>& coefficients,
+                         int shift, std::vector<int64_t>& residuals);
+
+// Inverse of computeLPCResiduals; samples[0..order-1] must hold the warm-up
+void restoreLPCSignal(const std::vector<int64_t>& residuals, const std::vector<int32_t>& coefficients,
+                      int shift, int32_t* samples, size_t n);
+
+#endif // LPC_PREDICTOR_H
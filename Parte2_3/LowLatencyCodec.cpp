@@ -0,0 +1,252 @@
+#include "LowLatencyCodec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+// Golomb quotients of this size or more are escaped, bounding every codeword
+static const int ESCAPE_LIMIT = 32;
+
+// Rice parameter context: starting mean, and the count at which the sums are
+// halved so the mean follows the recent residuals
+static const uint64_t INITIAL_MAGNITUDE = 16;
+static const uint64_t CONTEXT_RESET = 64;
+static const int MAX_RICE_PARAMETER = 30;
+
+// Lower edge of the latency histogram, in microseconds (faster calls share
+// the first bucket, and calls over about 2 s the last)
+static const double MIN_LATENCY = 0.001;
+
+static uint64_t interleave(int64_t value) {
+    return value >= 0 ? static_cast<uint64_t>(value) * 2 : static_cast<uint64_t>(-value) * 2 - 1;
+}
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+LowLatencyCodec::LowLatencyCodec(const AudioInfo& audioInfo, int size)
+    : info(audioInfo), frameSize(size), golomb(1) {
+    if (info.channels == 0) {
+        throw std::invalid_argument("Low-latency stream needs at least one channel");
+    }
+    if (size < MIN_FRAME_SIZE || size > MAX_FRAME_SIZE) {
+        throw std::invalid_argument("Low-latency frame size must be between 64 and 256 samples");
+    }
+    golomb.setEscapeLimit(ESCAPE_LIMIT);
+    reset();
+}
+
+void LowLatencyCodec::reset() {
+    ChannelState initial = ChannelState();
+    initial.order = 2;
+    initial.magnitudeSum = INITIAL_MAGNITUDE;
+    initial.count = 1;
+    state.assign(info.channels, initial);
+}
+
+// Fixed polynomial predictors of order 0 to 3 (history newest first)
+int64_t LowLatencyCodec::predictFixed(const int64_t* history, int order) {
+    switch (order) {
+        case 0: return 0;
+        case 1: return history[0];
+        case 2: return 2 * history[0] - history[1];
+        default: return 3 * history[0] - 3 * history[1] + history[2];
+    }
+}
+
+// Smallest k with count * 2^k >= the sum of interleaved residuals
+int LowLatencyCodec::riceParameter(const ChannelState& channel) const {
+    int k = 0;
+    while (k < MAX_RICE_PARAMETER && (channel.count << k) < channel.magnitudeSum) {
+        k++;
+    }
+    return k;
+}
+
+// After one sample: cost every candidate, shift the histories and adapt the
+// Rice context to the residual that was coded
+void LowLatencyCodec::update(ChannelState& channel, const int64_t* signals, int64_t residual) {
+    for (int s = 0; s < 2; s++) {
+        for (int o = 0; o < FIXED_ORDERS; o++) {
+            int64_t error = signals[s] - predictFixed(channel.history[s], o);
+            channel.cost[s][o] += static_cast<uint64_t>(std::llabs(error));
+        }
+        channel.history[s][2] = channel.history[s][1];
+        channel.history[s][1] = channel.history[s][0];
+        channel.history[s][0] = signals[s];
+    }
+    
+    channel.magnitudeSum += interleave(residual);
+    if (++channel.count >= CONTEXT_RESET) {
+        channel.magnitudeSum = (channel.magnitudeSum + 1) / 2;
+        channel.count /= 2;
+    }
+}
+
+// The predictor for the next frame is the one that would have coded this one best
+void LowLatencyCodec::chooseNextPredictor(ChannelState& channel, bool allowDifference) {
+    uint64_t best = channel.cost[0][channel.order];
+    channel.signal = 0;
+    for (int s = 0; s < (allowDifference ? 2 : 1); s++) {
+        for (int o = 0; o < FIXED_ORDERS; o++) {
+            if (channel.cost[s][o] < best) {
+                best = channel.cost[s][o];
+                channel.signal = s;
+                channel.order = o;
+            }
+        }
+    }
+    std::fill(&channel.cost[0][0], &channel.cost[0][0] + 2 * FIXED_ORDERS, 0);
+}
+
+void LowLatencyCodec::encodeFrame(const int32_t* samples, size_t frames, std::vector<bool>& packet) {
+    if (frames > static_cast<size_t>(frameSize)) {
+        throw std::invalid_argument("Frame longer than the low-latency frame size");
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    int numChannels = info.channels;
+    bool stereo = numChannels == 2;
+    packet.clear();
+    for (size_t i = 0; i < frames; i++) {
+        const int32_t* frame = samples + i * numChannels;
+        for (int c = 0; c < numChannels; c++) {
+            ChannelState& channel = state[c];
+            int64_t signals[2] = {frame[c], stereo && c == 1 ? static_cast<int64_t>(frame[1]) - frame[0] : 0};
+            int64_t residual = signals[channel.signal] -
+                               predictFixed(channel.history[channel.signal], channel.order);
+            golomb.setParameter(1 << riceParameter(channel));
+            golomb.encode(interleave(residual), packet);
+            update(channel, signals, residual);
+        }
+    }
+    for (int c = 0; c < numChannels; c++) {
+        chooseNextPredictor(state[c], stereo && c == 1);
+    }
+    
+    encodeTimes.add(elapsedMicroseconds(start));
+}
+
+void LowLatencyCodec::decodeFrame(const std::vector<bool>& packet, int32_t* samples, size_t frames) {
+    if (frames > static_cast<size_t>(frameSize)) {
+        throw std::invalid_argument("Frame longer than the low-latency frame size");
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    int numChannels = info.channels;
+    bool stereo = numChannels == 2;
+    size_t pos = 0;
+    for (size_t i = 0; i < frames; i++) {
+        int32_t* frame = samples + i * numChannels;
+        for (int c = 0; c < numChannels; c++) {
+            ChannelState& channel = state[c];
+            if (pos >= packet.size()) {
+                throw std::invalid_argument("Truncated low-latency packet");
+            }
+            golomb.setParameter(1 << riceParameter(channel));
+            uint64_t code = golomb.decode(packet, pos);
+            int64_t residual = (code & 1) ? -static_cast<int64_t>((code + 1) / 2) : static_cast<int64_t>(code / 2);
+            
+            int64_t value = predictFixed(channel.history[channel.signal], channel.order) + residual;
+            int64_t signals[2];
+            if (channel.signal == 0) {
+                signals[0] = value;
+                signals[1] = stereo && c == 1 ? value - frame[0] : 0;
+            } else {
+                signals[0] = value + frame[0];
+                signals[1] = value;
+            }
+            frame[c] = static_cast<int32_t>(signals[0]);
+            update(channel, signals, residual);
+        }
+    }
+    for (int c = 0; c < numChannels; c++) {
+        chooseNextPredictor(state[c], stereo && c == 1);
+    }
+    
+    decodeTimes.add(elapsedMicroseconds(start));
+}
+
+int LowLatencyCodec::getFrameSize() const {
+    return frameSize;
+}
+
+double LowLatencyCodec::getFrameDuration() const {
+    return info.sampleRate > 0 ? 1000.0 * frameSize / info.sampleRate : 0.0;
+}
+
+LowLatencyCodec::LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LowLatencyCodec::LatencyHistogram::clear() {
+    std::fill(counts, counts + BUCKETS, 0);
+    frames = 0;
+    max = 0.0;
+}
+
+// Bucket (octave, sub-bucket) covers
+// MIN_LATENCY * 2^octave * [1 + sub / SUB_BUCKETS, 1 + (sub + 1) / SUB_BUCKETS)
+void LowLatencyCodec::LatencyHistogram::add(double microseconds) {
+    frames++;
+    max = std::max(max, microseconds);
+    int bucket = 0;
+    if (microseconds >= MIN_LATENCY) {
+        int exponent;
+        double mantissa = std::frexp(microseconds / MIN_LATENCY, &exponent); // In [0.5, 1)
+        int sub = static_cast<int>((2.0 * mantissa - 1.0) * SUB_BUCKETS);
+        bucket = std::min((exponent - 1) * SUB_BUCKETS + sub, BUCKETS - 1);
+    }
+    counts[bucket]++;
+}
+
+// Nearest-rank percentiles, reported as the upper edge of their bucket
+// (never above the slowest call)
+LatencyStats LowLatencyCodec::LatencyHistogram::percentiles() const {
+    LatencyStats stats;
+    stats.frames = frames;
+    stats.max = max;
+    if (frames == 0) return stats;
+    
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    double* results[] = {&stats.p50, &stats.p99, &stats.p999};
+    int bucket = 0;
+    uint64_t seen = counts[0];
+    for (int q = 0; q < 3; q++) {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(quantiles[q] * frames));
+        while (seen < rank && bucket < BUCKETS - 1) {
+            seen += counts[++bucket];
+        }
+        double edge = std::ldexp(MIN_LATENCY * (1.0 + static_cast<double>(bucket % SUB_BUCKETS + 1) / SUB_BUCKETS),
+                                 bucket / SUB_BUCKETS);
+        *results[q] = std::min(edge, max);
+    }
+    return stats;
+}
+
+LatencyStats LowLatencyCodec::getEncodeLatency() const {
+    return encodeTimes.percentiles();
+}
+
+LatencyStats LowLatencyCodec::getDecodeLatency() const {
+    return decodeTimes.percentiles();
+}
+
+void LowLatencyCodec::clearLatencyStats() {
+    encodeTimes.clear();
+    decodeTimes.clear();
+}
+
+void LowLatencyCodec::printLatencyStats() const {
+    LatencyStats encodeStats = getEncodeLatency();
+    LatencyStats decodeStats = getDecodeLatency();
+    std::cout << "=== Low-Latency Statistics ===" << std::endl;
+    std::cout << "Frame Size: " << frameSize << " samples (" << getFrameDuration() << " ms)" << std::endl;
+    std::cout << "Encode (us, " << encodeStats.frames << " frames): p50 " << encodeStats.p50 << ", p99 "
+              << encodeStats.p99 << ", p99.9 " << encodeStats.p999 << ", max " << encodeStats.max << std::endl;
+    std::cout << "Decode (us, " << decodeStats.frames << " frames): p50 " << decodeStats.p50 << ", p99 "
+              << decodeStats.p99 << ", p99.9 " << decodeStats.p999 << ", max " << decodeStats.max << std::endl;
+}
@@ -0,0 +1,107 @@
+#ifndef LOW_LATENCY_CODEC_H
+#define LOW_LATENCY_CODEC_H
+
+#include "AudioCodec.h"
+#include "GolombCoding.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Percentiles of the time taken by each call of one kind, in microseconds
+struct LatencyStats {
+    size_t frames;
+    double p50;
+    double p99;
+    double p999;
+    double max;
+    
+    LatencyStats() : frames(0), p50(0.0), p99(0.0), p999(0.0), max(0.0) {}
+};
+
+// Low-latency streaming profile: frames of 64 to 256 samples per channel,
+// coded as soon as they arrive, with no look-ahead and no per-frame header.
+// Everything is backward adaptive, so the decoder makes the same choices
+// from the samples it has already decoded:
+//   - the predictor state runs across frames (no warm-up samples)
+//   - each channel uses the fixed predictor (order 0 to 3) that would have
+//     coded the previous frame best; the second channel of a stereo stream
+//     may be coded as its difference from the first on the same basis
+//   - the Rice parameter follows a running mean of the residuals, updated
+//     every sample (as in JPEG-LS)
+// Frames must be decoded in order from the start (or from a reset() on both
+// sides). Every encodeFrame/decodeFrame call is timed for the latency
+// percentiles, kept as a histogram so memory stays fixed on a live stream.
+class LowLatencyCodec {
+public:
+    static const int MIN_FRAME_SIZE = 64;
+    static const int MAX_FRAME_SIZE = 256;
+    static const int FIXED_ORDERS = 4;
+
+private:
+    // Coding state of one channel
+    struct ChannelState {
+        int64_t history[2][3];               // Last samples of each signal, newest first
+        uint64_t cost[2][FIXED_ORDERS];      // Residual magnitudes over the current frame
+        int signal;                          // 0 = the channel, 1 = difference from channel 0
+        int order;
+        uint64_t magnitudeSum;               // Rice parameter context
+        uint64_t count;
+    };
+    
+    // Call times in log-spaced buckets, SUB_BUCKETS per octave, so a
+    // percentile is within 1/SUB_BUCKETS of the true value. Fixed size, so
+    // recording a call never allocates.
+    struct LatencyHistogram {
+        static const int SUB_BUCKETS = 16;
+        static const int OCTAVES = 32;
+        static const int BUCKETS = SUB_BUCKETS * OCTAVES;
+        
+        uint64_t counts[BUCKETS];
+        size_t frames;
+        double max;
+        
+        LatencyHistogram();
+        void clear();
+        void add(double microseconds);
+        LatencyStats percentiles() const;
+    };
+    
+    AudioInfo info;
+    int frameSize;
+    GolombCoding golomb;
+    std::vector<ChannelState> state;
+    LatencyHistogram encodeTimes;
+    LatencyHistogram decodeTimes;
+    
+    static int64_t predictFixed(const int64_t* history, int order);
+    int riceParameter(const ChannelState& channel) const;
+    void update(ChannelState& channel, const int64_t* signals, int64_t residual);
+    void chooseNextPredictor(ChannelState& channel, bool allowDifference);
+
+public:
+    // Throws std::invalid_argument for no channels or a frame size outside
+    // MIN_FRAME_SIZE..MAX_FRAME_SIZE
+    LowLatencyCodec(const AudioInfo& info, int frameSize = 128);
+    
+    // Forget the adaptive state (both ends must reset at the same frame)
+    void reset();
+    
+    // Code up to frameSize interleaved sample frames into packet (replacing
+    // its contents). Throws std::invalid_argument for more than frameSize.
+    void encodeFrame(const int32_t* samples, size_t frames, std::vector<bool>& packet);
+    // Decode one packet into frames interleaved sample frames; throws
+    // std::invalid_argument if the packet is truncated
+    void decodeFrame(const std::vector<bool>& packet, int32_t* samples, size_t frames);
+    
+    int getFrameSize() const;
+    // Audio held back by the encoder before a frame can be sent, in ms
+    double getFrameDuration() const;
+    
+    // Per-call timing since construction or clearLatencyStats()
+    LatencyStats getEncodeLatency() const;
+    LatencyStats getDecodeLatency() const;
+    void clearLatencyStats();
+    void printLatencyStats() const;
+};
+
+#endif // LOW_LATENCY_CODEC_H
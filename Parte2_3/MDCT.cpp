@@ -0,0 +1,76 @@
+#include "MDCT.h"
+#include "FFT.h"
+#include <cmath>
+#include <stdexcept>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+MDCT::MDCT(size_t n) : size(n), window(2 * n), folded(n), preTwiddle(n / 2), postTwiddle(n / 2), buffer(n / 2) {
+    if (size < 2 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("MDCT size must be a power of two");
+    }
+    
+    // Sine window: w[n]^2 + w[n + size]^2 = 1
+    for (size_t n = 0; n < 2 * size; n++) {
+        window[n] = std::sin(M_PI * (n + 0.5) / (2.0 * size));
+    }
+    for (size_t k = 0; k < size / 2; k++) {
+        preTwiddle[k] = std::polar(1.0, -M_PI * (k + 0.25) / size);
+        postTwiddle[k] = std::polar(1.0, -M_PI * k / size);
+    }
+}
+
+size_t MDCT::getSize() const {
+    return size;
+}
+
+// DCT-IV in place: even inputs form the real part and reversed odd inputs
+// the imaginary part of a size / 2 point complex sequence
+void MDCT::dct4(std::vector<double>& data) {
+    size_t half = size / 2;
+    for (size_t m = 0; m < half; m++) {
+        buffer[m] = std::complex<double>(data[2 * m], data[size - 1 - 2 * m]) * preTwiddle[m];
+    }
+    fft(buffer, false);
+    for (size_t k = 0; k < half; k++) {
+        std::complex<double> value = buffer[k] * postTwiddle[k];
+        data[2 * k] = value.real();
+        data[size - 1 - 2 * k] = -value.imag();
+    }
+}
+
+void MDCT::forward(const double* block, double* coefficients) {
+    // With the windowed block split in quarters (a, b, c, d), the MDCT is
+    // the DCT-IV of (-c reversed - d, a - b reversed)
+    size_t half = size / 2;
+    for (size_t n = 0; n < half; n++) {
+        folded[n] = -block[size + half - 1 - n] * window[size + half - 1 - n] -
+                    block[size + half + n] * window[size + half + n];
+        folded[half + n] = block[n] * window[n] - block[size - 1 - n] * window[size - 1 - n];
+    }
+    dct4(folded);
+    for (size_t k = 0; k < size; k++) {
+        coefficients[k] = folded[k];
+    }
+}
+
+void MDCT::inverse(const double* coefficients, double* block) {
+    folded.assign(coefficients, coefficients + size);
+    dct4(folded);
+    
+    // Unfold (the transpose of the forward folding), then window and undo
+    // the size / 2 gain of the DCT-IV pair
+    size_t half = size / 2;
+    double scale = 2.0 / size;
+    for (size_t n = 0; n < half; n++) {
+        block[n] = folded[half + n];
+        block[half + n] = -folded[size - 1 - n];
+        block[size + n] = -folded[half - 1 - n];
+        block[size + half + n] = -folded[n];
+    }
+    for (size_t n = 0; n < 2 * size; n++) {
+        block[n] *= window[n] * scale;
+    }
+}
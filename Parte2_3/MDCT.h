@@ -0,0 +1,37 @@
+#ifndef MDCT_H
+#define MDCT_H
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+
+// Modified discrete cosine transform with a sine window and 50% overlap:
+// blocks of 2 * size samples, advanced by size, give size coefficients each.
+// Overlap-adding the inverse transforms of consecutive blocks reconstructs
+// the signal exactly (time-domain aliasing cancellation). Both directions
+// fold the block into a DCT-IV computed with a size / 2 complex FFT.
+class MDCT {
+private:
+    size_t size; // Coefficients per block; a power of two, at least 2
+    std::vector<double> window;
+    std::vector<double> folded;
+    std::vector<std::complex<double> > preTwiddle;
+    std::vector<std::complex<double> > postTwiddle;
+    std::vector<std::complex<double> > buffer;
+    
+    void dct4(std::vector<double>& data);
+
+public:
+    explicit MDCT(size_t n);
+    
+    size_t getSize() const;
+    
+    // block: 2 * size samples (the window is applied here)
+    void forward(const double* block, double* coefficients);
+    
+    // block: 2 * size windowed samples, to be added to the previous block's
+    // second half
+    void inverse(const double* coefficients, double* block);
+};
+
+#endif // MDCT_H
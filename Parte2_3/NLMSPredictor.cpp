@@ -0,0 +1,306 @@
+#include "NLMSPredictor.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// History elements kept before the rolling window is moved back to the start
+static const size_t WINDOW_SIZE = 512;
+
+// Fractional bits of the stage 2 weights
+static const int STAGE2_SHIFT = 10;
+
+// Fractional bits and adaptation step of the cross-channel weights
+static const int CROSS_SHIFT = 12;
+static const int32_t CROSS_STEP = 8;
+
+static int16_t saturate16(int64_t value) {
+    return static_cast<int16_t>(std::max<int64_t>(-32768, std::min<int64_t>(32767, value)));
+}
+
+// Dot product of order 16-bit values, accumulated modulo 2^32
+static int32_t dotProduct(const int16_t* a, const int16_t* b, int order) {
+    int i = 0;
+    uint32_t sum = 0;
+
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 16 <= order; i += 16) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc128));
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= order; i += 8) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+#endif
+
+    for (; i < order; i++) {
+        sum += static_cast<uint32_t>(static_cast<int32_t>(a[i]) * b[i]);
+    }
+    return static_cast<int32_t>(sum);
+}
+
+// weights += deltas (direction > 0) or weights -= deltas, wrapping at 16 bits
+static void adaptWeights(int16_t* weights, const int16_t* deltas, int order, int direction) {
+    int i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= order; i += 16) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(deltas + i));
+        w = direction > 0 ? _mm256_add_epi16(w, d) : _mm256_sub_epi16(w, d);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(weights + i), w);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; i + 8 <= order; i += 8) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+        w = direction > 0 ? _mm_add_epi16(w, d) : _mm_sub_epi16(w, d);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights + i), w);
+    }
+#endif
+
+    for (; i < order; i++) {
+        uint16_t w = static_cast<uint16_t>(weights[i]);
+        uint16_t d = static_cast<uint16_t>(deltas[i]);
+        weights[i] = static_cast<int16_t>(direction > 0 ? w + d : w - d);
+    }
+}
+
+// Constructor
+NLMSFilter::NLMSFilter(int order, int shift)
+    : order(order), shift(shift), runningAverage(0), pos(order),
+      weights(order), history(order + WINDOW_SIZE), deltas(order + WINDOW_SIZE) {
+}
+
+// Clear weights and history
+void NLMSFilter::reset() {
+    std::fill(weights.begin(), weights.end(), 0);
+    std::fill(history.begin(), history.end(), 0);
+    std::fill(deltas.begin(), deltas.end(), 0);
+    runningAverage = 0;
+    pos = order;
+}
+
+// Prediction from the last order inputs
+int64_t NLMSFilter::predict() const {
+    int64_t dot = dotProduct(&history[pos - order], &weights[0], order);
+    return (dot + (static_cast<int64_t>(1) << (shift - 1))) >> shift;
+}
+
+// Move every weight towards reducing the residual
+void NLMSFilter::adapt(int64_t residual) {
+    if (residual != 0) {
+        adaptWeights(&weights[0], &deltas[pos - order], order, residual > 0 ? 1 : -1);
+    }
+}
+
+// Append an input to the history, with a step that is larger for inputs
+// well above the recent average and decays as the input ages
+void NLMSFilter::push(int64_t input) {
+    int16_t sample = saturate16(input);
+    int32_t magnitude = sample < 0 ? -sample : sample;
+    int16_t step = 0;
+    if (magnitude > runningAverage * 3) {
+        step = 32;
+    } else if (magnitude > (runningAverage * 4) / 3) {
+        step = 16;
+    } else if (magnitude > 0) {
+        step = 8;
+    }
+    runningAverage += (magnitude - runningAverage) / 16;
+    
+    history[pos] = sample;
+    deltas[pos] = sample < 0 ? -step : step;
+    deltas[pos - 1] >>= 1;
+    deltas[pos - 2] >>= 1;
+    deltas[pos - 8] >>= 1;
+    pos++;
+    
+    // Keep the last order elements contiguous for the dot product
+    if (pos == history.size()) {
+        std::memmove(&history[0], &history[pos - order], order * sizeof(int16_t));
+        std::memmove(&deltas[0], &deltas[pos - order], order * sizeof(int16_t));
+        pos = order;
+    }
+}
+
+int64_t NLMSFilter::compress(int64_t input) {
+    int64_t residual = input - predict();
+    adapt(residual);
+    push(input);
+    return residual;
+}
+
+int64_t NLMSFilter::decompress(int64_t residual) {
+    int64_t input = residual + predict();
+    adapt(residual);
+    push(input);
+    return input;
+}
+
+// Constructor
+CascadePredictor::CascadePredictor() {
+    filters.push_back(NLMSFilter(1024, 15));
+    filters.push_back(NLMSFilter(256, 13));
+    filters.push_back(NLMSFilter(16, 11));
+    reset();
+}
+
+// Return to the initial (all-zero) state
+void CascadePredictor::reset() {
+    lastInput = 0;
+    for (int k = 0; k < STAGE2_ORDER; k++) {
+        stage2History[k] = 0;
+        stage2Weights[k] = 0;
+    }
+    for (size_t f = 0; f < filters.size(); f++) {
+        filters[f].reset();
+    }
+}
+
+int64_t CascadePredictor::predictStage2() const {
+    int64_t sum = 0;
+    for (int k = 0; k < STAGE2_ORDER; k++) {
+        sum += stage2History[k] * stage2Weights[k];
+    }
+    return sum >> STAGE2_SHIFT;
+}
+
+// Sign-sign update of the stage 2 weights, then shift in the new value
+void CascadePredictor::updateStage2(int64_t value, int64_t residual) {
+    if (residual != 0) {
+        for (int k = 0; k < STAGE2_ORDER; k++) {
+            if (stage2History[k] != 0) {
+                stage2Weights[k] += (residual > 0) == (stage2History[k] > 0) ? 1 : -1;
+            }
+        }
+    }
+    for (int k = STAGE2_ORDER - 1; k > 0; k--) {
+        stage2History[k] = stage2History[k - 1];
+    }
+    stage2History[0] = value;
+}
+
+int64_t CascadePredictor::compress(int64_t sample) {
+    // Stage 1
+    int64_t value = sample - ((lastInput * 31) >> 5);
+    lastInput = sample;
+    
+    // Stage 2
+    int64_t residual = value - predictStage2();
+    updateStage2(value, residual);
+    
+    // Stage 3
+    for (size_t f = 0; f < filters.size(); f++) {
+        residual = filters[f].compress(residual);
+    }
+    return residual;
+}
+
+int64_t CascadePredictor::decompress(int64_t residual) {
+    for (size_t f = filters.size(); f-- > 0;) {
+        residual = filters[f].decompress(residual);
+    }
+    
+    int64_t value = residual + predictStage2();
+    updateStage2(value, residual);
+    
+    int64_t sample = value + ((lastInput * 31) >> 5);
+    lastInput = sample;
+    return sample;
+}
+
+CrossChannelPredictor::CrossChannelPredictor() {
+    reset();
+}
+
+// Return to the initial (all-zero) state
+void CrossChannelPredictor::reset() {
+    lastInput = 0;
+    lastReference = 0;
+    for (int k = 0; k < OWN_ORDER; k++) {
+        ownHistory[k] = 0;
+        ownWeights[k] = 0;
+    }
+    for (int k = 0; k < CROSS_ORDER; k++) {
+        crossHistory[k] = 0;
+        crossWeights[k] = 0;
+    }
+}
+
+// Shift the filtered reference sample into the cross history
+void CrossChannelPredictor::pushReference(int64_t reference) {
+    for (int k = CROSS_ORDER - 1; k > 0; k--) {
+        crossHistory[k] = crossHistory[k - 1];
+    }
+    crossHistory[0] = reference - ((lastReference * 31) >> 5);
+    lastReference = reference;
+}
+
+int64_t CrossChannelPredictor::predict() const {
+    int64_t sum = 0;
+    for (int k = 0; k < OWN_ORDER; k++) {
+        sum += ownHistory[k] * ownWeights[k];
+    }
+    for (int k = 0; k < CROSS_ORDER; k++) {
+        sum += crossHistory[k] * crossWeights[k];
+    }
+    return sum >> CROSS_SHIFT;
+}
+
+// Sign-sign update of both weight sets, then shift in the new value
+void CrossChannelPredictor::update(int64_t value, int64_t residual) {
+    if (residual != 0) {
+        for (int k = 0; k < OWN_ORDER; k++) {
+            if (ownHistory[k] != 0) {
+                ownWeights[k] += (residual > 0) == (ownHistory[k] > 0) ? CROSS_STEP : -CROSS_STEP;
+            }
+        }
+        for (int k = 0; k < CROSS_ORDER; k++) {
+            if (crossHistory[k] != 0) {
+                crossWeights[k] += (residual > 0) == (crossHistory[k] > 0) ? CROSS_STEP : -CROSS_STEP;
+            }
+        }
+    }
+    for (int k = OWN_ORDER - 1; k > 0; k--) {
+        ownHistory[k] = ownHistory[k - 1];
+    }
+    ownHistory[0] = value;
+}
+
+int64_t CrossChannelPredictor::compress(int64_t sample, int64_t reference) {
+    pushReference(reference);
+    int64_t value = sample - ((lastInput * 31) >> 5);
+    lastInput = sample;
+    
+    int64_t residual = value - predict();
+    update(value, residual);
+    return residual;
+}
+
+int64_t CrossChannelPredictor::decompress(int64_t residual, int64_t reference) {
+    pushReference(reference);
+    int64_t value = residual + predict();
+    update(value, residual);
+    
+    int64_t sample = value + ((lastInput * 31) >> 5);
+    lastInput = sample;
+    return sample;
+}
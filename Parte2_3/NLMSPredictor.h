@@ -0,0 +1,91 @@
+#ifndef NLMS_PREDICTOR_H
+#define NLMS_PREDICTOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Sign-sign LMS filter with 16-bit history and weights (after the NN filters
+// of Monkey's Audio). The input history is saturated to 16 bits so the dot
+// product maps onto integer multiply-add instructions; all arithmetic is
+// integer and wraps identically in the scalar and SIMD paths, so encoder and
+// decoder stay bit-exact. order must be a multiple of 16.
+class NLMSFilter {
+private:
+    int order;
+    int shift; // Fractional bits of the weights
+    int32_t runningAverage;
+    size_t pos; // Index of the next history element
+    std::vector<int16_t> weights;
+    std::vector<int16_t> history; // Rolling window: the last order inputs end at pos
+    std::vector<int16_t> deltas;  // Adaptation step for each history element
+    
+    int64_t predict() const;
+    void adapt(int64_t residual);
+    void push(int64_t input);
+
+public:
+    NLMSFilter(int order, int shift);
+    
+    void reset();
+    int64_t compress(int64_t input);     // Returns the residual
+    int64_t decompress(int64_t residual); // Returns the input
+};
+
+// Cascade used by the extra high compression mode:
+//   stage 1: fixed first-order filter, x[i] - (31 * x[i-1]) / 32
+//   stage 2: 4-tap sign-sign adaptive predictor with 32-bit weights
+//   stage 3: NLMS filters of 1024, 256 and 16 taps, each applied to the
+//            residual of the previous one
+// The state starts from zero, so each subframe can be coded on its own.
+class CascadePredictor {
+private:
+    static const int STAGE2_ORDER = 4;
+    
+    int64_t lastInput;
+    int64_t stage2History[STAGE2_ORDER];
+    int32_t stage2Weights[STAGE2_ORDER];
+    std::vector<NLMSFilter> filters;
+    
+    int64_t predictStage2() const;
+    void updateStage2(int64_t value, int64_t residual);
+
+public:
+    CascadePredictor();
+    
+    void reset();
+    int64_t compress(int64_t sample);
+    int64_t decompress(int64_t residual);
+};
+
+// Cross-channel predictor for the second channel of a pair. Both channels go
+// through the stage 1 filter of the cascade; the second channel is then
+// predicted from its own last OWN_ORDER values and the first channel's
+// current and last CROSS_ORDER - 1 values, with sign-sign adapted 32-bit
+// weights. The first channel is always decoded before the second, so the
+// decoder sees the same inputs and adapts the weights identically.
+class CrossChannelPredictor {
+private:
+    static const int OWN_ORDER = 8;
+    static const int CROSS_ORDER = 8;
+    
+    int64_t lastInput;
+    int64_t lastReference;
+    int64_t ownHistory[OWN_ORDER];
+    int64_t crossHistory[CROSS_ORDER];
+    int32_t ownWeights[OWN_ORDER];
+    int32_t crossWeights[CROSS_ORDER];
+    
+    void pushReference(int64_t reference);
+    int64_t predict() const;
+    void update(int64_t value, int64_t residual);
+
+public:
+    CrossChannelPredictor();
+    
+    void reset();
+    int64_t compress(int64_t sample, int64_t reference);
+    int64_t decompress(int64_t residual, int64_t reference);
+};
+
+#endif // NLMS_PREDICTOR_H
@@ -0,0 +1,309 @@
+#include "PCMConvert.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// 8-bit WAV data is unsigned with a 128 offset
+void pcm8ToInt32(const uint8_t* src, int32_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<int32_t>(src[i]) - 128;
+    }
+}
+
+// 16-bit: sign extension
+void pcm16ToInt32(const uint8_t* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 16)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), hi);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        // Duplicate each sample into both halves of a 32-bit lane, then shift the copy down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), hi);
+    }
+#endif
+
+    for (; i < count; i++) {
+        int16_t sample;
+        std::memcpy(&sample, src + 2 * i, sizeof(sample));
+        dst[i] = sample;
+    }
+}
+
+// 24-bit: three bytes per sample, moved into the top of a 32-bit lane and
+// shifted back down to sign-extend
+void pcm24ToInt32(const uint8_t* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+    // Shuffle for 4 samples packed in 12 bytes (-1 zeroes the low byte)
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+#endif
+
+#if defined(__AVX2__)
+    const __m256i shuffle256 = _mm256_broadcastsi128_si256(shuffle);
+    // Each iteration reads 28 bytes but consumes 24
+    for (; i + 11 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+        v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle256), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+#endif
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+    // Each iteration reads 16 bytes but consumes 12
+    for (; i + 6 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+        v = _mm_srai_epi32(_mm_shuffle_epi8(v, shuffle), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#endif
+
+    for (; i < count; i++) {
+        const uint8_t* p = src + 3 * i;
+        uint32_t packed = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+                          (static_cast<uint32_t>(p[2]) << 24);
+        dst[i] = static_cast<int32_t>(packed) >> 8;
+    }
+}
+
+// 32-bit: already in the target layout on little-endian hosts
+void pcm32ToInt32(const uint8_t* src, int32_t* dst, size_t count) {
+    std::memcpy(dst, src, count * sizeof(int32_t));
+}
+
+// Dispatch on sample width
+void pcmToInt32(const uint8_t* src, int32_t* dst, size_t count, int bitsPerSample) {
+    switch (bitsPerSample) {
+        case 8:
+            pcm8ToInt32(src, dst, count);
+            break;
+        case 16:
+            pcm16ToInt32(src, dst, count);
+            break;
+        case 24:
+            pcm24ToInt32(src, dst, count);
+            break;
+        case 32:
+            pcm32ToInt32(src, dst, count);
+            break;
+        default:
+            break;
+    }
+}
+
+void PCMSpan::deinterleave(size_t start, size_t count, std::vector<std::vector<int32_t> >& out) const {
+    size_t bytesPerFrame = static_cast<size_t>(channels) * (bitsPerSample / 8);
+    out.resize(channels);
+    std::vector<int32_t*> planes(channels);
+    for (size_t c = 0; c < channels; c++) {
+        out[c].resize(count);
+        planes[c] = out[c].data();
+    }
+    deinterleavePcm(data + start * bytesPerFrame, planes.data(), count, channels, bitsPerSample);
+}
+
+// Pack int32_t samples back into WAV PCM
+void int32ToPcm(const int32_t* src, uint8_t* dst, size_t count, int bitsPerSample) {
+    switch (bitsPerSample) {
+        case 8:
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = static_cast<uint8_t>(src[i] + 128);
+            }
+            break;
+        case 16: {
+            size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+            for (; i + 8 <= count; i += 8) {
+                __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_packs_epi32(lo, hi));
+            }
+#endif
+            for (; i < count; i++) {
+                // Saturate like _mm_packs_epi32
+                int16_t sample = static_cast<int16_t>(std::max(-32768, std::min(32767, src[i])));
+                std::memcpy(dst + 2 * i, &sample, sizeof(sample));
+            }
+            break;
+        }
+        case 24: {
+            size_t i = 0;
+#if defined(__AVX2__) || defined(__SSSE3__)
+            // Keep the low three bytes of each lane; each iteration writes 16
+            // bytes but fills 12
+            const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            for (; i + 6 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i), _mm_shuffle_epi8(v, shuffle));
+            }
+#endif
+            for (; i < count; i++) {
+                uint32_t sample = static_cast<uint32_t>(src[i]);
+                dst[3 * i] = static_cast<uint8_t>(sample);
+                dst[3 * i + 1] = static_cast<uint8_t>(sample >> 8);
+                dst[3 * i + 2] = static_cast<uint8_t>(sample >> 16);
+            }
+            break;
+        }
+        case 32:
+            std::memcpy(dst, src, count * sizeof(int32_t));
+            break;
+        default:
+            break;
+    }
+}
+
+// Interleaved int32_t samples held by the (de)interleaving kernels at a time;
+// 8 channels of 256 frames, which stay in L1. The padding absorbs the
+// overreach of the 4-wide loads and stores on 2 and 6 channels.
+static const size_t STAGING_SAMPLES = 2048;
+static const size_t STAGING_PADDING = 4;
+
+#if defined(__SSE2__) || defined(_M_X64)
+// Transpose 4 x 4 int32_t lanes: rows of frames to rows of channels, or back
+static inline void transpose4(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    r0 = _mm_unpacklo_epi64(t0, t1);
+    r1 = _mm_unpackhi_epi64(t0, t1);
+    r2 = _mm_unpacklo_epi64(t2, t3);
+    r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline bool transposable(int channels) {
+    return channels == 2 || channels == 4 || channels == 6 || channels == 8;
+}
+#endif
+
+// Interleaved block -> planes, from frame offset on
+static void splitBlock(const int32_t* in, int32_t* const* out, size_t offset, size_t count, int channels) {
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    // 4 frames at a time, each group of 4 channels transposed in registers
+    if (transposable(channels)) {
+        for (; i + 4 <= count; i += 4) {
+            const int32_t* frame = in + i * channels;
+            for (int g = 0; g < channels; g += 4) {
+                __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + g));
+                __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + channels + g));
+                __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + 2 * channels + g));
+                __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + 3 * channels + g));
+                transpose4(r0, r1, r2, r3);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out[g] + offset + i), r0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out[g + 1] + offset + i), r1);
+                if (g + 2 < channels) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[g + 2] + offset + i), r2);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[g + 3] + offset + i), r3);
+                }
+            }
+        }
+    }
+#endif
+
+    for (const int32_t* frame = in + i * channels; i < count; i++, frame += channels) {
+        for (int c = 0; c < channels; c++) {
+            out[c][offset + i] = frame[c];
+        }
+    }
+}
+
+// Planes from frame offset on -> interleaved block
+static void mergeBlock(const int32_t* const* in, size_t offset, int32_t* out, size_t count, int channels) {
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    if (transposable(channels)) {
+        __m128i rows[2][4];
+        for (; i + 4 <= count; i += 4) {
+            for (int g = 0; g < channels; g += 4) {
+                __m128i* r = rows[g / 4];
+                r[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[g] + offset + i));
+                r[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[g + 1] + offset + i));
+                r[2] = r[3] = _mm_setzero_si128();
+                if (g + 2 < channels) {
+                    r[2] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[g + 2] + offset + i));
+                    r[3] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[g + 3] + offset + i));
+                }
+                transpose4(r[0], r[1], r[2], r[3]);
+            }
+            // Frame by frame: a half-filled group's spare lanes are
+            // overwritten by the next frame
+            int32_t* frame = out + i * channels;
+            for (int f = 0; f < 4; f++, frame += channels) {
+                for (int g = 0; g < channels; g += 4) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(frame + g), rows[g / 4][f]);
+                }
+            }
+        }
+    }
+#endif
+
+    for (int32_t* frame = out + i * channels; i < count; i++, frame += channels) {
+        for (int c = 0; c < channels; c++) {
+            frame[c] = in[c][offset + i];
+        }
+    }
+}
+
+void deinterleavePcm(const uint8_t* src, int32_t* const* dst, size_t count, int channels, int bitsPerSample) {
+    size_t bytesPerFrame = static_cast<size_t>(channels) * (bitsPerSample / 8);
+    size_t blockFrames = STAGING_SAMPLES / channels;
+    int32_t staging[STAGING_SAMPLES + STAGING_PADDING];
+    
+    for (size_t done = 0; done < count;) {
+        if (blockFrames == 0) {
+            // More channels than the staging buffer holds: one sample at a time
+            for (int c = 0; c < channels; c++) {
+                pcmToInt32(src + done * bytesPerFrame + c * (bitsPerSample / 8), dst[c] + done, 1, bitsPerSample);
+            }
+            done++;
+            continue;
+        }
+        size_t n = std::min(blockFrames, count - done);
+        pcmToInt32(src + done * bytesPerFrame, staging, n * channels, bitsPerSample);
+        splitBlock(staging, dst, done, n, channels);
+        done += n;
+    }
+}
+
+void interleavePcm(const int32_t* const* src, uint8_t* dst, size_t count, int channels, int bitsPerSample) {
+    size_t bytesPerFrame = static_cast<size_t>(channels) * (bitsPerSample / 8);
+    size_t blockFrames = STAGING_SAMPLES / channels;
+    int32_t staging[STAGING_SAMPLES + STAGING_PADDING];
+    
+    for (size_t done = 0; done < count;) {
+        if (blockFrames == 0) {
+            for (int c = 0; c < channels; c++) {
+                int32ToPcm(src[c] + done, dst + done * bytesPerFrame + c * (bitsPerSample / 8), 1, bitsPerSample);
+            }
+            done++;
+            continue;
+        }
+        size_t n = std::min(blockFrames, count - done);
+        mergeBlock(src, done, staging, n, channels);
+        int32ToPcm(staging, dst + done * bytesPerFrame, n * channels, bitsPerSample);
+        done += n;
+    }
+}
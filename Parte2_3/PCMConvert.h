@@ -0,0 +1,49 @@
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Conversions between packed little-endian WAV PCM and int32_t samples.
+// Samples keep their native range (8-bit: -128..127, 24-bit: -2^23..2^23-1).
+// SSE2 kernels are used on x86-64; SSSE3/AVX2 kernels when the compiler
+// targets them (see AUDIO_NATIVE_ARCH in CMakeLists.txt).
+
+// Packed PCM -> int32_t, count samples
+void pcmToInt32(const uint8_t* src, int32_t* dst, size_t count, int bitsPerSample);
+
+// int32_t -> packed PCM, count samples (values must fit bitsPerSample;
+// 16-bit values outside it are saturated)
+void int32ToPcm(const int32_t* src, uint8_t* dst, size_t count, int bitsPerSample);
+
+// Packed interleaved PCM <-> one int32_t array per channel, count frames.
+// Converted through a small staging block on the stack; 2, 4, 6 and 8
+// channels are transposed 4 x 4 in SSE2 registers.
+void deinterleavePcm(const uint8_t* src, int32_t* const* dst, size_t count, int channels, int bitsPerSample);
+void interleavePcm(const int32_t* const* src, uint8_t* dst, size_t count, int channels, int bitsPerSample);
+
+// Read-only view of interleaved packed PCM held elsewhere (such as a
+// memory-mapped WAV file, see WAVFile::map)
+struct PCMSpan {
+    const uint8_t* data;
+    size_t frames;         // Samples per channel
+    uint16_t channels;
+    uint16_t bitsPerSample;
+    
+    PCMSpan() : data(NULL), frames(0), channels(0), bitsPerSample(0) {}
+    PCMSpan(const uint8_t* pcm, size_t count, uint16_t numChannels, uint16_t bits)
+        : data(pcm), frames(count), channels(numChannels), bitsPerSample(bits) {}
+    
+    // Convert frames [start, start + count) into one int32_t vector per
+    // channel (resized to count)
+    void deinterleave(size_t start, size_t count, std::vector<std::vector<int32_t> >& out) const;
+};
+
+// Individual kernels
+void pcm8ToInt32(const uint8_t* src, int32_t* dst, size_t count);
+void pcm16ToInt32(const uint8_t* src, int32_t* dst, size_t count);
+void pcm24ToInt32(const uint8_t* src, int32_t* dst, size_t count);
+void pcm32ToInt32(const uint8_t* src, int32_t* dst, size_t count);
+
+#endif // PCM_CONVERT_H
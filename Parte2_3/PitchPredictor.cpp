@@ -0,0 +1,66 @@
+#include "PitchPredictor.h"
+#include "FFT.h"
+#include <cmath>
+#include <algorithm>
+
+bool findPitch(const std::vector<int64_t>& residuals, int& lag, int& gain, PitchSearch& search) {
+    size_t n = residuals.size();
+    if (n <= static_cast<size_t>(MIN_PITCH_LAG) + 1) return false;
+    int maxLag = static_cast<int>(std::min(static_cast<size_t>(MAX_PITCH_LAG), n - 1));
+    
+    // Autocorrelation for every lag at once: IFFT(|FFT(x)|^2), zero-padded
+    // to avoid circular wrap-around
+    size_t size = 1;
+    while (size < 2 * n) size <<= 1;
+    std::vector<std::complex<double> >& spectrum = search.spectrum;
+    spectrum.assign(size, std::complex<double>());
+    for (size_t i = 0; i < n; i++) {
+        spectrum[i] = static_cast<double>(residuals[i]);
+    }
+    fft(spectrum, false);
+    for (size_t i = 0; i < size; i++) {
+        spectrum[i] = std::norm(spectrum[i]);
+    }
+    fft(spectrum, true);
+    
+    // energy[k] = sum of squares of the first k residuals
+    std::vector<double>& energy = search.energy;
+    energy.assign(n + 1, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        double r = static_cast<double>(residuals[i]);
+        energy[i + 1] = energy[i] + r * r;
+    }
+    
+    // Maximize the energy removed by the optimal gain, c^2 / E
+    double bestScore = 0.0;
+    double bestGain = 0.0;
+    lag = 0;
+    for (int k = MIN_PITCH_LAG; k <= maxLag; k++) {
+        double correlation = spectrum[k].real();
+        double lagEnergy = energy[n - k];
+        if (lagEnergy <= 0.0) continue;
+        double score = correlation * correlation / lagEnergy;
+        if (score > bestScore) {
+            bestScore = score;
+            bestGain = correlation / lagEnergy;
+            lag = k;
+        }
+    }
+    
+    int limit = 1 << (PITCH_GAIN_BITS - 1);
+    gain = static_cast<int>(std::max<long>(-limit, std::min<long>(limit - 1, std::lround(bestGain * 16.0))));
+    return lag != 0 && gain != 0;
+}
+
+void applyPitchPrediction(std::vector<int64_t>& residuals, int lag, int gain) {
+    // Backwards, so every prediction uses the original residual
+    for (size_t i = residuals.size(); i-- > static_cast<size_t>(lag);) {
+        residuals[i] -= (gain * residuals[i - lag] + 8) >> 4;
+    }
+}
+
+void removePitchPrediction(std::vector<int64_t>& residuals, int lag, int gain) {
+    for (size_t i = lag; i < residuals.size(); i++) {
+        residuals[i] += (gain * residuals[i - lag] + 8) >> 4;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef PITCH_PREDICTOR_H
+#define PITCH_PREDICTOR_H
+
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+
+// Long-term (pitch) prediction on the residual of a short-term predictor:
+//   residual[i] -= (gain * residual[i - lag] + 8) >> 4   for i >= lag
+// gain is in sixteenths. The search is floating point, the filter integer.
+
+const int MIN_PITCH_LAG = 20;
+const int MAX_PITCH_LAG = 2047;
+const int PITCH_LAG_BITS = 11;
+const int PITCH_GAIN_BITS = 5; // Signed, -16..15 sixteenths
+
+// Working buffers of findPitch, kept by the caller so they can be reused
+struct PitchSearch {
+    std::vector<std::complex<double> > spectrum;
+    std::vector<double> energy;
+};
+
+// Find the lag with the highest normalized autocorrelation (computed with an
+// FFT) and its quantized gain. Returns false if no lag has a nonzero gain.
+bool findPitch(const std::vector<int64_t>& residuals, int& lag, int& gain, PitchSearch& search);
+
+// Apply / remove the long-term predictor in place
+void applyPitchPrediction(std::vector<int64_t>& residuals, int lag, int gain);
+void removePitchPrediction(std::vector<int64_t>& residuals, int lag, int gain);
+
+#endif // PITCH_PREDICTOR_H
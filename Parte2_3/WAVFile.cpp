@@ -1,39 +1,510 @@
 #include "WAVFile.h"
+#include "CodecProfile.h"
+#include "PCMConvert.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
-WAVFile::WAVFile() {
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // Keep std::min and std::max usable
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Packed samples converted and read or written per block
+static const size_t STAGING_BYTES = 64 * 1024;
+
+WAVFile::WAVFile() : profile(NULL), mapped(NULL), mappedSize(0), streamBuffer(STAGING_BYTES) {
     std::memset(&header, 0, sizeof(WAVHeader));
 }
 
-// Validate WAV header
-bool WAVFile::validateHeader(const WAVHeader& hdr) {
-    if (std::strncmp(hdr.riffHeader, "RIFF", 4) != 0) {
-        std::cerr << "Error: Invalid RIFF header" << std::endl;
+WAVFile::~WAVFile() {
+    unmap();
+}
+
+// The int16_t API scales 8-bit audio to the 16-bit range; wider audio does not fit
+static bool narrowSamples(const std::vector<int32_t>& in, std::vector<int16_t>& out, uint16_t bitsPerSample) {
+    if (bitsPerSample > 16) {
+        std::cerr << "Error: " << bitsPerSample << "-bit audio needs the int32_t interface" << std::endl;
         return false;
     }
     
-    if (std::strncmp(hdr.waveHeader, "WAVE", 4) != 0) {
-        std::cerr << "Error: Invalid WAVE header" << std::endl;
+    int shift = bitsPerSample == 8 ? 8 : 0;
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        out[i] = static_cast<int16_t>(in[i] * (1 << shift));
+    }
+    return true;
+}
+
+static std::vector<int32_t> widenSamples(const std::vector<int16_t>& in, uint16_t bitsPerSample) {
+    int shift = bitsPerSample == 8 ? 8 : 0;
+    std::vector<int32_t> out(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        out[i] = in[i] >> shift;
+    }
+    return out;
+}
+
+static uint32_t littleEndian16(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+}
+
+static uint32_t littleEndian32(const uint8_t* p) {
+    return littleEndian16(p) | (littleEndian16(p + 2) << 16);
+}
+
+static uint64_t littleEndian64(const uint8_t* p) {
+    return littleEndian32(p) | (static_cast<uint64_t>(littleEndian32(p + 4)) << 32);
+}
+
+// WAVE_FORMAT_EXTENSIBLE subformat GUID of PCM, after its first two bytes
+// (the format tag)
+static const uint8_t PCM_SUBFORMAT_TAIL[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+WAVReader::WAVReader()
+    : formatTag(0), validBits(0), channelMask(0), rf64(false), dataOffset(0), frames(0), position(0),
+      streamBuffer(STAGING_BYTES) {
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+}
+
+bool WAVReader::fail(const std::string& message) {
+    std::cerr << "Error: " << message << std::endl;
+    close();
+    return false;
+}
+
+bool WAVReader::parseFormat(const uint8_t* format, uint64_t size) {
+    if (size < 16) {
+        return fail("fmt chunk too short");
+    }
+    formatTag = static_cast<uint16_t>(littleEndian16(format));
+    info.channels = static_cast<uint16_t>(littleEndian16(format + 2));
+    info.sampleRate = littleEndian32(format + 4);
+    uint32_t blockAlign = littleEndian16(format + 12);
+    info.bitsPerSample = static_cast<uint16_t>(littleEndian16(format + 14));
+    validBits = info.bitsPerSample;
+    channelMask = 0;
+    
+    if (formatTag == 0xFFFE) {
+        if (size < 40 || littleEndian16(format + 16) < 22) {
+            return fail("WAVE_FORMAT_EXTENSIBLE fmt chunk too short");
+        }
+        validBits = static_cast<uint16_t>(littleEndian16(format + 18));
+        channelMask = littleEndian32(format + 20);
+        if (littleEndian16(format + 24) != 1 || std::memcmp(format + 26, PCM_SUBFORMAT_TAIL, 14) != 0) {
+            return fail("Only the PCM subformat of WAVE_FORMAT_EXTENSIBLE is supported");
+        }
+        if (validBits == 0 || validBits > info.bitsPerSample) {
+            validBits = info.bitsPerSample;
+        }
+    } else if (formatTag != 1) {
+        return fail("Only PCM format (audioFormat=1 or extensible PCM) is supported");
+    }
+    
+    if (info.bitsPerSample != 8 && info.bitsPerSample != 16 &&
+        info.bitsPerSample != 24 && info.bitsPerSample != 32) {
+        std::cerr << "Error: Unsupported bits per sample (" << info.bitsPerSample << ")" << std::endl;
+        close();
         return false;
     }
+    if (info.channels == 0) {
+        return fail("File has no channels");
+    }
+    if (blockAlign != static_cast<uint32_t>(info.channels) * (info.bitsPerSample / 8)) {
+        return fail("Block alignment does not match channels and bits per sample");
+    }
+    return true;
+}
+
+bool WAVReader::open(const std::string& filename) {
+    close();
+    file.open(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+    
+    uint8_t riff[12];
+    if (!file.read(reinterpret_cast<char*>(riff), 12)) {
+        return fail("File too short for a WAV header");
+    }
+    if (std::memcmp(riff, "RF64", 4) == 0 || std::memcmp(riff, "BW64", 4) == 0) {
+        rf64 = true;
+    } else if (std::memcmp(riff, "RIFF", 4) != 0) {
+        return fail("Invalid RIFF header");
+    }
+    if (std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        return fail("Invalid WAVE header");
+    }
+    
+    // Walk the chunks (each padded to an even size) up to "data"
+    uint64_t rf64DataSize = 0;
+    bool haveSizes = false;
+    bool haveFormat = false;
+    uint64_t offset = 12;
+    for (;;) {
+        uint8_t chunk[8];
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        if (offset + 8 > fileSize || !file.read(reinterpret_cast<char*>(chunk), 8)) {
+            return fail("No data chunk");
+        }
+        std::string id(reinterpret_cast<const char*>(chunk), 4);
+        uint64_t size = littleEndian32(chunk + 4);
+        offset += 8;
+        
+        if (id == "ds64" || id == "fmt ") {
+            // Only the fixed fields are needed (not the ds64 table or fmt extras)
+            contents.resize(static_cast<size_t>(std::min<uint64_t>(size, 40)));
+            if (!file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()))) {
+                return fail(id + " chunk truncated");
+            }
+            if (id == "fmt ") {
+                if (!parseFormat(contents.data(), contents.size())) {
+                    return false;
+                }
+                haveFormat = true;
+            } else if (rf64) {
+                // riffSize u64 | dataSize u64 | sampleCount u64 | table
+                if (size < 24) {
+                    return fail("ds64 chunk too short");
+                }
+                rf64DataSize = littleEndian64(contents.data() + 8);
+                haveSizes = true;
+            }
+        } else if (id == "data") {
+            if (!haveFormat) {
+                return fail("data chunk before fmt chunk");
+            }
+            if (rf64 && size == 0xFFFFFFFF) {
+                if (!haveSizes) {
+                    return fail("RF64 file without a ds64 chunk");
+                }
+                size = rf64DataSize;
+            }
+            // Only whole sample frames that are actually in the file
+            size = std::min(size, fileSize - offset);
+            dataOffset = offset;
+            frames = size / (static_cast<uint64_t>(info.channels) * (info.bitsPerSample / 8));
+            break;
+        } else {
+            chunks.push_back(WAVChunk(id, offset, size));
+        }
+        offset += size + (size & 1);
+    }
+    
+    info.numSamples = static_cast<uint32_t>(std::min<uint64_t>(frames, 0xFFFFFFFF));
+    position = 0;
+    file.seekg(static_cast<std::streamoff>(dataOffset), std::ios::beg);
+    return true;
+}
+
+void WAVReader::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    file.clear();
+    info = AudioInfo();
+    formatTag = 0;
+    validBits = 0;
+    channelMask = 0;
+    rf64 = false;
+    dataOffset = 0;
+    frames = 0;
+    position = 0;
+    chunks.clear();
+}
+
+bool WAVReader::isOpen() const {
+    return file.is_open();
+}
+
+const AudioInfo& WAVReader::getInfo() const {
+    return info;
+}
+
+uint64_t WAVReader::getFrameCount() const {
+    return frames;
+}
+
+uint64_t WAVReader::getPosition() const {
+    return position;
+}
+
+uint64_t WAVReader::getDataOffset() const {
+    return dataOffset;
+}
+
+bool WAVReader::isRF64() const {
+    return rf64;
+}
+
+bool WAVReader::isExtensible() const {
+    return formatTag == 0xFFFE;
+}
+
+uint16_t WAVReader::getValidBits() const {
+    return validBits;
+}
+
+uint32_t WAVReader::getChannelMask() const {
+    return channelMask;
+}
+
+const std::vector<WAVChunk>& WAVReader::getChunks() const {
+    return chunks;
+}
+
+size_t WAVReader::read(std::vector<int32_t>& samples, size_t maxFrames) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>(maxFrames, frames - position));
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    samples.resize(count * info.channels);
+    if (count == 0 || !file.is_open()) {
+        samples.clear();
+        return 0;
+    }
     
-    if (std::strncmp(hdr.fmtHeader, "fmt ", 4) != 0) {
-        std::cerr << "Error: Invalid fmt header" << std::endl;
+    if (info.bitsPerSample == 32) {
+        // Same layout as int32_t: read straight into the sample buffer
+        file.read(reinterpret_cast<char*>(samples.data()), static_cast<std::streamsize>(count * bytesPerFrame));
+    } else {
+        raw.resize(count * bytesPerFrame);
+        file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+        pcmToInt32(raw.data(), samples.data(), samples.size(), info.bitsPerSample);
+    }
+    if (!file) {
+        std::cerr << "Error: Cannot read sample data" << std::endl;
+        samples.clear();
+        return 0;
+    }
+    position += count;
+    return count;
+}
+
+size_t WAVReader::read(std::vector<std::vector<int32_t> >& channels, size_t maxFrames) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>(maxFrames, frames - position));
+    channels.resize(info.channels);
+    planes.resize(info.channels);
+    for (size_t c = 0; c < channels.size(); c++) {
+        channels[c].resize(count);
+        planes[c] = channels[c].data();
+    }
+    count = read(planes.data(), count);
+    for (size_t c = 0; c < channels.size(); c++) {
+        channels[c].resize(count);
+    }
+    return count;
+}
+
+size_t WAVReader::read(int32_t* const* channels, size_t maxFrames) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>(maxFrames, frames - position));
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    raw.resize(count * bytesPerFrame);
+    if (count == 0 || !file.is_open()) {
+        return 0;
+    }
+    if (!file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()))) {
+        std::cerr << "Error: Cannot read sample data" << std::endl;
+        return 0;
+    }
+    deinterleavePcm(raw.data(), channels, count, info.channels, info.bitsPerSample);
+    position += count;
+    return count;
+}
+
+bool WAVReader::seek(uint64_t frame) {
+    if (!file.is_open() || frame > frames) {
+        return false;
+    }
+    uint64_t bytesPerFrame = static_cast<uint64_t>(info.channels) * (info.bitsPerSample / 8);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(dataOffset + frame * bytesPerFrame), std::ios::beg);
+    position = frame;
+    return static_cast<bool>(file);
+}
+
+// WAVWriter header: RIFF | JUNK (28 bytes, room for ds64) | fmt | data
+static const size_t WRITER_JUNK_OFFSET = 12;
+static const size_t WRITER_DATA_SIZE_OFFSET = 76;
+static const size_t WRITER_HEADER_SIZE = 80;
+
+static void setLittleEndian(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+WAVWriter::WAVWriter() : frames(0), failed(false), streamBuffer(STAGING_BYTES) {
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+}
+
+WAVWriter::~WAVWriter() {
+    if (isOpen()) {
+        close();
+    }
+}
+
+bool WAVWriter::open(const std::string& filename, const AudioInfo& format) {
+    if (isOpen()) {
+        close();
+    }
+    if (format.bitsPerSample != 8 && format.bitsPerSample != 16 &&
+        format.bitsPerSample != 24 && format.bitsPerSample != 32) {
+        std::cerr << "Error: Unsupported bits per sample (" << format.bitsPerSample << ")" << std::endl;
+        return false;
+    }
+    if (format.channels == 0) {
+        std::cerr << "Error: No channels to write" << std::endl;
         return false;
     }
     
-    if (hdr.audioFormat != 1) {
-        std::cerr << "Error: Only PCM format (audioFormat=1) is supported" << std::endl;
+    file.clear();
+    file.open(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot create file " << filename << std::endl;
         return false;
     }
+    info = format;
+    info.numSamples = 0;
+    frames = 0;
+    failed = false;
     
-    if (std::strncmp(hdr.dataHeader, "data", 4) != 0) {
-        std::cerr << "Error: Invalid data header" << std::endl;
+    uint32_t blockAlign = static_cast<uint32_t>(info.channels) * (info.bitsPerSample / 8);
+    uint8_t header[WRITER_HEADER_SIZE] = {0};
+    std::memcpy(header, "RIFF", 4);
+    std::memcpy(header + 8, "WAVE", 4);
+    std::memcpy(header + WRITER_JUNK_OFFSET, "JUNK", 4);
+    setLittleEndian(header + 16, 28, 4);
+    std::memcpy(header + 48, "fmt ", 4);
+    setLittleEndian(header + 52, 16, 4);
+    setLittleEndian(header + 56, 1, 2); // PCM
+    setLittleEndian(header + 58, info.channels, 2);
+    setLittleEndian(header + 60, info.sampleRate, 4);
+    setLittleEndian(header + 64, static_cast<uint64_t>(info.sampleRate) * blockAlign, 4);
+    setLittleEndian(header + 68, blockAlign, 2);
+    setLittleEndian(header + 70, info.bitsPerSample, 2);
+    std::memcpy(header + 72, "data", 4);
+    file.write(reinterpret_cast<const char*>(header), WRITER_HEADER_SIZE);
+    return static_cast<bool>(file);
+}
+
+bool WAVWriter::write(const int32_t* samples, size_t count) {
+    if (!isOpen()) {
+        return false;
+    }
+    size_t bytesPerSample = info.bitsPerSample / 8;
+    size_t total = count * info.channels;
+    size_t blockSamples = STAGING_BYTES / bytesPerSample;
+    staging.resize(STAGING_BYTES);
+    for (size_t done = 0; done < total; done += blockSamples) {
+        size_t n = std::min(blockSamples, total - done);
+        int32ToPcm(samples + done, staging.data(), n, info.bitsPerSample);
+        file.write(reinterpret_cast<const char*>(staging.data()), static_cast<std::streamsize>(n * bytesPerSample));
+    }
+    frames += count;
+    failed = failed || !file;
+    return !failed;
+}
+
+bool WAVWriter::write(const int32_t* const* channels, size_t count) {
+    if (!isOpen()) {
+        return false;
+    }
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    size_t blockFrames = std::max<size_t>(STAGING_BYTES / bytesPerFrame, 1);
+    staging.resize(blockFrames * bytesPerFrame);
+    planes.resize(info.channels);
+    for (size_t done = 0; done < count; done += blockFrames) {
+        size_t n = std::min(blockFrames, count - done);
+        for (size_t c = 0; c < planes.size(); c++) {
+            planes[c] = channels[c] + done;
+        }
+        interleavePcm(planes.data(), staging.data(), n, info.channels, info.bitsPerSample);
+        file.write(reinterpret_cast<const char*>(staging.data()), static_cast<std::streamsize>(n * bytesPerFrame));
+    }
+    frames += count;
+    failed = failed || !file;
+    return !failed;
+}
+
+bool WAVWriter::write(const std::vector<std::vector<int32_t> >& channels) {
+    if (channels.size() != info.channels) {
+        std::cerr << "Error: Expected " << info.channels << " channels, got " << channels.size() << std::endl;
+        return false;
+    }
+    for (size_t c = 1; c < channels.size(); c++) {
+        if (channels[c].size() != channels[0].size()) {
+            std::cerr << "Error: Channels have different sizes" << std::endl;
+            return false;
+        }
+    }
+    std::vector<const int32_t*> source(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        source[c] = channels[c].data();
+    }
+    return write(source.data(), channels.empty() ? 0 : channels[0].size());
+}
+
+bool WAVWriter::close() {
+    if (!isOpen()) {
         return false;
     }
+    uint64_t dataSize = frames * info.channels * (info.bitsPerSample / 8);
+    if (dataSize & 1) {
+        file.put('\0'); // Chunks are word aligned
+    }
+    uint64_t riffSize = WRITER_HEADER_SIZE - 8 + dataSize + (dataSize & 1);
     
-    return true;
+    if (riffSize > 0xFFFFFFFF) {
+        // RF64: the real sizes go in ds64, the 32-bit fields are all ones
+        uint8_t ds64[36];
+        std::memcpy(ds64, "ds64", 4);
+        setLittleEndian(ds64 + 4, 28, 4);
+        setLittleEndian(ds64 + 8, riffSize, 8);
+        setLittleEndian(ds64 + 16, dataSize, 8);
+        setLittleEndian(ds64 + 24, frames, 8);
+        setLittleEndian(ds64 + 32, 0, 4); // No table entries
+        file.seekp(0);
+        file.write("RF64\xFF\xFF\xFF\xFF", 8);
+        file.seekp(WRITER_JUNK_OFFSET);
+        file.write(reinterpret_cast<const char*>(ds64), sizeof(ds64));
+        file.seekp(WRITER_DATA_SIZE_OFFSET);
+        file.write("\xFF\xFF\xFF\xFF", 4);
+    } else {
+        uint8_t size[4];
+        setLittleEndian(size, riffSize, 4);
+        file.seekp(4);
+        file.write(reinterpret_cast<const char*>(size), 4);
+        setLittleEndian(size, dataSize, 4);
+        file.seekp(WRITER_DATA_SIZE_OFFSET);
+        file.write(reinterpret_cast<const char*>(size), 4);
+    }
+    
+    bool ok = !failed && static_cast<bool>(file);
+    file.close();
+    if (!ok) {
+        std::cerr << "Error: Cannot write WAV file" << std::endl;
+    }
+    return ok;
+}
+
+bool WAVWriter::isOpen() const {
+    return file.is_open();
+}
+
+uint64_t WAVWriter::getFrameCount() const {
+    return frames;
 }
 
 // Create WAV header
@@ -56,58 +527,136 @@ void WAVFile::createHeader(uint32_t sampleRate, uint16_t channels, uint16_t bits
 
 // Read WAV file
 bool WAVFile::read(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filename << std::endl;
+    ProfileTimer timer(profile, PROFILE_WAV_IO);
+    unmap();
+    if (!reader.open(filename)) {
         return false;
     }
-    
-    // Read header
-    file.read(reinterpret_cast<char*>(&header), sizeof(WAVHeader));
-    
-    if (!validateHeader(header)) {
-        file.close();
+    if (reader.getFrameCount() > 0xFFFFFFFF) {
+        std::cerr << "Error: File too long to load at once (use WAVReader)" << std::endl;
         return false;
     }
     
-    // Read audio data
-    uint32_t numSamples = header.dataSize / (header.bitsPerSample / 8);
-    audioData.resize(numSamples);
+    info = reader.getInfo();
+    createHeader(info.sampleRate, info.channels, info.bitsPerSample, info.numSamples);
+    bool complete = reader.read(audioData, info.numSamples) == info.numSamples;
+    reader.close();
+    return complete;
+}
+
+// Map the whole file read-only; samples are converted from the mapping on demand
+bool WAVFile::map(const std::string& filename) {
+    ProfileTimer timer(profile, PROFILE_WAV_IO);
+    unmap();
+    audioData.clear();
     
-    if (header.bitsPerSample == 16) {
-        file.read(reinterpret_cast<char*>(audioData.data()), header.dataSize);
-    } else if (header.bitsPerSample == 8) {
-        // Convert 8-bit unsigned to 16-bit signed
-        std::vector<uint8_t> data8(numSamples);
-        file.read(reinterpret_cast<char*>(data8.data()), header.dataSize);
-        for (size_t i = 0; i < numSamples; i++) {
-            audioData[i] = (data8[i] - 128) * 256;
+    // The chunks are parsed with a reader, then the file is mapped
+    if (!reader.open(filename)) {
+        return false;
+    }
+    info = reader.getInfo();
+    uint64_t dataOffset = reader.getDataOffset();
+    uint64_t frames = reader.getFrameCount();
+    reader.close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (mapping != NULL) {
+        mapped = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        mappedSize = static_cast<size_t>(size.QuadPart);
+        CloseHandle(mapping); // The view keeps the mapping alive
+    }
+    CloseHandle(file);
+#else
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        void* address = mmap(NULL, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (address != MAP_FAILED) {
+            mapped = static_cast<const uint8_t*>(address);
+            mappedSize = static_cast<size_t>(status.st_size);
+            madvise(address, mappedSize, MADV_SEQUENTIAL);
         }
     }
+    ::close(file); // The mapping stays valid
+#endif
+    if (mapped == NULL) {
+        std::cerr << "Error: Cannot map file " << filename << std::endl;
+        return false;
+    }
     
-    file.close();
-    
-    // Fill AudioInfo
-    info.sampleRate = header.sampleRate;
-    info.channels = header.numChannels;
-    info.bitsPerSample = header.bitsPerSample;
-    info.numSamples = numSamples / header.numChannels;
+    if (dataOffset > mappedSize) {
+        std::cerr << "Error: File changed while it was mapped" << std::endl;
+        unmap();
+        return false;
+    }
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    frames = std::min<uint64_t>(frames, (mappedSize - dataOffset) / bytesPerFrame);
+    span = PCMSpan(mapped + dataOffset, static_cast<size_t>(frames), info.channels, info.bitsPerSample);
     
+    info.numSamples = static_cast<uint32_t>(std::min<uint64_t>(span.frames, 0xFFFFFFFF));
+    createHeader(info.sampleRate, info.channels, info.bitsPerSample, info.numSamples);
     return true;
 }
 
+void WAVFile::unmap() {
+    if (mapped != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapped);
+#else
+        munmap(const_cast<uint8_t*>(mapped), mappedSize);
+#endif
+    }
+    mapped = NULL;
+    mappedSize = 0;
+    span = PCMSpan();
+}
+
+bool WAVFile::isMapped() const {
+    return mapped != NULL;
+}
+
+const PCMSpan& WAVFile::getSpan() const {
+    return span;
+}
+
 // Read mono WAV file
 bool WAVFile::readMono(const std::string& filename, std::vector<int16_t>& samples, AudioInfo& outInfo) {
     if (!read(filename)) {
         return false;
     }
     
-    if (header.numChannels != 1) {
+    if (info.channels != 1) {
         std::cerr << "Error: File is not mono" << std::endl;
         return false;
     }
     
-    samples = audioData;
+    if (!narrowSamples(audioData, samples, info.bitsPerSample)) {
+        return false;
+    }
+    outInfo = info;
+    return true;
+}
+
+bool WAVFile::readMono(const std::string& filename, std::vector<int32_t>& samples, AudioInfo& outInfo) {
+    if (!readPlanar(filename, planarChannels, 1)) {
+        return false;
+    }
+    samples.swap(planarChannels[0]);
     outInfo = info;
     return true;
 }
@@ -117,45 +666,136 @@ bool WAVFile::readStereo(const std::string& filename,
                         std::vector<int16_t>& leftChannel, 
                         std::vector<int16_t>& rightChannel, 
                         AudioInfo& outInfo) {
-    if (!read(filename)) {
+    std::vector<int32_t> left, right;
+    if (!readStereo(filename, left, right, outInfo)) {
         return false;
     }
-    
-    if (header.numChannels != 2) {
-        std::cerr << "Error: File is not stereo" << std::endl;
+    return narrowSamples(left, leftChannel, outInfo.bitsPerSample) &&
+           narrowSamples(right, rightChannel, outInfo.bitsPerSample);
+}
+
+bool WAVFile::readStereo(const std::string& filename,
+                        std::vector<int32_t>& leftChannel,
+                        std::vector<int32_t>& rightChannel,
+                        AudioInfo& outInfo) {
+    if (!readPlanar(filename, planarChannels, 2)) {
         return false;
     }
-    
-    // De-interleave stereo data
-    size_t numSamples = audioData.size() / 2;
-    leftChannel.resize(numSamples);
-    rightChannel.resize(numSamples);
-    
-    for (size_t i = 0; i < numSamples; i++) {
-        leftChannel[i] = audioData[i * 2];
-        rightChannel[i] = audioData[i * 2 + 1];
+    leftChannel.swap(planarChannels[0]);
+    rightChannel.swap(planarChannels[1]);
+    outInfo = info;
+    return true;
+}
+
+// Read WAV file with any number of channels, de-interleaving all of them in one pass
+bool WAVFile::readMultichannel(const std::string& filename,
+                               std::vector<std::vector<int16_t> >& channels,
+                               AudioInfo& outInfo) {
+    std::vector<std::vector<int32_t> > wide;
+    if (!readMultichannel(filename, wide, outInfo)) {
+        return false;
     }
     
+    channels.resize(wide.size());
+    for (size_t c = 0; c < wide.size(); c++) {
+        if (!narrowSamples(wide[c], channels[c], outInfo.bitsPerSample)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WAVFile::readMultichannel(const std::string& filename,
+                               std::vector<std::vector<int32_t> >& channels,
+                               AudioInfo& outInfo) {
+    if (!readPlanar(filename, channels, 0)) {
+        return false;
+    }
     outInfo = info;
     return true;
 }
 
+bool WAVFile::readPlanar(const std::string& filename, std::vector<std::vector<int32_t> >& channels,
+                         uint16_t requiredChannels) {
+    ProfileTimer timer(profile, PROFILE_WAV_IO);
+    unmap();
+    audioData.clear();
+    if (!reader.open(filename)) {
+        return false;
+    }
+    info = reader.getInfo();
+    if (requiredChannels != 0 && info.channels != requiredChannels) {
+        std::cerr << "Error: File is not " << (requiredChannels == 1 ? "mono" : "stereo") << std::endl;
+        reader.close();
+        return false;
+    }
+    if (reader.getFrameCount() > 0xFFFFFFFF) {
+        std::cerr << "Error: File too long to load at once (use WAVReader)" << std::endl;
+        reader.close();
+        return false;
+    }
+    createHeader(info.sampleRate, info.channels, info.bitsPerSample, info.numSamples);
+    
+    size_t numSamples = info.numSamples;
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    size_t blockFrames = std::max<size_t>(STAGING_BYTES / bytesPerFrame, 1);
+    channels.resize(info.channels);
+    targetPlanes.resize(info.channels);
+    for (size_t c = 0; c < channels.size(); c++) {
+        channels[c].resize(numSamples);
+    }
+    for (size_t done = 0; done < numSamples;) {
+        for (size_t c = 0; c < targetPlanes.size(); c++) {
+            targetPlanes[c] = channels[c].data() + done;
+        }
+        size_t n = reader.read(targetPlanes.data(), std::min(blockFrames, numSamples - done));
+        if (n == 0) {
+            reader.close();
+            return false;
+        }
+        done += n;
+    }
+    reader.close();
+    return true;
+}
+
 // Write WAV file
 bool WAVFile::write(const std::string& filename, const std::vector<int16_t>& samples, const AudioInfo& info) {
-    std::ofstream file(filename, std::ios::binary);
+    return write(filename, widenSamples(samples, info.bitsPerSample), info);
+}
+
+bool WAVFile::write(const std::string& filename, const std::vector<int32_t>& samples, const AudioInfo& info) {
+    ProfileTimer timer(profile, PROFILE_WAV_IO);
+    if (info.bitsPerSample != 8 && info.bitsPerSample != 16 &&
+        info.bitsPerSample != 24 && info.bitsPerSample != 32) {
+        std::cerr << "Error: Unsupported bits per sample (" << info.bitsPerSample << ")" << std::endl;
+        return false;
+    }
+    
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+    file.open(filename.c_str(), std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Error: Cannot create file " << filename << std::endl;
         return false;
     }
     
-    // Create header
-    createHeader(info.sampleRate, info.channels, info.bitsPerSample, samples.size());
+    // Create header (samples are interleaved, the header counts sample frames)
+    createHeader(info.sampleRate, info.channels, info.bitsPerSample,
+                 samples.size() / std::max<uint16_t>(info.channels, 1));
     
     // Write header
     file.write(reinterpret_cast<const char*>(&header), sizeof(WAVHeader));
     
-    // Write audio data
-    file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(int16_t));
+    // Write audio data packed to the file's sample width
+    size_t bytesPerSample = info.bitsPerSample / 8;
+    size_t blockSamples = STAGING_BYTES / bytesPerSample;
+    staging.resize(STAGING_BYTES);
+    for (size_t done = 0; done < samples.size(); done += blockSamples) {
+        size_t n = std::min(blockSamples, samples.size() - done);
+        int32ToPcm(samples.data() + done, staging.data(), n, info.bitsPerSample);
+        file.write(reinterpret_cast<const char*>(staging.data()), static_cast<std::streamsize>(n * bytesPerSample));
+    }
     
     file.close();
     return true;
@@ -166,27 +806,110 @@ bool WAVFile::writeStereo(const std::string& filename,
                          const std::vector<int16_t>& leftChannel,
                          const std::vector<int16_t>& rightChannel,
                          const AudioInfo& info) {
+    return writeStereo(filename, widenSamples(leftChannel, info.bitsPerSample),
+                       widenSamples(rightChannel, info.bitsPerSample), info);
+}
+
+bool WAVFile::writeStereo(const std::string& filename,
+                         const std::vector<int32_t>& leftChannel,
+                         const std::vector<int32_t>& rightChannel,
+                         const AudioInfo& info) {
     if (leftChannel.size() != rightChannel.size()) {
         std::cerr << "Error: Left and right channels have different sizes" << std::endl;
         return false;
     }
     
-    // Interleave stereo data
-    std::vector<int16_t> interleaved(leftChannel.size() * 2);
-    for (size_t i = 0; i < leftChannel.size(); i++) {
-        interleaved[i * 2] = leftChannel[i];
-        interleaved[i * 2 + 1] = rightChannel[i];
-    }
-    
     AudioInfo stereoInfo = info;
     stereoInfo.channels = 2;
     stereoInfo.numSamples = leftChannel.size();
     
-    return write(filename, interleaved, stereoInfo);
+    const int32_t* planes[2] = {leftChannel.data(), rightChannel.data()};
+    return writePlanar(filename, planes, leftChannel.size(), stereoInfo);
+}
+
+// Write WAV file with any number of channels
+bool WAVFile::writeMultichannel(const std::string& filename,
+                                const std::vector<std::vector<int16_t> >& channels,
+                                const AudioInfo& info) {
+    std::vector<std::vector<int32_t> > wide(channels.size());
+    for (size_t c = 0; c < channels.size(); c++) {
+        wide[c] = widenSamples(channels[c], info.bitsPerSample);
+    }
+    return writeMultichannel(filename, wide, info);
+}
+
+bool WAVFile::writeMultichannel(const std::string& filename,
+                                const std::vector<std::vector<int32_t> >& channels,
+                                const AudioInfo& info) {
+    if (channels.empty()) {
+        std::cerr << "Error: No channels to write" << std::endl;
+        return false;
+    }
+    
+    size_t numChannels = channels.size();
+    size_t numSamples = channels[0].size();
+    for (size_t c = 1; c < numChannels; c++) {
+        if (channels[c].size() != numSamples) {
+            std::cerr << "Error: Channels have different sizes" << std::endl;
+            return false;
+        }
+    }
+    
+    AudioInfo multiInfo = info;
+    multiInfo.channels = numChannels;
+    multiInfo.numSamples = numSamples;
+    
+    sourcePlanes.resize(numChannels);
+    for (size_t c = 0; c < numChannels; c++) {
+        sourcePlanes[c] = channels[c].data();
+    }
+    return writePlanar(filename, sourcePlanes.data(), numSamples, multiInfo);
+}
+
+// Interleave and pack one staging block at a time instead of the whole file
+bool WAVFile::writePlanar(const std::string& filename, const int32_t* const* channels, size_t numSamples,
+                          const AudioInfo& info) {
+    ProfileTimer timer(profile, PROFILE_WAV_IO);
+    if (info.bitsPerSample != 8 && info.bitsPerSample != 16 &&
+        info.bitsPerSample != 24 && info.bitsPerSample != 32) {
+        std::cerr << "Error: Unsupported bits per sample (" << info.bitsPerSample << ")" << std::endl;
+        return false;
+    }
+    
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+    file.open(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot create file " << filename << std::endl;
+        return false;
+    }
+    
+    createHeader(info.sampleRate, info.channels, info.bitsPerSample, numSamples);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(WAVHeader));
+    
+    size_t bytesPerFrame = static_cast<size_t>(info.channels) * (info.bitsPerSample / 8);
+    size_t blockFrames = std::max<size_t>(STAGING_BYTES / bytesPerFrame, 1);
+    staging.resize(blockFrames * bytesPerFrame);
+    blockPlanes.resize(info.channels);
+    for (size_t done = 0; done < numSamples; done += blockFrames) {
+        size_t n = std::min(blockFrames, numSamples - done);
+        for (size_t c = 0; c < blockPlanes.size(); c++) {
+            blockPlanes[c] = channels[c] + done;
+        }
+        interleavePcm(blockPlanes.data(), staging.data(), n, info.channels, info.bitsPerSample);
+        file.write(reinterpret_cast<const char*>(staging.data()), static_cast<std::streamsize>(n * bytesPerFrame));
+    }
+    
+    file.close();
+    return true;
+}
+
+void WAVFile::setProfile(CodecProfile* target) {
+    profile = target;
 }
 
 // Getters
-const std::vector<int16_t>& WAVFile::getAudioData() const {
+const std::vector<int32_t>& WAVFile::getAudioData() const {
     return audioData;
 }
 
@@ -220,7 +943,8 @@ void WAVFile::printInfo() const {
     std::cout << "Bits per Sample: " << info.bitsPerSample << std::endl;
     std::cout << "Number of Samples: " << info.numSamples << std::endl;
     std::cout << "Duration: " << getDurationSeconds() << " seconds" << std::endl;
-    std::cout << "File Size: " << (audioData.size() * sizeof(int16_t) + sizeof(WAVHeader)) 
+    std::cout << "File Size: "
+              << (mapped ? mappedSize : audioData.size() * (info.bitsPerSample / 8) + sizeof(WAVHeader))
               << " bytes" << std::endl;
 }
 
@@ -2,6 +2,7 @@
 #define WAV_FILE_H
 
 #include "AudioCodec.h"
+#include "PCMConvert.h"
 #include <string>
 #include <vector>
 #include <fstream>
@@ -31,35 +32,203 @@ struct WAVHeader {
 };
 #pragma pack(pop)
 
+// A chunk of a RIFF file other than "fmt " and "data" (LIST, bext, ...)
+struct WAVChunk {
+    std::string id;
+    uint64_t offset; // Of the chunk contents, from the start of the file
+    uint64_t size;
+    
+    WAVChunk(const std::string& chunkId, uint64_t at, uint64_t bytes) : id(chunkId), offset(at), size(bytes) {}
+};
+
+// Streaming WAV reader. open() walks the RIFF chunks up to "data", so
+// metadata chunks (LIST, bext, iXML, ...) in any order are skipped and
+// listed. Accepts WAVE_FORMAT_PCM and WAVE_FORMAT_EXTENSIBLE with the PCM
+// subformat, and RF64/BW64 files, whose 64-bit sizes come from the ds64
+// chunk, so files over 4 GB work. Samples are then read in blocks of
+// frames, so the whole file is never in memory. In extensible files with
+// fewer valid bits than the container, samples keep the container's range
+// (the unused low bits are zero, which the codec does not code).
+class WAVReader {
+private:
+    std::ifstream file;
+    AudioInfo info;
+    uint16_t formatTag;
+    uint16_t validBits;
+    uint32_t channelMask;
+    bool rf64;
+    uint64_t dataOffset;
+    uint64_t frames;
+    uint64_t position; // Next frame to read
+    std::vector<WAVChunk> chunks;
+    std::vector<char> streamBuffer; // Given to the stream, so opening a file does not allocate
+    std::vector<uint8_t> contents;  // Of the chunk being parsed
+    std::vector<uint8_t> raw;       // One block of packed samples
+    std::vector<int32_t*> planes;
+    
+    bool fail(const std::string& message);
+    bool parseFormat(const uint8_t* format, uint64_t size);
+
+public:
+    WAVReader();
+    
+    // Prints an error and returns false for files it cannot read
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const;
+    
+    // info.numSamples saturates at 2^32 - 1 frames; getFrameCount does not
+    const AudioInfo& getInfo() const;
+    uint64_t getFrameCount() const;
+    uint64_t getPosition() const;
+    uint64_t getDataOffset() const; // Of the first sample, in bytes
+    bool isRF64() const;
+    bool isExtensible() const;
+    uint16_t getValidBits() const;
+    uint32_t getChannelMask() const; // Speaker positions (extensible files only)
+    const std::vector<WAVChunk>& getChunks() const;
+    
+    // Read up to maxFrames frames from the current position, interleaved or
+    // one vector per channel (resized to the frames read), or into one
+    // array per channel with room for maxFrames. Returns the number of
+    // frames read: 0 at the end of the data or on a read error.
+    size_t read(std::vector<int32_t>& samples, size_t maxFrames);
+    size_t read(std::vector<std::vector<int32_t> >& channels, size_t maxFrames);
+    size_t read(int32_t* const* channels, size_t maxFrames);
+    bool seek(uint64_t frame);
+};
+
+// Streaming WAV writer: open() writes a header with placeholder sizes,
+// write() appends blocks of frames as they are produced, and close() patches
+// the sizes in, so the whole output never has to be in memory. The header
+// reserves a JUNK chunk after "WAVE"; if the data outgrows the 32-bit RIFF
+// sizes, close() turns it into a ds64 chunk and the file into RF64.
+class WAVWriter {
+private:
+    std::ofstream file;
+    AudioInfo info;
+    uint64_t frames;
+    bool failed;
+    std::vector<char> streamBuffer;
+    std::vector<uint8_t> staging; // One block of packed samples
+    std::vector<const int32_t*> planes;
+
+public:
+    WAVWriter();
+    ~WAVWriter(); // Closes the file if still open
+    
+    // info.numSamples is ignored. Prints an error and returns false if the
+    // format is unsupported or the file cannot be created.
+    bool open(const std::string& filename, const AudioInfo& info);
+    
+    // Append frames, interleaved or one array per channel (samples in the
+    // native range of bitsPerSample)
+    bool write(const int32_t* samples, size_t count);
+    bool write(const int32_t* const* channels, size_t count);
+    bool write(const std::vector<std::vector<int32_t> >& channels);
+    
+    // Patch the sizes and close; false if any write failed
+    bool close();
+    bool isOpen() const;
+    uint64_t getFrameCount() const;
+};
+
 class WAVFile {
 private:
     WAVHeader header;
-    std::vector<int16_t> audioData;
+    std::vector<int32_t> audioData; // Interleaved, native range of bitsPerSample
     AudioInfo info;
+    CodecProfile* profile; // Time of read and write is charged to PROFILE_WAV_IO (NULL = off)
+    
+    // Memory-mapped file (map)
+    const uint8_t* mapped; // Whole file, or NULL
+    size_t mappedSize;
+    PCMSpan span;          // Data chunk within the mapping
+    
+    // Kept between files, so that reading and writing files of the same
+    // shape again does not allocate
+    WAVReader reader;
+    std::vector<char> streamBuffer; // Of the output stream
+    std::vector<uint8_t> staging;   // One block of packed samples
+    std::vector<const int32_t*> sourcePlanes, blockPlanes;
+    std::vector<int32_t*> targetPlanes;
+    std::vector<std::vector<int32_t> > planarChannels; // Swapped with readMono's and readStereo's vectors
     
-    bool validateHeader(const WAVHeader& hdr);
     void createHeader(uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample, uint32_t numSamples);
+    
+    // Planar I/O in blocks through a fixed-size staging buffer (requiredChannels 0 = any)
+    bool readPlanar(const std::string& filename, std::vector<std::vector<int32_t> >& channels,
+                    uint16_t requiredChannels);
+    bool writePlanar(const std::string& filename, const int32_t* const* channels, size_t numSamples,
+                     const AudioInfo& info);
+    
+    // A mapping cannot be shared between copies
+    WAVFile(const WAVFile&);
+    WAVFile& operator=(const WAVFile&);
 
 public:
     WAVFile();
+    ~WAVFile();
     
-    // Reading WAV files
+    // Reading WAV files (8, 16, 24 and 32-bit PCM, through WAVReader)
+    // The int32_t overloads return samples in their native range; the int16_t
+    // overloads scale 8-bit audio to 16 bits and reject wider files.
+    // The int32_t readMono, readStereo and readMultichannel convert block by
+    // block straight into channel vectors, so getAudioData() is left empty.
+    // Their capacity is reused: readMultichannel fills the caller's vectors,
+    // readMono and readStereo swap theirs with the ones they were given.
     bool read(const std::string& filename);
+    bool readMono(const std::string& filename, std::vector<int32_t>& samples, AudioInfo& outInfo);
     bool readMono(const std::string& filename, std::vector<int16_t>& samples, AudioInfo& outInfo);
+    bool readStereo(const std::string& filename,
+                   std::vector<int32_t>& leftChannel,
+                   std::vector<int32_t>& rightChannel,
+                   AudioInfo& outInfo);
     bool readStereo(const std::string& filename, 
                    std::vector<int16_t>& leftChannel, 
                    std::vector<int16_t>& rightChannel, 
                    AudioInfo& outInfo);
+    bool readMultichannel(const std::string& filename,
+                          std::vector<std::vector<int32_t> >& channels,
+                          AudioInfo& outInfo);
+    bool readMultichannel(const std::string& filename,
+                          std::vector<std::vector<int16_t> >& channels,
+                          AudioInfo& outInfo);
     
-    // Writing WAV files
+    // Zero-copy reading: map the file into memory (mmap, or a file mapping
+    // on Windows) instead of reading it. getSpan() then views the packed
+    // samples in place, for AudioCodec::encodeMultichannel(PCMSpan), so no
+    // sample vector is made; the pages are read as they are first touched.
+    // getInfo() is filled in as by read(); getAudioData() stays empty. The
+    // span is valid until unmap(), the next map() or read(), or destruction.
+    bool map(const std::string& filename);
+    void unmap();
+    bool isMapped() const;
+    const PCMSpan& getSpan() const;
+    
+    // Writing WAV files (packed to info.bitsPerSample, one block at a time)
+    bool write(const std::string& filename, const std::vector<int32_t>& samples, const AudioInfo& info);
     bool write(const std::string& filename, const std::vector<int16_t>& samples, const AudioInfo& info);
+    bool writeStereo(const std::string& filename,
+                    const std::vector<int32_t>& leftChannel,
+                    const std::vector<int32_t>& rightChannel,
+                    const AudioInfo& info);
     bool writeStereo(const std::string& filename,
                     const std::vector<int16_t>& leftChannel,
                     const std::vector<int16_t>& rightChannel,
                     const AudioInfo& info);
+    bool writeMultichannel(const std::string& filename,
+                           const std::vector<std::vector<int32_t> >& channels,
+                           const AudioInfo& info);
+    bool writeMultichannel(const std::string& filename,
+                           const std::vector<std::vector<int16_t> >& channels,
+                           const AudioInfo& info);
+    
+    // Instrumentation (CodecProfile.h), off by default
+    void setProfile(CodecProfile* profile);
     
     // Getters
-    const std::vector<int16_t>& getAudioData() const;
+    const std::vector<int32_t>& getAudioData() const;
     const AudioInfo& getInfo() const;
     uint32_t getSampleRate() const;
     uint16_t getChannels() const;
@@ -0,0 +1,367 @@
+// Compression benchmark: encodes and decodes a corpus of WAV files and
+// synthetic signals at a set of presets, with warmup and repeated runs, and
+// reports the median wall-clock throughput, x-realtime factor, compression
+// ratio and peak resident memory of each (input, preset) pair.
+//
+// Usage: audio_bench [options] [file.wav ...]
+//   --presets LIST     comma-separated effort levels (default 0,3,5,7)
+//   --synthetic LIST   sine,multitone,noise,silence,speech, all or none (default all)
+//   --seconds S        length of the synthetic signals (default 10)
+//   --channels N       channels of the synthetic signals (default 2)
+//   --rate HZ          sample rate of the synthetic signals (default 44100)
+//   --runs N           timed runs per measurement (default 5)
+//   --warmup N         untimed runs before them (default 1)
+//   --json PATH        write the results as JSON
+//   --csv PATH         write the results as CSV
+
+#include "AudioCodec.h"
+#include "WAVFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+struct BenchInput {
+    std::string name;
+    std::vector<std::vector<int32_t> > channels;
+    AudioInfo info;
+};
+
+struct BenchResult {
+    std::string input;
+    int preset;
+    AudioInfo info;
+    double seconds;
+    double ratio;
+    double encodeMBps;
+    double decodeMBps;
+    double encodeRealtime;
+    double decodeRealtime;
+    long peakRssKB;
+    bool lossless;
+};
+
+// Reset the peak resident set size where the kernel allows it (Linux), so
+// each measurement reports its own peak rather than the process maximum
+static void resetPeakMemory() {
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) clearRefs << "5";
+#endif
+}
+
+// Peak resident set size in KB (0 where it cannot be measured)
+static long peakMemoryKB() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+        return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+        return static_cast<long>(usage.ru_maxrss);
+#endif
+    }
+#endif
+    return 0;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Synthetic signals, 16-bit, deterministic. The channels differ slightly
+// (gain and a small delay) so stereo decorrelation has something to do.
+static BenchInput generateSignal(const std::string& kind, double seconds, int numChannels, uint32_t sampleRate) {
+    BenchInput input;
+    input.name = kind;
+    input.info.sampleRate = sampleRate;
+    input.info.channels = static_cast<uint16_t>(numChannels);
+    input.info.bitsPerSample = 16;
+    size_t numSamples = static_cast<size_t>(seconds * sampleRate);
+    input.info.numSamples = static_cast<uint32_t>(numSamples);
+    
+    std::vector<double> signal(numSamples + 64, 0.0);
+    std::srand(1234);
+    double rate = static_cast<double>(sampleRate);
+    if (kind == "sine") {
+        for (size_t i = 0; i < signal.size(); i++) {
+            signal[i] = 16000.0 * std::sin(2.0 * M_PI * 440.0 * i / rate);
+        }
+    } else if (kind == "multitone") {
+        const double tones[] = {261.6, 329.6, 392.0, 523.3, 1046.5, 3136.0};
+        for (size_t i = 0; i < signal.size(); i++) {
+            double t = i / rate;
+            for (int k = 0; k < 6; k++) {
+                double level = 4000.0 / (k + 1) * (0.6 + 0.4 * std::sin(t * (k + 1)));
+                signal[i] += level * std::sin(2.0 * M_PI * tones[k] * t);
+            }
+        }
+    } else if (kind == "noise") {
+        for (size_t i = 0; i < signal.size(); i++) {
+            signal[i] = 8000.0 * (2.0 * std::rand() / RAND_MAX - 1.0);
+        }
+    } else if (kind == "speech") {
+        // Glottal pulses with a wandering pitch through two formant
+        // resonators, in syllables of about 200 ms separated by pauses
+        double phase = 0.0;
+        double y1[2] = {0.0, 0.0};
+        double y2[2] = {0.0, 0.0};
+        for (size_t i = 0; i < signal.size(); i++) {
+            double t = i / rate;
+            double pitch = 120.0 + 30.0 * std::sin(2.0 * M_PI * 0.7 * t);
+            phase += pitch / rate;
+            double pulse = 0.0;
+            if (phase >= 1.0) {
+                phase -= 1.0;
+                pulse = 1.0;
+            }
+            double excitation = pulse + 0.02 * (2.0 * std::rand() / RAND_MAX - 1.0);
+            double formant1 = 500.0 + 300.0 * std::sin(2.0 * M_PI * 2.5 * t);
+            double formant2 = 1500.0 + 700.0 * std::sin(2.0 * M_PI * 1.7 * t + 1.0);
+            const double radius = 0.97;
+            double a1 = 2.0 * radius * std::cos(2.0 * M_PI * formant1 / rate);
+            double a2 = 2.0 * radius * std::cos(2.0 * M_PI * formant2 / rate);
+            double out1 = excitation + a1 * y1[0] - radius * radius * y1[1];
+            double out2 = out1 + a2 * y2[0] - radius * radius * y2[1];
+            y1[1] = y1[0];
+            y1[0] = out1;
+            y2[1] = y2[0];
+            y2[0] = out2;
+            double syllable = std::max(0.0, std::sin(2.0 * M_PI * 2.3 * t));
+            signal[i] = 60.0 * out2 * syllable * syllable;
+        }
+    }
+    // "silence" stays all zeros
+    
+    input.channels.assign(numChannels, std::vector<int32_t>(numSamples));
+    for (int c = 0; c < numChannels; c++) {
+        double gain = 1.0 - 0.1 * c;
+        size_t delay = static_cast<size_t>(c) * 3 % 64;
+        for (size_t i = 0; i < numSamples; i++) {
+            double value = std::floor(gain * signal[i + 64 - delay] + 0.5);
+            input.channels[c][i] = static_cast<int32_t>(std::max(-32768.0, std::min(32767.0, value)));
+        }
+    }
+    return input;
+}
+
+static BenchResult runBenchmark(const BenchInput& input, int preset, int runs, int warmup) {
+    BenchResult result;
+    result.input = input.name;
+    result.preset = preset;
+    result.info = input.info;
+    result.seconds = input.info.sampleRate > 0 ?
+        static_cast<double>(input.info.numSamples) / input.info.sampleRate : 0.0;
+    
+    AudioCodec codec;
+    codec.setPreset(preset);
+    resetPeakMemory();
+    
+    CompressedAudio compressed;
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    std::vector<double> encodeTimes, decodeTimes;
+    for (int run = 0; run < warmup + runs; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        compressed = codec.encodeMultichannel(input.channels, input.info);
+        std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+        codec.decodeMultichannel(compressed, decoded, decodedInfo);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (run >= warmup) {
+            encodeTimes.push_back(std::chrono::duration<double>(middle - start).count());
+            decodeTimes.push_back(std::chrono::duration<double>(end - middle).count());
+        }
+    }
+    
+    // Throughput is measured on the PCM size at the source bit depth
+    double megabytes = static_cast<double>(input.info.numSamples) * input.info.channels *
+                       ((input.info.bitsPerSample + 7) / 8) / 1e6;
+    double encodeTime = std::max(median(encodeTimes), 1e-9);
+    double decodeTime = std::max(median(decodeTimes), 1e-9);
+    result.ratio = compressed.compressionRatio;
+    result.encodeMBps = megabytes / encodeTime;
+    result.decodeMBps = megabytes / decodeTime;
+    result.encodeRealtime = result.seconds / encodeTime;
+    result.decodeRealtime = result.seconds / decodeTime;
+    result.peakRssKB = peakMemoryKB();
+    result.lossless = decoded == input.channels;
+    return result;
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\') quoted += '\\';
+        quoted += text[i];
+    }
+    return quoted + "\"";
+}
+
+static void writeJSON(std::ostream& out, const std::vector<BenchResult>& results, int runs, int warmup) {
+    out << "{\n  \"runs\": " << runs << ",\n  \"warmup\": " << warmup << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "    {\"input\": " << jsonString(r.input) << ", \"preset\": " << r.preset
+            << ", \"channels\": " << r.info.channels << ", \"sampleRate\": " << r.info.sampleRate
+            << ", \"bitsPerSample\": " << r.info.bitsPerSample << ", \"seconds\": " << r.seconds
+            << ", \"ratio\": " << r.ratio << ", \"encodeMBps\": " << r.encodeMBps
+            << ", \"decodeMBps\": " << r.decodeMBps << ", \"encodeRealtime\": " << r.encodeRealtime
+            << ", \"decodeRealtime\": " << r.decodeRealtime << ", \"peakRssKB\": " << r.peakRssKB
+            << ", \"lossless\": " << (r.lossless ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void writeCSV(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "input,preset,channels,sample_rate,bits_per_sample,seconds,ratio,encode_mbps,decode_mbps,"
+        << "encode_realtime,decode_realtime,peak_rss_kb,lossless\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << r.input << "," << r.preset << "," << r.info.channels << "," << r.info.sampleRate << ","
+            << r.info.bitsPerSample << "," << r.seconds << "," << r.ratio << "," << r.encodeMBps << ","
+            << r.decodeMBps << "," << r.encodeRealtime << "," << r.decodeRealtime << "," << r.peakRssKB << ","
+            << (r.lossless ? 1 : 0) << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> presets;
+    presets.push_back(0);
+    presets.push_back(3);
+    presets.push_back(5);
+    presets.push_back(7);
+    std::vector<std::string> synthetic = splitList("sine,multitone,noise,silence,speech");
+    std::vector<std::string> files;
+    double seconds = 10.0;
+    int numChannels = 2;
+    uint32_t sampleRate = 44100;
+    int runs = 5;
+    int warmup = 1;
+    std::string jsonPath, csvPath;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--presets" && hasValue) {
+            presets.clear();
+            std::vector<std::string> items = splitList(argv[++i]);
+            for (size_t k = 0; k < items.size(); k++) {
+                int level = std::atoi(items[k].c_str());
+                if (level < 0 || level > 8) {
+                    std::cerr << "Presets must be between 0 and 8" << std::endl;
+                    return 1;
+                }
+                presets.push_back(level);
+            }
+        } else if (arg == "--synthetic" && hasValue) {
+            std::string list = argv[++i];
+            synthetic = list == "none" ? std::vector<std::string>() :
+                        splitList(list == "all" ? "sine,multitone,noise,silence,speech" : list);
+        } else if (arg == "--seconds" && hasValue) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--channels" && hasValue) {
+            numChannels = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--rate" && hasValue) {
+            sampleRate = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--runs" && hasValue) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--csv" && hasValue) {
+            csvPath = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: audio_bench [--presets 0,3,5,7] [--synthetic LIST|all|none] [--seconds S]"
+                      << " [--channels N] [--rate HZ] [--runs N] [--warmup N] [--json PATH] [--csv PATH]"
+                      << " [file.wav ...]" << std::endl;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    
+    const std::string kinds = ",sine,multitone,noise,silence,speech,";
+    for (size_t i = 0; i < synthetic.size(); i++) {
+        if (kinds.find("," + synthetic[i] + ",") == std::string::npos) {
+            std::cerr << "Unknown synthetic signal: " << synthetic[i] << std::endl;
+            return 1;
+        }
+    }
+    
+    std::vector<BenchInput> corpus;
+    for (size_t i = 0; i < files.size(); i++) {
+        BenchInput input;
+        WAVFile wav;
+        if (!wav.readMultichannel(files[i], input.channels, input.info)) {
+            std::cerr << "Skipping unreadable file: " << files[i] << std::endl;
+            continue;
+        }
+        input.name = files[i];
+        corpus.push_back(input);
+    }
+    for (size_t i = 0; i < synthetic.size(); i++) {
+        corpus.push_back(generateSignal(synthetic[i], seconds, numChannels, sampleRate));
+    }
+    
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(24) << "input" << std::right << std::setw(7) << "preset"
+              << std::setw(9) << "ratio" << std::setw(11) << "enc MB/s" << std::setw(11) << "dec MB/s"
+              << std::setw(10) << "enc xRT" << std::setw(10) << "dec xRT" << std::setw(12) << "peak KB" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    int failures = 0;
+    for (size_t i = 0; i < corpus.size(); i++) {
+        for (size_t p = 0; p < presets.size(); p++) {
+            BenchResult r = runBenchmark(corpus[i], presets[p], runs, warmup);
+            results.push_back(r);
+            std::cout << std::left << std::setw(24) << r.input.substr(0, 23) << std::right << std::setw(7)
+                      << r.preset << std::setw(9) << r.ratio << std::setw(11) << r.encodeMBps << std::setw(11)
+                      << r.decodeMBps << std::setw(10) << r.encodeRealtime << std::setw(10) << r.decodeRealtime
+                      << std::setw(12) << r.peakRssKB << (r.lossless ? "" : "  NOT LOSSLESS") << std::endl;
+            if (!r.lossless) failures++;
+        }
+    }
+    
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath.c_str());
+        writeJSON(out, results, runs, warmup);
+    }
+    if (!csvPath.empty()) {
+        std::ofstream out(csvPath.c_str());
+        writeCSV(out, results);
+    }
+    return failures == 0 ? 0 : 2;
+}
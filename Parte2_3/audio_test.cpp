@@ -1,12 +1,48 @@
 #include "AudioCodec.h"
+#include "CodecProfile.h"
+#include "LowLatencyCodec.h"
 #include "WAVFile.h"
 #include "GolombCoding.h"
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
+#include <new>
+#include <sstream>
+#include <string>
+
+// Heap allocations made so far, for testAllocationFree. The replacement
+// operators are kept out of line so the compiler does not pair an inlined
+// free() with the original operator new.
+#if defined(__GNUC__)
+#define TEST_NOINLINE __attribute__((noinline))
+#else
+#define TEST_NOINLINE
+#endif
+static size_t allocationCount = 0;
+
+TEST_NOINLINE void* operator new(size_t size) {
+    allocationCount++;
+    void* p = std::malloc(size > 0 ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+TEST_NOINLINE void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+TEST_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+TEST_NOINLINE void operator delete[](void* p) noexcept {
+    std::free(p);
+}
 
 // Generate synthetic audio samples for testing
 std::vector<int16_t> generateSineWave(double frequency, double duration, uint32_t sampleRate, double amplitude = 16000.0) {
@@ -178,7 +214,1721 @@ void testStereoCompression() {
     }
 }
 
+// Test per-frame stereo decorrelation on correlated channels
+void testStereoDecorrelation() {
+    std::cout << "\n\n=== Testing Stereo Decorrelation Modes ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t sampleRate = 44100;
+    double duration = 1.0;
+    
+    // Right channel is the left channel slightly attenuated plus a quiet extra tone,
+    // as in a typical mix where most of the content is centered
+    std::cout << "\nGenerating correlated stereo audio..." << std::endl;
+    std::vector<int16_t> leftChannel = generateComplexWave(duration, sampleRate);
+    std::vector<int16_t> extra = generateSineWave(3000.0, duration, sampleRate, 200.0);
+    std::vector<int16_t> rightChannel(leftChannel.size());
+    for (size_t i = 0; i < leftChannel.size(); i++) {
+        rightChannel[i] = static_cast<int16_t>(leftChannel[i] * 0.95 + extra[i]);
+    }
+    
+    AudioInfo info;
+    info.sampleRate = sampleRate;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = leftChannel.size();
+    
+    AudioCodec codec(16, true);
+    
+    std::cout << "\n--- Independent Channels (L/R only) ---" << std::endl;
+    CompressedAudio independent = codec.encodeStereo(leftChannel, rightChannel, info, false);
+    codec.printStatistics(independent);
+    
+    std::cout << "\n--- Per-frame Stereo Mode Selection ---" << std::endl;
+    CompressedAudio decorrelated = codec.encodeStereo(leftChannel, rightChannel, info, true);
+    codec.printStatistics(decorrelated);
+    
+    std::cout << "\nBitrate reduction from stereo decorrelation: "
+              << std::fixed << std::setprecision(2)
+              << ((1.0 - static_cast<double>(decorrelated.compressedSize) / independent.compressedSize) * 100.0)
+              << "%" << std::endl;
+    
+    std::vector<int16_t> decodedLeft, decodedRight;
+    AudioInfo decodedInfo;
+    codec.decodeStereo(decorrelated, decodedLeft, decodedRight, decodedInfo);
+    
+    if (decodedLeft == leftChannel && decodedRight == rightChannel) {
+        std::cout << "✓ Lossless stereo decorrelation verified!" << std::endl;
+    } else {
+        std::cout << "✗ Stereo decorrelation is NOT lossless!" << std::endl;
+    }
+    
+    // Frame sizes must fit the 16-bit header field
+    int rejected = 0;
+    const int badSizes[] = {0, -1, 70000};
+    for (int i = 0; i < 3; i++) {
+        try {
+            codec.setBlockSize(badSizes[i]);
+        } catch (const std::invalid_argument&) {
+            rejected++;
+        }
+    }
+    if (rejected == 3 && codec.getBlockSize() == 4096) {
+        std::cout << "✓ Block sizes outside 1..65535 rejected" << std::endl;
+    } else {
+        std::cout << "✗ Invalid block size accepted" << std::endl;
+    }
+}
+
+// Test multichannel (5.1) compression and WAV I/O
+void testMultichannelCompression() {
+    std::cout << "\n\n=== Testing Multichannel (5.1) Compression ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t sampleRate = 48000;
+    double duration = 0.5;
+    
+    // FL FR FC LFE BL BR: fronts and surrounds are correlated pairs
+    std::cout << "\nGenerating 5.1 audio..." << std::endl;
+    std::vector<int16_t> music = generateComplexWave(duration, sampleRate);
+    std::vector<int16_t> voice = generateSineWave(220.0, duration, sampleRate, 6000.0);
+    std::vector<int16_t> bass = generateSineWave(60.0, duration, sampleRate, 12000.0);
+    std::vector<std::vector<int16_t> > channels(6, std::vector<int16_t>(music.size()));
+    for (size_t i = 0; i < music.size(); i++) {
+        channels[0][i] = music[i];
+        channels[1][i] = static_cast<int16_t>(music[i] * 0.9);
+        channels[2][i] = voice[i];
+        channels[3][i] = bass[i];
+        channels[4][i] = static_cast<int16_t>(music[i] * 0.5);
+        channels[5][i] = static_cast<int16_t>(music[i] * 0.45);
+    }
+    
+    AudioInfo info;
+    info.sampleRate = sampleRate;
+    info.channels = 6;
+    info.bitsPerSample = 16;
+    info.numSamples = music.size();
+    
+    AudioCodec codec(16, true);
+    
+    std::cout << "\n--- Independent Channels ---" << std::endl;
+    CompressedAudio independent = codec.encodeMultichannel(channels, info, std::vector<ChannelPair>());
+    codec.printStatistics(independent);
+    
+    std::cout << "\n--- Default 5.1 Channel Pairing ---" << std::endl;
+    CompressedAudio paired = codec.encodeMultichannel(channels, info);
+    codec.printStatistics(paired);
+    
+    std::cout << "\nBitrate reduction from channel pairing: "
+              << std::fixed << std::setprecision(2)
+              << ((1.0 - static_cast<double>(paired.compressedSize) / independent.compressedSize) * 100.0)
+              << "%" << std::endl;
+    
+    std::vector<std::vector<int16_t> > decoded;
+    AudioInfo decodedInfo;
+    codec.decodeMultichannel(paired, decoded, decodedInfo);
+    if (decoded == channels) {
+        std::cout << "✓ Lossless multichannel compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Multichannel compression is NOT lossless!" << std::endl;
+    }
+    
+    // Decode only the center channel, skipping the other substreams
+    codec.decodeMultichannel(paired, decoded, decodedInfo, 1ULL << 2);
+    if (decoded[2] == channels[2] && decoded[0].empty()) {
+        std::cout << "✓ Selective channel decoding verified!" << std::endl;
+    } else {
+        std::cout << "✗ Selective channel decoding failed!" << std::endl;
+    }
+    
+    // Multichannel WAV round trip
+    WAVFile wav;
+    std::vector<std::vector<int16_t> > readChannels;
+    AudioInfo readInfo;
+    if (wav.writeMultichannel("test_multichannel.wav", channels, info) &&
+        wav.readMultichannel("test_multichannel.wav", readChannels, readInfo) &&
+        readChannels == channels && readInfo.channels == 6) {
+        std::cout << "✓ Multichannel WAV I/O verified!" << std::endl;
+    } else {
+        std::cout << "✗ Multichannel WAV I/O failed!" << std::endl;
+    }
+}
+
+// Test 24-bit and 32-bit PCM through WAV I/O and the codec
+void testHighResolutionAudio() {
+    std::cout << "\n\n=== Testing 24-bit and 32-bit Audio ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t sampleRate = 96000;
+    uint32_t numSamples = 48001; // Not a multiple of any SIMD width
+    int bitDepths[] = {24, 32};
+    
+    for (int bits : bitDepths) {
+        std::cout << "\n--- " << bits << "-bit stereo ---" << std::endl;
+        
+        // Near full-scale tones with a little noise in the low bits
+        double fullScale = std::ldexp(1.0, bits - 1) - 1.0;
+        std::vector<int32_t> left(numSamples), right(numSamples);
+        std::srand(bits);
+        for (uint32_t i = 0; i < numSamples; i++) {
+            double t = static_cast<double>(i) / sampleRate;
+            double tone = std::sin(2.0 * M_PI * 1000.0 * t) * 0.6 + std::sin(2.0 * M_PI * 3100.0 * t) * 0.3;
+            left[i] = static_cast<int32_t>(fullScale * tone) + std::rand() % 64;
+            right[i] = static_cast<int32_t>(fullScale * tone * 0.8) - std::rand() % 64;
+        }
+        left[0] = static_cast<int32_t>(-fullScale) - 1; // Most negative value
+        right[0] = static_cast<int32_t>(fullScale);    // Most positive value
+        
+        AudioInfo info;
+        info.sampleRate = sampleRate;
+        info.channels = 2;
+        info.bitsPerSample = bits;
+        info.numSamples = numSamples;
+        
+        WAVFile wav;
+        std::string filename = "test_output_" + std::to_string(bits) + ".wav";
+        std::vector<int32_t> readLeft, readRight;
+        AudioInfo readInfo;
+        if (wav.writeStereo(filename, left, right, info) &&
+            wav.readStereo(filename, readLeft, readRight, readInfo) &&
+            readLeft == left && readRight == right && readInfo.bitsPerSample == bits) {
+            std::cout << "✓ " << bits << "-bit WAV I/O verified!" << std::endl;
+        } else {
+            std::cout << "✗ " << bits << "-bit WAV I/O failed!" << std::endl;
+        }
+        
+        AudioCodec codec(16, true);
+        CompressedAudio compressed = codec.encodeStereo(left, right, info);
+        codec.printStatistics(compressed);
+        
+        std::vector<int32_t> decodedLeft, decodedRight;
+        AudioInfo decodedInfo;
+        codec.decodeStereo(compressed, decodedLeft, decodedRight, decodedInfo);
+        if (decodedLeft == left && decodedRight == right) {
+            std::cout << "✓ Lossless " << bits << "-bit compression verified!" << std::endl;
+        } else {
+            std::cout << "✗ " << bits << "-bit compression is NOT lossless!" << std::endl;
+        }
+    }
+}
+
 // Test with complex waveforms
+void testFrameTypes() {
+    std::cout << "\n\n=== Testing Constant, Verbatim and Wasted-Bits Frames ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 44100;
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    // Digital silence, white noise and 8-bit audio padded to 16 bits
+    std::vector<int32_t> silence(numSamples, 0);
+    std::vector<int32_t> noise(numSamples), padded(numSamples);
+    std::srand(29);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        noise[i] = std::rand() % 65536 - 32768;
+        padded[i] = static_cast<int32_t>(std::sin(2.0 * M_PI * 440.0 * i / 44100.0) * 127.0) * 256;
+    }
+    
+    const char* names[] = {"Silence", "White noise", "Wasted bits"};
+    std::vector<int32_t>* signals[] = {&silence, &noise, &padded};
+    AudioCodec codec(16, true);
+    
+    for (int s = 0; s < 3; s++) {
+        std::cout << "\n--- " << names[s] << " ---" << std::endl;
+        CompressedAudio compressed = codec.encode(*signals[s], info);
+        codec.printStatistics(compressed);
+        
+        std::vector<int32_t> decoded;
+        AudioInfo decodedInfo;
+        codec.decode(compressed, decoded, decodedInfo);
+        if (decoded == *signals[s]) {
+            std::cout << "✓ Lossless compression verified!" << std::endl;
+        } else {
+            std::cout << "✗ Compression is NOT lossless!" << std::endl;
+        }
+    }
+    
+    // Incompressible input may only grow by the stream and frame headers
+    CompressedAudio noiseCompressed = codec.encode(noise, info);
+    size_t frames = (numSamples + codec.getBlockSize() - 1) / codec.getBlockSize();
+    if (noiseCompressed.compressedSize <= noiseCompressed.originalSize + 129 + frames * 16) {
+        std::cout << "\n✓ White noise expansion bounded" << std::endl;
+    } else {
+        std::cout << "\n✗ White noise expanded beyond raw PCM" << std::endl;
+    }
+    
+    CompressedAudio silenceCompressed = codec.encode(silence, info);
+    if (silenceCompressed.subframeTypeCount[SUBFRAME_CONSTANT] == frames &&
+        silenceCompressed.compressedSize < 1000) {
+        std::cout << "✓ Silence coded as constant frames" << std::endl;
+    } else {
+        std::cout << "✗ Silence not coded as constant frames" << std::endl;
+    }
+}
+
+void testSilenceRuns() {
+    std::cout << "\n\n=== Testing Run Mode on Audio with Silent Gaps ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Speech-like bursts separated by digital silence that starts and ends mid-frame
+    uint32_t numSamples = 44100 * 2;
+    std::vector<int32_t> samples(numSamples, 0);
+    std::srand(30);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        if ((i / 3000) % 3 == 0) {
+            double t = static_cast<double>(i) / 44100.0;
+            samples[i] = static_cast<int32_t>(std::sin(2.0 * M_PI * 220.0 * t) * 6000.0) + std::rand() % 9 - 4;
+        }
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    CompressedAudio compressed = codec.encode(samples, info);
+    codec.printStatistics(compressed);
+    std::cout << "Coded bits per sample: " << static_cast<double>(compressed.compressedSize) / numSamples << std::endl;
+    
+    std::vector<int32_t> decoded;
+    AudioInfo decodedInfo;
+    codec.decode(compressed, decoded, decodedInfo);
+    if (decoded == samples) {
+        std::cout << "✓ Lossless compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Compression is NOT lossless!" << std::endl;
+    }
+    
+    if (compressed.subframeTypeCount[SUBFRAME_RUN] > 0) {
+        std::cout << "✓ Run mode used for frames with silent gaps" << std::endl;
+    } else {
+        std::cout << "✗ Run mode not used for frames with silent gaps" << std::endl;
+    }
+}
+
+void testExtraHighMode() {
+    std::cout << "\n\n=== Testing Extra High Mode (NLMS Cascade) ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Sweeping tone with a slow tremolo: the fixed predictor leaves a lot of
+    // structure that the adaptive filters can learn
+    uint32_t numSamples = 44100 * 2;
+    std::vector<int32_t> samples(numSamples);
+    std::srand(31);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double t = static_cast<double>(i) / 44100.0;
+        double tone = std::sin(2.0 * M_PI * (300.0 + 200.0 * std::sin(t)) * t) * (0.5 + 0.5 * std::sin(3.0 * t));
+        samples[i] = static_cast<int32_t>(tone * 10000.0) + std::rand() % 5 - 2;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    CompressedAudio normal = codec.encode(samples, info);
+    
+    codec.setExtraHighMode(true);
+    auto start = std::clock();
+    CompressedAudio extraHigh = codec.encode(samples, info);
+    auto encodeTime = std::clock() - start;
+    codec.printStatistics(extraHigh);
+    std::cout << "Encoding time: " << (1000.0 * encodeTime / CLOCKS_PER_SEC) << " ms" << std::endl;
+    
+    std::vector<int32_t> decoded;
+    AudioInfo decodedInfo;
+    start = std::clock();
+    codec.decode(extraHigh, decoded, decodedInfo);
+    auto decodeTime = std::clock() - start;
+    std::cout << "Decoding time: " << (1000.0 * decodeTime / CLOCKS_PER_SEC) << " ms" << std::endl;
+    
+    if (decoded == samples) {
+        std::cout << "✓ Lossless compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Compression is NOT lossless!" << std::endl;
+    }
+    
+    double reduction = 100.0 * (1.0 - static_cast<double>(extraHigh.compressedSize) / normal.compressedSize);
+    std::cout << "Size reduction over the fixed predictor: " << reduction << "%" << std::endl;
+    if (extraHigh.compressedSize < normal.compressedSize) {
+        std::cout << "✓ Extra high mode improves compression" << std::endl;
+    } else {
+        std::cout << "✗ Extra high mode does not improve compression" << std::endl;
+    }
+}
+
+void testEncoderPresets() {
+    std::cout << "\n\n=== Testing Encoder Presets (-0 ... -8) ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Harmonic tones over a resonant noise floor, correlated between channels
+    uint32_t numSamples = 44100;
+    std::vector<int32_t> left(numSamples), right(numSamples);
+    std::srand(32);
+    double resonance[2] = {0.0, 0.0};
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double t = static_cast<double>(i) / 44100.0;
+        double noise = (std::rand() / static_cast<double>(RAND_MAX) - 0.5) * 0.02;
+        double floor = 1.6 * resonance[0] - 0.9 * resonance[1] + noise;
+        resonance[1] = resonance[0];
+        resonance[0] = floor;
+        double tone = 0.3 * std::sin(2.0 * M_PI * 220.0 * t) + 0.15 * std::sin(2.0 * M_PI * 440.0 * t + 0.3) +
+                      0.08 * std::sin(2.0 * M_PI * 660.0 * t) + floor;
+        left[i] = static_cast<int32_t>(tone * 12000.0);
+        right[i] = static_cast<int32_t>((0.8 * tone + 0.1 * std::sin(2.0 * M_PI * 330.0 * t)) * 12000.0);
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Preset | Ratio | Encode (ms) | Decode (ms)" << std::endl;
+    
+    bool allLossless = true;
+    double fastestRatio = 0.0, smallestRatio = 0.0;
+    for (int level = 0; level <= 8; level++) {
+        AudioCodec codec;
+        codec.setPreset(level);
+        
+        auto start = std::clock();
+        CompressedAudio compressed = codec.encodeStereo(left, right, info);
+        auto encodeTime = std::clock() - start;
+        
+        std::vector<int32_t> decodedLeft, decodedRight;
+        AudioInfo decodedInfo;
+        start = std::clock();
+        codec.decodeStereo(compressed, decodedLeft, decodedRight, decodedInfo);
+        auto decodeTime = std::clock() - start;
+        
+        allLossless = allLossless && decodedLeft == left && decodedRight == right;
+        if (level == 0) fastestRatio = compressed.compressionRatio;
+        if (level == 8) smallestRatio = compressed.compressionRatio;
+        
+        std::cout << "    -" << level << " | " << compressed.compressionRatio << " | "
+                  << (1000.0 * encodeTime / CLOCKS_PER_SEC) << " | "
+                  << (1000.0 * decodeTime / CLOCKS_PER_SEC) << std::endl;
+    }
+    std::cout << std::setprecision(2);
+    
+    if (allLossless) {
+        std::cout << "✓ Lossless compression verified for every preset!" << std::endl;
+    } else {
+        std::cout << "✗ A preset is NOT lossless!" << std::endl;
+    }
+    
+    if (smallestRatio > fastestRatio) {
+        std::cout << "✓ Higher presets compress better" << std::endl;
+    } else {
+        std::cout << "✗ Higher presets do not compress better" << std::endl;
+    }
+}
+
+void testPartitionedParameters() {
+    std::cout << "\n\n=== Testing Partitioned Golomb Parameters ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Percussive hits: loud attacks decaying into near silence within each frame
+    uint32_t numSamples = 44100 * 2;
+    std::vector<int32_t> samples(numSamples);
+    std::srand(33);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double sinceHit = static_cast<double>(i % 5000) / 44100.0;
+        double envelope = std::exp(-sinceHit * 60.0);
+        double noise = std::rand() / static_cast<double>(RAND_MAX) - 0.5;
+        samples[i] = static_cast<int32_t>(envelope * (20000.0 * noise + 8000.0 * std::sin(i * 0.3))) +
+                     std::rand() % 3 - 1;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    codec.setMaxPartitionOrder(0);
+    CompressedAudio single = codec.encode(samples, info);
+    
+    codec.setMaxPartitionOrder(6);
+    CompressedAudio partitioned = codec.encode(samples, info);
+    codec.printStatistics(partitioned);
+    
+    std::vector<int32_t> decoded;
+    AudioInfo decodedInfo;
+    codec.decode(partitioned, decoded, decodedInfo);
+    if (decoded == samples) {
+        std::cout << "✓ Lossless compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Compression is NOT lossless!" << std::endl;
+    }
+    
+    double reduction = 100.0 * (1.0 - static_cast<double>(partitioned.compressedSize) / single.compressedSize);
+    std::cout << "Size reduction over one parameter per frame: " << reduction << "%" << std::endl;
+    if (partitioned.compressedSize < single.compressedSize) {
+        std::cout << "✓ Partitioning improves compression of transients" << std::endl;
+    } else {
+        std::cout << "✗ Partitioning does not improve compression of transients" << std::endl;
+    }
+}
+
+void testPitchPrediction() {
+    std::cout << "\n\n=== Testing Long-Term (Pitch) Prediction ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // A bowed-string-like tone: one noisy period of 317 samples repeated with
+    // a little jitter, which short-term prediction alone cannot model
+    uint32_t numSamples = 44100 * 2;
+    const uint32_t period = 317;
+    std::vector<int32_t> cycle(period);
+    std::srand(34);
+    for (uint32_t i = 0; i < period; i++) {
+        cycle[i] = std::rand() % 12001 - 6000;
+    }
+    std::vector<int32_t> samples(numSamples);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        samples[i] = cycle[i % period] + std::rand() % 41 - 20;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    codec.setPreset(5);
+    CompressedAudio shortTerm = codec.encode(samples, info);
+    
+    codec.setLongTermPrediction(true);
+    CompressedAudio longTerm = codec.encode(samples, info);
+    codec.printStatistics(longTerm);
+    
+    std::vector<int32_t> decoded;
+    AudioInfo decodedInfo;
+    codec.decode(longTerm, decoded, decodedInfo);
+    if (decoded == samples) {
+        std::cout << "✓ Lossless compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Compression is NOT lossless!" << std::endl;
+    }
+    
+    double reduction = 100.0 * (1.0 - static_cast<double>(longTerm.compressedSize) / shortTerm.compressedSize);
+    std::cout << "Size reduction over short-term prediction only: " << reduction << "%" << std::endl;
+    if (longTerm.compressedSize < shortTerm.compressedSize) {
+        std::cout << "✓ Long-term prediction improves compression of periodic audio" << std::endl;
+    } else {
+        std::cout << "✗ Long-term prediction does not improve compression of periodic audio" << std::endl;
+    }
+}
+
+void testCrossChannelPrediction() {
+    std::cout << "\n\n=== Testing Cross-Channel Prediction ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Spaced microphones: the right channel hears the source 3 samples later,
+    // slightly filtered, plus its own room noise, so neither M/S nor L/S fit
+    uint32_t numSamples = 44100 * 2;
+    std::vector<double> source(numSamples + 3);
+    std::srand(35);
+    double noise = 0.0;
+    for (uint32_t i = 0; i < source.size(); i++) {
+        noise = 0.95 * noise + 3000.0 * (std::rand() / static_cast<double>(RAND_MAX) - 0.5);
+        source[i] = noise + 4000.0 * std::sin(i * 0.031) + 2000.0 * std::sin(i * 0.117);
+    }
+    std::vector<int32_t> left(numSamples), right(numSamples);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        left[i] = static_cast<int32_t>(source[i + 3]);
+        right[i] = static_cast<int32_t>(0.6 * source[i] + 0.25 * source[i + 1]) + std::rand() % 61 - 30;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    codec.setPreset(5);
+    CompressedAudio frameLevel = codec.encodeStereo(left, right, info);
+    
+    codec.setCrossChannelPrediction(true);
+    CompressedAudio cross = codec.encodeStereo(left, right, info);
+    codec.printStatistics(cross);
+    
+    std::vector<int32_t> decodedLeft, decodedRight;
+    AudioInfo decodedInfo;
+    codec.decodeStereo(cross, decodedLeft, decodedRight, decodedInfo);
+    if (decodedLeft == left && decodedRight == right) {
+        std::cout << "✓ Lossless compression verified!" << std::endl;
+    } else {
+        std::cout << "✗ Compression is NOT lossless!" << std::endl;
+    }
+    
+    double reduction = 100.0 * (1.0 - static_cast<double>(cross.compressedSize) / frameLevel.compressedSize);
+    std::cout << "Size reduction over frame-level stereo modes: " << reduction << "%" << std::endl;
+    if (cross.compressedSize < frameLevel.compressedSize) {
+        std::cout << "✓ Cross-channel prediction improves compression of spaced microphones" << std::endl;
+    } else {
+        std::cout << "✗ Cross-channel prediction does not improve compression of spaced microphones" << std::endl;
+    }
+}
+
+void testNearLossless() {
+    std::cout << "\n\n=== Testing Near-Lossless Mode ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 44100 * 2;
+    std::vector<int32_t> samples(numSamples);
+    std::srand(36);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        samples[i] = static_cast<int32_t>(12000.0 * std::sin(i * 0.02) + 5000.0 * std::sin(i * 0.13)) +
+                     std::rand() % 401 - 200;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 1;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    size_t previousSize = codec.encode(samples, info).compressedSize;
+    std::cout << "Lossless: " << previousSize << " bits" << std::endl;
+    
+    const int deltas[] = {1, 2, 4, 8};
+    for (int d = 0; d < 4; d++) {
+        codec.setNearLossless(deltas[d]);
+        CompressedAudio compressed = codec.encode(samples, info);
+        
+        std::vector<int32_t> decoded;
+        AudioInfo decodedInfo;
+        codec.decode(compressed, decoded, decodedInfo);
+        long maxError = decoded.size() == samples.size() ? 0 : -1;
+        for (size_t i = 0; i < decoded.size() && i < samples.size(); i++) {
+            maxError = std::max(maxError, std::labs(static_cast<long>(decoded[i]) - samples[i]));
+        }
+        
+        std::cout << "delta " << deltas[d] << ": " << compressed.compressedSize << " bits, ratio "
+                  << compressed.compressionRatio << ":1, max error " << maxError << std::endl;
+        if (maxError >= 0 && maxError <= deltas[d] && compressed.compressedSize < previousSize) {
+            std::cout << "✓ Error within +/- " << deltas[d] << " and smaller than the previous setting" << std::endl;
+        } else {
+            std::cout << "✗ Error bound or size check failed for delta " << deltas[d] << std::endl;
+        }
+        previousSize = compressed.compressedSize;
+    }
+    
+    // 8-bit audio near full scale stays in range, both at its own depth and
+    // scaled to 16 bits as the int16_t WAV API does
+    info.bitsPerSample = 8;
+    std::vector<int32_t> loud(numSamples);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        loud[i] = std::max(-128, std::min(127, static_cast<int>(140.0 * std::sin(i * 0.05)) + std::rand() % 7 - 3));
+    }
+    codec.setNearLossless(4);
+    bool inRange = true;
+    for (int scale = 1; scale <= 256; scale *= 256) {
+        std::vector<int32_t> scaled(loud);
+        for (size_t i = 0; i < scaled.size(); i++) {
+            scaled[i] *= scale;
+        }
+        std::vector<int32_t> decoded;
+        AudioInfo decodedInfo;
+        codec.decode(codec.encode(scaled, info), decoded, decodedInfo);
+        long maxValue = 128L * scale - 1;
+        inRange = inRange && decoded.size() == scaled.size();
+        for (size_t i = 0; inRange && i < decoded.size(); i++) {
+            inRange = decoded[i] >= -maxValue - 1 && decoded[i] <= maxValue &&
+                      std::labs(static_cast<long>(decoded[i]) - scaled[i]) <= 4;
+        }
+    }
+    std::cout << (inRange ? "✓ 8-bit samples near full scale stay within range and +/- 4"
+                          : "✗ 8-bit samples left their range or the error bound") << std::endl;
+}
+
+void testLossyMode() {
+    std::cout << "\n\n=== Testing Lossy Transform Mode ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Four chords of harmonic tones with a slow tremolo and some noise
+    uint32_t sampleRate = 44100;
+    uint32_t numSamples = sampleRate * 4;
+    const double roots[] = {220.0, 277.2, 329.6, 440.0};
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::srand(37);
+    double noise = 0.0;
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double t = static_cast<double>(i) / sampleRate;
+        double tone = 0.0;
+        for (int harmonic = 1; harmonic <= 8; harmonic++) {
+            for (int k = 0; k < 4; k++) {
+                double level = k == static_cast<int>(t * 2) % 4 ? 2700.0 : 1080.0;
+                tone += std::sin(2.0 * M_PI * roots[k] * harmonic * t) * level / (harmonic * harmonic);
+            }
+        }
+        tone *= 0.5 + 0.5 * std::sin(t * 3.0);
+        noise = 0.9 * noise + 300.0 * (std::rand() / static_cast<double>(RAND_MAX) - 0.5);
+        channels[0][i] = static_cast<int32_t>(tone + noise);
+        channels[1][i] = static_cast<int32_t>(0.8 * tone - 0.5 * noise);
+    }
+    
+    AudioInfo info;
+    info.sampleRate = sampleRate;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec;
+    codec.setPreset(5);
+    size_t losslessSize = codec.encodeMultichannel(channels, info).compressedSize;
+    double duration = static_cast<double>(numSamples) / sampleRate;
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Quality | kbit/s | vs lossless | SNR (dB) | Encode (x realtime) | Decode (x realtime)" << std::endl;
+    
+    const int qualities[] = {20, 50, 80};
+    double snr[3];
+    size_t sizes[3];
+    for (int q = 0; q < 3; q++) {
+        codec.setLossyQuality(qualities[q]);
+        
+        auto start = std::clock();
+        CompressedAudio compressed = codec.encodeLossy(channels, info);
+        auto encodeTime = std::clock() - start;
+        
+        std::vector<std::vector<int32_t> > decoded;
+        AudioInfo decodedInfo;
+        start = std::clock();
+        codec.decodeLossy(compressed, decoded, decodedInfo);
+        auto decodeTime = std::clock() - start;
+        
+        double signal = 0.0, error = 0.0;
+        for (size_t c = 0; c < channels.size() && c < decoded.size(); c++) {
+            for (size_t i = 0; i < numSamples && i < decoded[c].size(); i++) {
+                double e = static_cast<double>(decoded[c][i]) - channels[c][i];
+                signal += static_cast<double>(channels[c][i]) * channels[c][i];
+                error += e * e;
+            }
+        }
+        snr[q] = 10.0 * std::log10(signal / std::max(error, 1.0));
+        sizes[q] = compressed.compressedSize;
+        
+        std::cout << "    " << qualities[q] << " | " << compressed.compressedSize / duration / 1000.0 << " | "
+                  << static_cast<double>(losslessSize) / compressed.compressedSize << "x smaller | "
+                  << snr[q] << " | "
+                  << duration / std::max(static_cast<double>(encodeTime) / CLOCKS_PER_SEC, 1e-6) << " | "
+                  << duration / std::max(static_cast<double>(decodeTime) / CLOCKS_PER_SEC, 1e-6) << std::endl;
+    }
+    
+    if (snr[0] < snr[1] && snr[1] < snr[2] && sizes[0] < sizes[1] && sizes[1] < sizes[2]) {
+        std::cout << "✓ Higher quality gives higher SNR and larger streams" << std::endl;
+    } else {
+        std::cout << "✗ Quality does not trade size for SNR" << std::endl;
+    }
+    if (sizes[1] * 8 < losslessSize && snr[1] > 15.0) {
+        std::cout << "✓ Default quality is several times smaller than lossless" << std::endl;
+    } else {
+        std::cout << "✗ Default quality is not much smaller than lossless" << std::endl;
+    }
+    
+    // The header marks lossy streams, and a corrupt block size is rejected
+    CompressedAudio lossy = codec.encodeLossy(channels, info);
+    CompressedAudio lossless = codec.encodeMultichannel(channels, info);
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    int rejected = 0;
+    try {
+        codec.decodeLossy(lossless, decoded, decodedInfo);
+    } catch (const std::invalid_argument&) {
+        rejected++;
+    }
+    try {
+        codec.decodeMultichannel(lossy, decoded, decodedInfo);
+    } catch (const std::invalid_argument&) {
+        rejected++;
+    }
+    const size_t blockSizeField = 148; // Bits of the stream header before it
+    for (int i = 0; i < 16; i++) {
+        lossy.data[blockSizeField + i] = ((64 >> (15 - i)) & 1) != 0;
+    }
+    try {
+        codec.decodeLossy(lossy, decoded, decodedInfo);
+    } catch (const std::invalid_argument&) {
+        rejected++;
+    }
+    std::cout << (rejected == 3 ? "✓ Wrong stream modes and block sizes rejected"
+                                : "✗ Wrong stream mode or block size accepted") << std::endl;
+    
+    // Channels of different lengths are cut to the shortest one
+    std::vector<std::vector<int32_t> > uneven(channels);
+    uneven[1].resize(numSamples / 3);
+    CompressedAudio shortened = codec.encodeLossy(uneven, info);
+    codec.decodeLossy(shortened, decoded, decodedInfo);
+    if (decodedInfo.numSamples == uneven[1].size() && decoded.size() == 2 && decoded[1].size() == uneven[1].size()) {
+        std::cout << "✓ Uneven channels encoded up to the shortest one" << std::endl;
+    } else {
+        std::cout << "✗ Uneven channels not cut to the shortest one" << std::endl;
+    }
+}
+
+void testRateControl() {
+    std::cout << "\n\n=== Testing Constant-Bitrate Rate Control ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Quiet tonal passages alternating with loud noisy ones every 1.5 s
+    uint32_t sampleRate = 44100;
+    uint32_t numSamples = sampleRate * 6;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::srand(38);
+    double noise = 0.0;
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double t = static_cast<double>(i) / sampleRate;
+        bool loud = static_cast<int>(t / 1.5) % 2 == 1;
+        double tone = 0.0;
+        for (int harmonic = 1; harmonic <= 6; harmonic++) {
+            tone += std::sin(2.0 * M_PI * 220.0 * harmonic * t) * 3000.0 / harmonic;
+        }
+        tone *= loud ? 1.0 : 0.2;
+        noise = 0.5 * noise + (loud ? 12000.0 : 200.0) * (std::rand() / static_cast<double>(RAND_MAX) - 0.5);
+        channels[0][i] = static_cast<int32_t>(tone + noise);
+        channels[1][i] = static_cast<int32_t>(0.7 * tone - 0.6 * noise);
+    }
+    
+    AudioInfo info;
+    info.sampleRate = sampleRate;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec;
+    codec.setLossyQuality(100);
+    codec.setTargetBitrate(64.0, 0.5);
+    CompressedAudio compressed = codec.encodeLossy(channels, info);
+    codec.printStatistics(compressed);
+    
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    codec.decodeLossy(compressed, decoded, decodedInfo);
+    if (decoded.size() == 2 && decoded[0].size() == numSamples && decoded[1].size() == numSamples) {
+        std::cout << "✓ Rate-controlled stream decodes to full length" << std::endl;
+    } else {
+        std::cout << "✗ Rate-controlled stream does not decode to full length" << std::endl;
+    }
+    
+    const RateControlStats& rate = compressed.rateControl;
+    if (rate.overflowBlocks == 0 && rate.maxBuffer <= rate.bufferSize &&
+        std::fabs(rate.achievedBitrate - rate.targetBitrate) < 0.02 * rate.targetBitrate &&
+        rate.minQuality < rate.maxQuality) {
+        std::cout << "✓ Bitrate held within 2% of the target without buffer overflow" << std::endl;
+    } else {
+        std::cout << "✗ Rate control missed the target or overflowed its buffer" << std::endl;
+    }
+}
+
+void testHybridMode() {
+    std::cout << "\n\n=== Testing Hybrid Mode (Main + Correction) ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 44100 * 2;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::srand(39);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double tone = 12000.0 * std::sin(i * 0.02) + 5000.0 * std::sin(i * 0.13);
+        channels[0][i] = static_cast<int32_t>(tone) + std::rand() % 401 - 200;
+        channels[1][i] = static_cast<int32_t>(0.7 * tone) + std::rand() % 401 - 200;
+    }
+    // A silent stretch, exact in the main stream
+    for (uint32_t i = 0; i < 8192; i++) {
+        channels[0][i] = channels[1][i] = 0;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true);
+    size_t losslessSize = codec.encodeMultichannel(channels, info).compressedSize;
+    
+    int delta = 4;
+    CompressedAudio correction;
+    CompressedAudio compressed = codec.encodeHybrid(channels, info, delta, correction);
+    std::cout << "Lossless: " << losslessSize << " bits, main: " << compressed.compressedSize
+              << " bits, correction: " << correction.compressedSize << " bits" << std::endl;
+    
+    // Main stream alone, through the ordinary decoder
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    codec.decodeMultichannel(compressed, decoded, decodedInfo);
+    long maxError = decoded.size() == 2 && decoded[0].size() == numSamples ? 0 : -1;
+    for (size_t c = 0; c < decoded.size() && maxError >= 0; c++) {
+        for (size_t i = 0; i < numSamples; i++) {
+            maxError = std::max(maxError, std::labs(static_cast<long>(decoded[c][i]) - channels[c][i]));
+        }
+    }
+    if (maxError >= 0 && maxError <= delta && compressed.compressedSize < losslessSize) {
+        std::cout << "✓ Main stream alone within +/- " << delta << " (max error " << maxError << ")" << std::endl;
+    } else {
+        std::cout << "✗ Main stream error " << maxError << " or size check failed" << std::endl;
+    }
+    
+    codec.decodeHybrid(compressed, correction, decoded, decodedInfo);
+    size_t total = compressed.compressedSize + correction.compressedSize;
+    if (decoded == channels && total < losslessSize * 11 / 10) {
+        std::cout << "✓ Main + correction is lossless, " << 100.0 * total / losslessSize - 100.0
+                  << "% over a lossless stream" << std::endl;
+    } else {
+        std::cout << "✗ Main + correction did not reconstruct the original compactly" << std::endl;
+    }
+    
+    // A correction stream from another encode is rejected
+    CompressedAudio otherCorrection;
+    codec.encodeHybrid(channels, info, 2, otherCorrection);
+    try {
+        codec.decodeHybrid(compressed, otherCorrection, decoded, decodedInfo);
+        std::cout << "✗ Mismatched correction stream accepted" << std::endl;
+    } catch (const std::invalid_argument&) {
+        std::cout << "✓ Mismatched correction stream rejected" << std::endl;
+    }
+    
+    // So is a main stream of the same length with different contents
+    CompressedAudio altered = compressed;
+    altered.data[altered.data.size() / 2].flip();
+    try {
+        codec.decodeHybrid(altered, correction, decoded, decodedInfo);
+        std::cout << "✗ Correction applied to an altered main stream" << std::endl;
+    } catch (const std::invalid_argument&) {
+        std::cout << "✓ Altered main stream of the same length rejected" << std::endl;
+    }
+}
+
+void testLowLatencyProfile() {
+    std::cout << "\n\n=== Testing Low-Latency Streaming Profile ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 44100 * 2;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::vector<int32_t> interleaved(numSamples * 2);
+    std::srand(40);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double tone = 9000.0 * std::sin(i * 0.031) + 4000.0 * std::sin(i * 0.0047);
+        channels[0][i] = static_cast<int32_t>(tone) + std::rand() % 201 - 100;
+        channels[1][i] = static_cast<int32_t>(0.9 * tone) + std::rand() % 201 - 100;
+        interleaved[2 * i] = channels[0][i];
+        interleaved[2 * i + 1] = channels[1][i];
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec batch;
+    size_t batchSize = batch.encodeMultichannel(channels, info).compressedSize;
+    
+    LowLatencyCodec encoder(info, 128);
+    LowLatencyCodec decoder(info, 128);
+    std::vector<int32_t> decoded(interleaved.size());
+    std::vector<bool> packet;
+    size_t streamSize = 0;
+    for (size_t start = 0; start < numSamples; start += 128) {
+        size_t frames = std::min<size_t>(128, numSamples - start);
+        encoder.encodeFrame(interleaved.data() + 2 * start, frames, packet);
+        decoder.decodeFrame(packet, decoded.data() + 2 * start, frames);
+        streamSize += packet.size();
+    }
+    std::cout << "Batch: " << batchSize << " bits, streamed: " << streamSize << " bits" << std::endl;
+    if (decoded == interleaved && streamSize < batchSize * 115 / 100) {
+        std::cout << "✓ 128-sample frames decode losslessly within 15% of the batch size" << std::endl;
+    } else {
+        std::cout << "✗ Low-latency stream mismatch or too large" << std::endl;
+    }
+    
+    // Timing depends on the machine, so only the frame delay is held to 5 ms
+    LatencyStats encodeStats = encoder.getEncodeLatency();
+    LatencyStats decodeStats = decoder.getDecodeLatency();
+    std::cout << "Encode (us): p50 " << encodeStats.p50 << ", p99 " << encodeStats.p99 << ", p99.9 "
+              << encodeStats.p999 << std::endl;
+    std::cout << "Decode (us): p50 " << decodeStats.p50 << ", p99 " << decodeStats.p99 << ", p99.9 "
+              << decodeStats.p999 << std::endl;
+    double total = encoder.getFrameDuration() + (encodeStats.p99 + decodeStats.p99) / 1000.0;
+    if (encodeStats.frames == (numSamples + 127) / 128 && decodeStats.frames == encodeStats.frames &&
+        encodeStats.p50 <= encodeStats.p99 && encodeStats.p99 <= encodeStats.p999 &&
+        encodeStats.p999 <= encodeStats.max && encoder.getFrameDuration() < 5.0) {
+        std::cout << "✓ " << encoder.getFrameDuration() << " ms frames, " << total
+                  << " ms with p99 encode and decode" << std::endl;
+    } else {
+        std::cout << "✗ Latency statistics inconsistent" << std::endl;
+    }
+    
+    // A live stream keeps timing every call without allocating
+    size_t before = allocationCount;
+    for (size_t start = 0; start < numSamples; start += 128) {
+        size_t frames = std::min<size_t>(128, numSamples - start);
+        encoder.encodeFrame(interleaved.data() + 2 * start, frames, packet);
+        decoder.decodeFrame(packet, decoded.data() + 2 * start, frames);
+    }
+    size_t allocations = allocationCount - before;
+    if (allocations == 0 && decoded == interleaved && decoder.getDecodeLatency().frames == 2 * encodeStats.frames) {
+        std::cout << "✓ Second pass timed with no allocations" << std::endl;
+    } else {
+        std::cout << "✗ Second pass made " << allocations << " allocations" << std::endl;
+    }
+    
+    try {
+        LowLatencyCodec tooLong(info, 1024);
+        std::cout << "✗ 1024-sample low-latency frames accepted" << std::endl;
+    } catch (const std::invalid_argument&) {
+        std::cout << "✓ Frame size outside 64..256 rejected" << std::endl;
+    }
+}
+
+void testResyncFrames() {
+    std::cout << "\n\n=== Testing Resynchronizable Frames ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 4096 * 10;
+    std::vector<int32_t> left(numSamples), right(numSamples);
+    std::srand(41);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double tone = 8000.0 * std::sin(i * 0.01) + 3000.0 * std::sin(i * 0.07);
+        left[i] = static_cast<int32_t>(tone) + std::rand() % 101 - 50;
+        right[i] = static_cast<int32_t>(0.8 * tone) + std::rand() % 101 - 50;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    info.numSamples = numSamples;
+    
+    AudioCodec codec(16, true, 4096);
+    size_t plainSize = codec.encodeStereo(left, right, info).compressedSize;
+    codec.setResyncFrames(true);
+    CompressedAudio compressed = codec.encodeStereo(left, right, info);
+    std::cout << "Without sync codes: " << plainSize << " bits, with: " << compressed.compressedSize
+              << " bits" << std::endl;
+    
+    std::vector<int32_t> decodedLeft, decodedRight;
+    AudioInfo decodedInfo;
+    codec.decodeStereo(compressed, decodedLeft, decodedRight, decodedInfo);
+    if (decodedLeft == left && decodedRight == right && codec.getLostFrames() == 0 &&
+        compressed.compressedSize - plainSize < 10 * 16 * 8) {
+        std::cout << "✓ Intact stream decodes losslessly, under 16 bytes per frame of overhead" << std::endl;
+    } else {
+        std::cout << "✗ Intact stream with sync codes failed" << std::endl;
+    }
+    
+    // Flip bits in the middle of the stream: only the frames they hit are lost
+    CompressedAudio damaged = compressed;
+    size_t middle = damaged.data.size() / 2;
+    for (size_t i = middle; i < middle + 64; i += 7) {
+        damaged.data[i] = !damaged.data[i];
+    }
+    codec.decodeStereo(damaged, decodedLeft, decodedRight, decodedInfo);
+    size_t intactFrames = 0;
+    for (size_t start = 0; start < numSamples && decodedLeft.size() == numSamples; start += 4096) {
+        if (std::equal(left.begin() + start, left.begin() + start + 4096, decodedLeft.begin() + start) &&
+            std::equal(right.begin() + start, right.begin() + start + 4096, decodedRight.begin() + start)) {
+            intactFrames++;
+        }
+    }
+    std::cout << "Damaged stream: " << codec.getLostFrames() << " frame(s) lost, " << intactFrames
+              << " of 10 intact" << std::endl;
+    if (codec.getLostFrames() == 1 && intactFrames == 9) {
+        std::cout << "✓ Decoder resynchronized after the damaged frame" << std::endl;
+    } else {
+        std::cout << "✗ Damage spread beyond one frame" << std::endl;
+    }
+    
+    // Multichannel stream with a chunk missing from the middle
+    std::vector<std::vector<int32_t> > channels(2);
+    channels[0] = left;
+    channels[1] = right;
+    CompressedAudio multichannel = codec.encodeMultichannel(channels, info);
+    size_t cut = multichannel.data.size() / 3;
+    multichannel.data.erase(multichannel.data.begin() + cut, multichannel.data.begin() + cut + 1000);
+    std::vector<std::vector<int32_t> > decoded;
+    codec.decodeMultichannel(multichannel, decoded, decodedInfo);
+    bool tailIntact = decoded.size() == 2 && decoded[0].size() == numSamples &&
+                      std::equal(left.end() - 4096 * 5, left.end(), decoded[0].end() - 4096 * 5);
+    if (tailIntact && codec.getLostFrames() >= 1 && codec.getLostFrames() <= 2) {
+        std::cout << "✓ Multichannel stream with missing bits lost " << codec.getLostFrames()
+                  << " frame(s), later frames intact" << std::endl;
+    } else {
+        std::cout << "✗ Multichannel stream did not recover from missing bits" << std::endl;
+    }
+}
+
+void testFrameEditing() {
+    std::cout << "\n\n=== Testing Frame-Level Cut, Concatenate and Splice ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 4096 * 30;
+    std::vector<std::vector<int32_t> > first(2, std::vector<int32_t>(numSamples));
+    std::vector<std::vector<int32_t> > second(2, std::vector<int32_t>(numSamples / 3));
+    std::srand(42);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        first[0][i] = static_cast<int32_t>(9000.0 * std::sin(i * 0.011)) + std::rand() % 101 - 50;
+        first[1][i] = static_cast<int32_t>(7000.0 * std::sin(i * 0.011 + 0.3)) + std::rand() % 101 - 50;
+        if (i < numSamples / 3) {
+            second[0][i] = static_cast<int32_t>(5000.0 * std::sin(i * 0.05)) + std::rand() % 201 - 100;
+            second[1][i] = static_cast<int32_t>(5000.0 * std::cos(i * 0.05)) + std::rand() % 201 - 100;
+        }
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    
+    AudioCodec codec;
+    codec.setPreset(5);
+    CompressedAudio a = codec.encodeMultichannel(first, info);
+    CompressedAudio b = codec.encodeMultichannel(second, info);
+    
+    // Cut inside frames: only the two edge frames are re-encoded
+    size_t start = 4096 * 3 + 1000;
+    size_t end = 4096 * 27 + 123;
+    std::clock_t clockStart = std::clock();
+    CompressedAudio cut = codec.cutMultichannel(a, start, end);
+    double cutTime = static_cast<double>(std::clock() - clockStart) / CLOCKS_PER_SEC;
+    
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    clockStart = std::clock();
+    codec.decodeMultichannel(a, decoded, decodedInfo);
+    for (int c = 0; c < 2; c++) {
+        decoded[c] = std::vector<int32_t>(decoded[c].begin() + start, decoded[c].begin() + end);
+    }
+    codec.encodeMultichannel(decoded, info);
+    double reencodeTime = static_cast<double>(std::clock() - clockStart) / CLOCKS_PER_SEC;
+    
+    std::vector<std::vector<int32_t> > expected = decoded;
+    codec.decodeMultichannel(cut, decoded, decodedInfo);
+    std::cout << "Cut: " << cutTime * 1000.0 << " ms, decode and re-encode: " << reencodeTime * 1000.0 << " ms"
+              << std::endl;
+    if (decoded == expected && cutTime < reencodeTime) {
+        std::cout << "✓ Cut at arbitrary samples is exact and faster than re-encoding" << std::endl;
+    } else {
+        std::cout << "✗ Cut mismatch or no faster than re-encoding" << std::endl;
+    }
+    
+    // Concatenate the cut with another stream (its last frame is partial)
+    CompressedAudio joined = codec.concatenateMultichannel(cut, b);
+    codec.decodeMultichannel(joined, decoded, decodedInfo);
+    bool joinedOk = decoded.size() == 2;
+    for (int c = 0; c < 2 && joinedOk; c++) {
+        std::vector<int32_t> reference = expected[c];
+        reference.insert(reference.end(), second[c].begin(), second[c].end());
+        joinedOk = decoded[c] == reference;
+    }
+    if (joinedOk && joined.compressedSize < cut.compressedSize + b.compressedSize + 1000) {
+        std::cout << "✓ Concatenation decodes to both streams in order" << std::endl;
+    } else {
+        std::cout << "✗ Concatenation failed" << std::endl;
+    }
+    
+    // Splice the second stream over a range of the first
+    CompressedAudio spliced = codec.spliceMultichannel(a, 5000, 60000, b);
+    codec.decodeMultichannel(spliced, decoded, decodedInfo);
+    bool splicedOk = decoded.size() == 2;
+    for (int c = 0; c < 2 && splicedOk; c++) {
+        std::vector<int32_t> reference(first[c].begin(), first[c].begin() + 5000);
+        reference.insert(reference.end(), second[c].begin(), second[c].end());
+        reference.insert(reference.end(), first[c].begin() + 60000, first[c].end());
+        splicedOk = decoded[c] == reference;
+    }
+    std::cout << (splicedOk ? "✓ Splice replaced the range exactly" : "✗ Splice mismatch") << std::endl;
+    
+    // Re-encoding the edge frames is not charged to the codec's encode statistics
+    CodecProfile profile;
+    codec.setProfile(&profile);
+    codec.cutMultichannel(a, start, end);
+    codec.setProfile(NULL);
+    if (profile.frames == 0 && profile.stageSeconds[PROFILE_PARAMETER_SEARCH] == 0.0) {
+        std::cout << "✓ Cut leaves the attached profile's encode counters alone" << std::endl;
+    } else {
+        std::cout << "✗ Cut charged its re-encoding to the attached profile" << std::endl;
+    }
+    
+    // Streams with different coding parameters cannot be joined
+    codec.setNearLossless(2);
+    CompressedAudio nearLossless = codec.encodeMultichannel(second, info);
+    try {
+        codec.concatenateMultichannel(a, nearLossless);
+        std::cout << "✗ Incompatible streams concatenated" << std::endl;
+    } catch (const std::invalid_argument&) {
+        std::cout << "✓ Incompatible streams rejected" << std::endl;
+    }
+}
+
+void testInstrumentation() {
+    std::cout << "\n\n=== Testing Per-Stage Timing and Counters ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // A quiet tone with loud clicks, so some residuals need escape codes
+    uint32_t numSamples = 4096 * 8;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::srand(7);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        int32_t click = i % 5000 == 2500 ? 30000 : 0;
+        channels[0][i] = static_cast<int32_t>(300.0 * std::sin(i * 0.02)) + std::rand() % 5 - 2 + click;
+        channels[1][i] = static_cast<int32_t>(250.0 * std::sin(i * 0.02 + 0.4)) + std::rand() % 5 - 2 - click;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    
+    CodecProfile profile;
+    AudioCodec codec;
+    codec.setPreset(5);
+    codec.setProfile(&profile);
+    CompressedAudio compressed = codec.encodeMultichannel(channels, info);
+    CodecProfile encoded = profile;
+    
+    bool countersMatch = encoded.frames == 8;
+    for (int t = 0; t < SUBFRAME_TYPE_COUNT; t++) {
+        countersMatch = countersMatch && encoded.subframeTypeCount[t] == compressed.subframeTypeCount[t];
+    }
+    for (int m = 0; m < 4; m++) {
+        countersMatch = countersMatch && encoded.stereoModeCount[m] == compressed.stereoModeCount[m];
+    }
+    std::cout << "Escape codes: " << encoded.escapeCodes << " of " << encoded.residuals
+              << " residuals, mean Rice parameter " << encoded.averageRiceParameter() << std::endl;
+    if (countersMatch && encoded.escapeCodes > 0 && encoded.parameters > 0) {
+        std::cout << "✓ Frame, subframe, stereo mode and escape counters recorded" << std::endl;
+    } else {
+        std::cout << "✗ Encoder counters do not match the stream" << std::endl;
+    }
+    
+    bool stagesTimed = encoded.stageSeconds[PROFILE_WAV_IO] == 0.0;
+    for (int s = PROFILE_PREDICTION; s < PROFILE_STAGE_COUNT; s++) {
+        stagesTimed = stagesTimed && encoded.stageSeconds[s] > 0.0;
+    }
+    std::cout << (stagesTimed ? "✓ Every codec stage timed" : "✗ Missing stage timings") << std::endl;
+    
+    // The decoder reads back the same subframes, parameters and escapes
+    profile.clear();
+    std::vector<std::vector<int32_t> > decoded;
+    AudioInfo decodedInfo;
+    codec.decodeMultichannel(compressed, decoded, decodedInfo);
+    bool decodeMatches = decoded == channels && profile.frames == encoded.frames &&
+                         profile.escapeCodes == encoded.escapeCodes && profile.parameters == encoded.parameters &&
+                         profile.residuals == encoded.residuals;
+    for (int t = 0; t < SUBFRAME_TYPE_COUNT; t++) {
+        decodeMatches = decodeMatches && profile.subframeTypeCount[t] == encoded.subframeTypeCount[t];
+    }
+    std::cout << (decodeMatches ? "✓ Decoder counters match the encoder's" : "✗ Decoder counters differ")
+              << std::endl;
+    
+    // WAV I/O shares the profile
+    WAVFile wav;
+    wav.setProfile(&profile);
+    wav.writeMultichannel("test_profile.wav", channels, info);
+    wav.readMultichannel("test_profile.wav", decoded, decodedInfo);
+    std::remove("test_profile.wav");
+    std::string json = profile.toJSON();
+    if (profile.stageSeconds[PROFILE_WAV_IO] > 0.0 && json.find("\"wavIO\"") != std::string::npos &&
+        json.find("\"escapeCodes\": " + std::to_string(profile.escapeCodes)) != std::string::npos) {
+        std::cout << "✓ WAV I/O timed and JSON dump written" << std::endl;
+    } else {
+        std::cout << "✗ WAV I/O timing or JSON dump missing" << std::endl;
+    }
+    
+    // Detached: nothing more is recorded
+    codec.setProfile(NULL);
+    profile.clear();
+    codec.encodeMultichannel(channels, info);
+    bool untouched = profile.frames == 0 && profile.residuals == 0 && profile.totalSeconds() == 0.0;
+    std::cout << (untouched ? "✓ Nothing recorded without a profile" : "✗ Detached profile still updated")
+              << std::endl;
+}
+
+void testFrameTrace() {
+    std::cout << "\n\n=== Testing Per-Frame Trace Export ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 4096 * 40 + 1000;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    std::srand(11);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        double envelope = i < numSamples / 2 ? 1.0 : 0.05;
+        channels[0][i] = static_cast<int32_t>(envelope * 8000.0 * std::sin(i * 0.013)) + std::rand() % 31 - 15;
+        channels[1][i] = static_cast<int32_t>(envelope * 6000.0 * std::sin(i * 0.013 + 0.2)) + std::rand() % 31 - 15;
+    }
+    
+    AudioInfo info;
+    info.sampleRate = 44100;
+    info.channels = 2;
+    info.bitsPerSample = 16;
+    
+    AudioCodec codec;
+    codec.setPreset(5);
+    std::clock_t clockStart = std::clock();
+    CompressedAudio plain = codec.encodeMultichannel(channels, info);
+    double plainTime = static_cast<double>(std::clock() - clockStart) / CLOCKS_PER_SEC;
+    
+    // CSV: a header plus one line per frame, whose sizes add up to the stream
+    std::ostringstream csv;
+    FrameTrace csvTrace(csv, TRACE_CSV);
+    codec.setTrace(&csvTrace);
+    clockStart = std::clock();
+    CompressedAudio compressed = codec.encodeMultichannel(channels, info);
+    double tracedTime = static_cast<double>(std::clock() - clockStart) / CLOCKS_PER_SEC;
+    
+    std::istringstream lines(csv.str());
+    std::string line;
+    std::getline(lines, line);
+    size_t rows = 0;
+    size_t frameBits = 0;
+    while (std::getline(lines, line)) {
+        rows++;
+        size_t field = 0;
+        for (int comma = 0; comma < 3; comma++) {
+            field = line.find(',', field) + 1;
+        }
+        frameBits += std::strtoul(line.c_str() + field, NULL, 10);
+    }
+    size_t frames = (numSamples + 4095) / 4096;
+    std::cout << "Encode: " << plainTime * 1000.0 << " ms, with CSV trace: " << tracedTime * 1000.0 << " ms"
+              << std::endl;
+    if (rows == frames && csvTrace.getFrameCount() == frames && compressed.data == plain.data &&
+        frameBits < compressed.data.size() && compressed.data.size() - frameBits < 200) {
+        std::cout << "✓ One CSV row per frame; frame sizes add up to the stream" << std::endl;
+    } else {
+        std::cout << "✗ CSV trace rows or sizes wrong" << std::endl;
+    }
+    
+    // Binary: read back with the same contents as the stream statistics
+    std::stringstream binary;
+    FrameTrace binaryTrace(binary, TRACE_BINARY);
+    codec.setTrace(&binaryTrace);
+    codec.encodeMultichannel(channels, info);
+    codec.setTrace(NULL);
+    
+    std::vector<FrameTraceRecord> records;
+    bool readOk = FrameTrace::readBinary(binary, records) && records.size() == frames;
+    size_t typeCount[SUBFRAME_TYPE_COUNT] = {};
+    size_t modeCount[4] = {};
+    for (size_t f = 0; f < records.size() && readOk; f++) {
+        readOk = records[f].frame == f && records[f].start == f * 4096 && records[f].subframes.size() == 2 &&
+                 records[f].stereoModes.size() == 1;
+        for (size_t i = 0; i < records[f].subframes.size(); i++) {
+            const SubframeTrace& subframe = records[f].subframes[i];
+            typeCount[subframe.type]++;
+            readOk = readOk && (subframe.type != SUBFRAME_LPC || (subframe.order >= 1 && subframe.order <= 8));
+            readOk = readOk && (subframe.type == SUBFRAME_CONSTANT || subframe.type == SUBFRAME_VERBATIM ||
+                                !subframe.parameters.empty());
+        }
+        modeCount[records[f].stereoModes[0]]++;
+    }
+    for (int t = 0; t < SUBFRAME_TYPE_COUNT && readOk; t++) {
+        readOk = typeCount[t] == compressed.subframeTypeCount[t];
+    }
+    for (int m = 0; m < 4 && readOk; m++) {
+        readOk = modeCount[m] == compressed.stereoModeCount[m];
+    }
+    std::cout << (readOk ? "✓ Binary trace reads back with the stream's subframe types and stereo modes"
+                         : "✗ Binary trace mismatch") << std::endl;
+}
+
+void testMappedWAV() {
+    std::cout << "\n\n=== Testing Memory-Mapped WAV Input ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    int bitDepths[] = {16, 24};
+    for (int bits : bitDepths) {
+        uint32_t numSamples = 4096 * 5 + 77;
+        std::vector<std::vector<int32_t> > channels(6, std::vector<int32_t>(numSamples));
+        double amplitude = std::ldexp(0.5, bits - 1);
+        std::srand(bits);
+        for (uint32_t i = 0; i < numSamples; i++) {
+            for (int c = 0; c < 6; c++) {
+                channels[c][i] = static_cast<int32_t>(amplitude * std::sin(i * 0.01 * (c + 1))) + std::rand() % 17 - 8;
+            }
+        }
+        
+        AudioInfo info;
+        info.sampleRate = 48000;
+        info.channels = 6;
+        info.bitsPerSample = bits;
+        
+        WAVFile wav;
+        std::string filename = "test_mapped_" + std::to_string(bits) + ".wav";
+        bool mappedOk = wav.writeMultichannel(filename, channels, info) && wav.map(filename) &&
+                        wav.isMapped() && wav.getAudioData().empty() && wav.getSpan().frames == numSamples &&
+                        wav.getSpan().channels == 6 && wav.getInfo().numSamples == numSamples;
+        
+        // The mapped samples are coded in place, giving the same stream
+        AudioCodec codec;
+        codec.setPreset(3);
+        if (mappedOk) {
+            CompressedAudio fromSpan = codec.encodeMultichannel(wav.getSpan(), wav.getInfo());
+            CompressedAudio fromVectors = codec.encodeMultichannel(channels, info);
+            std::vector<std::vector<int32_t> > decoded;
+            AudioInfo decodedInfo;
+            codec.decodeMultichannel(fromSpan, decoded, decodedInfo);
+            mappedOk = fromSpan.data == fromVectors.data && decoded == channels;
+        }
+        wav.unmap();
+        std::remove(filename.c_str());
+        std::cout << (mappedOk ? "✓ " : "✗ ") << bits << "-bit 6-channel file "
+                  << (mappedOk ? "encoded from the mapping" : "mapping failed") << std::endl;
+    }
+    
+    WAVFile missing;
+    std::cout << (!missing.map("no_such_file.wav") && !missing.isMapped() ? "✓ Missing file not mapped"
+                                                                          : "✗ Missing file mapped") << std::endl;
+}
+
+static void putLittleEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static void putChunk(std::string& out, const char* id, const std::string& contents, uint32_t size) {
+    out.append(id, 4);
+    putLittleEndian(out, size, 4);
+    out += contents;
+    if (contents.size() & 1) out += '\0';
+}
+
+void testChunkedWAV() {
+    std::cout << "\n\n=== Testing Chunked, Extensible and RF64 WAV Files ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    uint32_t numSamples = 3000;
+    std::vector<std::vector<int32_t> > channels(2, std::vector<int32_t>(numSamples));
+    for (uint32_t i = 0; i < numSamples; i++) {
+        channels[0][i] = static_cast<int32_t>(20000 * std::sin(i * 0.02));
+        channels[1][i] = static_cast<int32_t>(-1000000 * std::cos(i * 0.03));
+    }
+    
+    for (int variant = 0; variant < 2; variant++) {
+        // 0: 16-bit extensible RIFF with odd-sized bext and LIST chunks around fmt
+        // 1: 24-bit RF64 with a ds64 chunk and 0xFFFFFFFF sizes
+        int bits = variant == 0 ? 16 : 24;
+        std::string pcm;
+        for (uint32_t i = 0; i < numSamples; i++) {
+            for (int c = 0; c < 2; c++) {
+                int32_t sample = variant == 0 ? static_cast<int16_t>(channels[c][i]) : channels[c][i];
+                putLittleEndian(pcm, static_cast<uint32_t>(sample), bits / 8);
+            }
+        }
+        
+        std::string format;
+        putLittleEndian(format, variant == 0 ? 0xFFFE : 1, 2);
+        putLittleEndian(format, 2, 2);
+        putLittleEndian(format, 48000, 4);
+        putLittleEndian(format, 48000 * 2 * bits / 8, 4);
+        putLittleEndian(format, 2 * bits / 8, 2);
+        putLittleEndian(format, bits, 2);
+        if (variant == 0) {
+            static const uint8_t pcmGuid[16] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                                0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+            putLittleEndian(format, 22, 2);
+            putLittleEndian(format, 16, 2);  // Valid bits
+            putLittleEndian(format, 0x3, 4); // Front left, front right
+            format.append(reinterpret_cast<const char*>(pcmGuid), 16);
+        }
+        
+        std::string body = "WAVE";
+        if (variant == 0) {
+            putChunk(body, "bext", "odd-len", 7);
+            putChunk(body, "fmt ", format, static_cast<uint32_t>(format.size()));
+            putChunk(body, "LIST", std::string("INFOISFT\x04\0\0\0test", 16), 16);
+        } else {
+            std::string ds64;
+            putLittleEndian(ds64, 0, 8); // RIFF size (not used)
+            putLittleEndian(ds64, pcm.size(), 8);
+            putLittleEndian(ds64, numSamples, 8);
+            putLittleEndian(ds64, 0, 4); // No table entries
+            putChunk(body, "ds64", ds64, static_cast<uint32_t>(ds64.size()));
+            putChunk(body, "fmt ", format, static_cast<uint32_t>(format.size()));
+        }
+        putChunk(body, "data", pcm, variant == 0 ? static_cast<uint32_t>(pcm.size()) : 0xFFFFFFFF);
+        std::string fileData = variant == 0 ? "RIFF" : "RF64";
+        putLittleEndian(fileData, variant == 0 ? body.size() : 0xFFFFFFFF, 4);
+        fileData += body;
+        
+        std::string filename = "test_chunked_" + std::to_string(bits) + ".wav";
+        std::ofstream(filename.c_str(), std::ios::binary).write(fileData.data(), fileData.size());
+        
+        std::vector<std::vector<int32_t> > expected = channels;
+        if (variant == 0) {
+            for (uint32_t i = 0; i < numSamples; i++) {
+                expected[1][i] = static_cast<int16_t>(channels[1][i]);
+            }
+        }
+        
+        // Incremental reads in uneven blocks, then a seek back
+        WAVReader reader;
+        bool ok = reader.open(filename) && reader.getFrameCount() == numSamples &&
+                  reader.isExtensible() == (variant == 0) && reader.isRF64() == (variant == 1) &&
+                  reader.getChunks().size() == (variant == 0 ? 2u : 0u);
+        std::vector<std::vector<int32_t> > gathered(2), block;
+        size_t got;
+        while (ok && (got = reader.read(block, 701)) > 0) {
+            for (int c = 0; c < 2; c++) {
+                gathered[c].insert(gathered[c].end(), block[c].begin(), block[c].end());
+            }
+        }
+        std::vector<int32_t> interleaved;
+        ok = ok && gathered == expected && reader.seek(1234) && reader.read(interleaved, 2) == 2 &&
+             interleaved[0] == expected[0][1234] && interleaved[3] == expected[1][1235];
+        if (variant == 0) {
+            ok = ok && reader.getChannelMask() == 0x3 && reader.getChunks()[0].id == "bext" &&
+                 reader.getChunks()[1].id == "LIST";
+        }
+        reader.close();
+        
+        // WAVFile reads and maps through the same parser
+        WAVFile wav;
+        std::vector<std::vector<int32_t> > loaded;
+        AudioInfo loadedInfo;
+        ok = ok && wav.readMultichannel(filename, loaded, loadedInfo) && loaded == expected &&
+             loadedInfo.bitsPerSample == bits && wav.map(filename) && wav.getSpan().frames == numSamples;
+        if (ok) {
+            wav.getSpan().deinterleave(0, numSamples, loaded);
+            ok = loaded == expected;
+        }
+        wav.unmap();
+        std::remove(filename.c_str());
+        std::cout << (ok ? "✓ " : "✗ ") << (variant == 0 ? "Extensible file with bext/LIST chunks"
+                                                          : "RF64 file with ds64 sizes")
+                  << (ok ? " read in blocks" : " not read correctly") << std::endl;
+    }
+    
+    // A data chunk before fmt is rejected
+    std::string bad = "RIFF";
+    putLittleEndian(bad, 12, 4);
+    bad += "WAVE";
+    putChunk(bad, "data", "", 0);
+    std::ofstream("test_chunked_bad.wav", std::ios::binary).write(bad.data(), bad.size());
+    WAVReader reader;
+    bool rejected = !reader.open("test_chunked_bad.wav") && !reader.isOpen();
+    std::remove("test_chunked_bad.wav");
+    std::cout << (rejected ? "✓ data before fmt rejected" : "✗ data before fmt accepted") << std::endl;
+}
+
+void testInterleaveKernels() {
+    std::cout << "\n\n=== Testing PCM Interleave Kernels ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // Several staging blocks plus a ragged tail, against a per-sample reference
+    size_t frames = 5003;
+    int channelCounts[] = {1, 2, 3, 4, 6, 8, 9};
+    int bitDepths[] = {8, 16, 24, 32};
+    bool allOk = true;
+    for (int bits : bitDepths) {
+        for (int numChannels : channelCounts) {
+            std::vector<std::vector<int32_t> > planes(numChannels, std::vector<int32_t>(frames));
+            std::vector<const int32_t*> source(numChannels);
+            std::srand(bits * 16 + numChannels);
+            for (int c = 0; c < numChannels; c++) {
+                for (size_t i = 0; i < frames; i++) {
+                    planes[c][i] = static_cast<int32_t>((static_cast<uint32_t>(std::rand()) << 8) ^ std::rand()) >> (32 - bits);
+                }
+                source[c] = planes[c].data();
+            }
+            
+            size_t bytesPerSample = bits / 8;
+            std::vector<uint8_t> packed(frames * numChannels * bytesPerSample), expected(packed.size());
+            for (size_t i = 0; i < frames; i++) {
+                for (int c = 0; c < numChannels; c++) {
+                    int32ToPcm(&planes[c][i], &expected[(i * numChannels + c) * bytesPerSample], 1, bits);
+                }
+            }
+            interleavePcm(source.data(), packed.data(), frames, numChannels, bits);
+            
+            std::vector<std::vector<int32_t> > unpacked(numChannels, std::vector<int32_t>(frames));
+            std::vector<int32_t*> target(numChannels);
+            for (int c = 0; c < numChannels; c++) {
+                target[c] = unpacked[c].data();
+            }
+            deinterleavePcm(packed.data(), target.data(), frames, numChannels, bits);
+            
+            if (packed != expected || unpacked != planes) {
+                std::cout << "✗ " << numChannels << " channels at " << bits << " bits do not round-trip" << std::endl;
+                allOk = false;
+            }
+        }
+    }
+    if (allOk) {
+        std::cout << "✓ 1-9 channels at 8/16/24/32 bits interleave and de-interleave exactly" << std::endl;
+    }
+    
+    // Out-of-range 16-bit values saturate the same in the vector loop and the tail
+    std::vector<int32_t> loud(11);
+    for (size_t i = 0; i < loud.size(); i++) {
+        loud[i] = i % 2 ? -40000 - static_cast<int32_t>(i) : 40000 + static_cast<int32_t>(i);
+    }
+    std::vector<uint8_t> packed(loud.size() * 2);
+    int32ToPcm(loud.data(), packed.data(), loud.size(), 16);
+    std::vector<int32_t> unpacked(loud.size());
+    pcmToInt32(packed.data(), unpacked.data(), loud.size(), 16);
+    bool saturated = true;
+    for (size_t i = 0; i < loud.size(); i++) {
+        saturated = saturated && unpacked[i] == (i % 2 ? -32768 : 32767);
+    }
+    std::cout << (saturated ? "✓ Out-of-range 16-bit samples saturate at every position"
+                            : "✗ Out-of-range 16-bit samples wrap") << std::endl;
+}
+
+void testStreamingWAVWriter() {
+    std::cout << "\n\n=== Testing Streaming WAV Writer ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // A streaming decoder writes each packet as it is decoded
+    AudioInfo info;
+    info.sampleRate = 48000;
+    info.channels = 3;
+    info.bitsPerSample = 24;
+    size_t numSamples = 10000 + 37;
+    std::vector<int32_t> samples(numSamples * info.channels);
+    for (size_t i = 0; i < numSamples; i++) {
+        for (int c = 0; c < info.channels; c++) {
+            samples[i * info.channels + c] = static_cast<int32_t>(3000000 * std::sin(i * 0.005 * (c + 1)));
+        }
+    }
+    
+    LowLatencyCodec encoder(info, 128);
+    LowLatencyCodec decoder(info, 128);
+    WAVWriter writer;
+    bool ok = writer.open("test_streaming.wav", info);
+    std::vector<bool> packet;
+    std::vector<int32_t> decoded(128 * info.channels);
+    for (size_t start = 0; ok && start < numSamples; start += 128) {
+        size_t n = std::min<size_t>(128, numSamples - start);
+        encoder.encodeFrame(samples.data() + start * info.channels, n, packet);
+        decoder.decodeFrame(packet, decoded.data(), n);
+        ok = writer.write(decoded.data(), n);
+    }
+    ok = ok && writer.getFrameCount() == numSamples && writer.close() && !writer.isOpen();
+    
+    WAVReader reader;
+    std::vector<int32_t> readBack;
+    ok = ok && reader.open("test_streaming.wav") && !reader.isRF64() && reader.getChunks().size() == 1 &&
+         reader.getChunks()[0].id == "JUNK" && reader.getFrameCount() == numSamples &&
+         reader.read(readBack, numSamples) == numSamples && readBack == samples;
+    reader.close();
+    std::cout << (ok ? "✓ Decoded packets streamed to disk and read back"
+                     : "✗ Streamed file does not match") << std::endl;
+    
+    // Planar blocks, with an odd data size padded to a whole word
+    info.channels = 1;
+    info.bitsPerSample = 8;
+    std::vector<std::vector<int32_t> > block(1, std::vector<int32_t>(333));
+    for (size_t i = 0; i < block[0].size(); i++) {
+        block[0][i] = static_cast<int32_t>(i % 256) - 128;
+    }
+    WAVFile wav;
+    std::vector<int32_t> mono;
+    AudioInfo monoInfo;
+    ok = writer.open("test_streaming.wav", info) && writer.write(block) && writer.write(block) && writer.close() &&
+         wav.readMono("test_streaming.wav", mono, monoInfo) && monoInfo.numSamples == 666 &&
+         std::equal(block[0].begin(), block[0].end(), mono.begin() + 333);
+    std::remove("test_streaming.wav");
+    std::cout << (ok ? "✓ Odd-sized planar stream padded and read back"
+                     : "✗ Odd-sized planar stream not read back") << std::endl;
+}
+
+void testAllocationFree() {
+    std::cout << "\n\n=== Testing Allocation-Free Batch Processing ===" << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    
+    // A batch of 6-channel 24-bit files of the same shape
+    AudioInfo info;
+    info.sampleRate = 48000;
+    info.channels = 6;
+    info.bitsPerSample = 24;
+    size_t numSamples = 20000;
+    std::vector<std::vector<int32_t> > source(info.channels, std::vector<int32_t>(numSamples));
+    for (size_t i = 0; i < numSamples; i++) {
+        for (int c = 0; c < info.channels; c++) {
+            source[c][i] = static_cast<int32_t>(2000000 * std::sin(i * 0.003 * (c + 1)) + (rand() % 200) - 100);
+        }
+    }
+    WAVFile wav;
+    const std::string inputFile = "test_batch_in.wav";
+    const std::string outputFile = "test_batch_out.wav";
+    bool ok = wav.writeMultichannel(inputFile, source, info);
+    
+    // Read, encode, decode and write each file with the same objects and
+    // buffers: default settings, preset 5 with pitch prediction, and preset 8
+    // (every predictor)
+    const int presets[] = {-1, 5, 8};
+    AudioCodec codec;
+    std::vector<std::vector<int32_t> > channels, decoded;
+    std::vector<const int32_t*> planes;
+    CompressedAudio compressed;
+    AudioInfo fileInfo, decodedInfo;
+    for (int setting = 0; ok && setting < 3; setting++) {
+        codec = AudioCodec();
+        if (presets[setting] >= 0) {
+            codec.setPreset(presets[setting]);
+            codec.setLongTermPrediction(true);
+        }
+        size_t allocations[3];
+        for (int round = 0; ok && round < 3; round++) {
+            size_t before = allocationCount;
+            ok = wav.readMultichannel(inputFile, channels, fileInfo);
+            planes.resize(channels.size());
+            for (size_t c = 0; c < channels.size(); c++) {
+                planes[c] = channels[c].data();
+            }
+            codec.encodeMultichannel(SampleSpan(planes.data(), fileInfo.numSamples, fileInfo.channels), fileInfo,
+                                     compressed);
+            codec.decodeMultichannel(compressed, decoded, decodedInfo);
+            ok = ok && wav.writeMultichannel(outputFile, decoded, decodedInfo);
+            allocations[round] = allocationCount - before;
+        }
+        ok = ok && decoded == source;
+        std::string name = presets[setting] < 0 ? "Default settings" : "Preset " + std::to_string(presets[setting]);
+        std::cout << (ok ? "✓ " : "✗ ") << name << ": batch round trip " << (ok ? "lossless" : "failed") << std::endl;
+        if (ok) {
+            std::cout << "  Allocations per file: " << allocations[0] << " (first), "
+                      << allocations[1] << ", " << allocations[2] << std::endl;
+        }
+        std::cout << (ok && allocations[1] == 0 && allocations[2] == 0 ? "✓ No allocations after the first file"
+                                                                       : "✗ Steady-state batch allocates")
+                  << std::endl;
+    }
+    
+    // Same from a memory-mapped file
+    size_t mappedAllocations = 1;
+    for (int round = 0; ok && round < 2; round++) {
+        size_t before = allocationCount;
+        ok = wav.map(inputFile);
+        codec.encodeMultichannel(wav.getSpan(), wav.getInfo(), compressed);
+        codec.decodeMultichannel(compressed, decoded, decodedInfo);
+        mappedAllocations = allocationCount - before;
+    }
+    wav.unmap();
+    ok = ok && decoded == source && mappedAllocations == 0;
+    std::cout << (ok ? "✓ Mapped batch encode allocation-free after warmup"
+                     : "✗ Mapped batch encode allocates") << std::endl;
+    std::remove(inputFile.c_str());
+    std::remove(outputFile.c_str());
+}
+
 void testComplexWaveforms() {
     std::cout << "\n\n=== Testing with Complex Waveforms ===" << std::endl;
     std::cout << std::string(60, '=') << std::endl;
@@ -332,6 +2082,30 @@ int main(int argc, char* argv[]) {
         // Run all tests
         testMonoCompression();
         testStereoCompression();
+        testStereoDecorrelation();
+        testMultichannelCompression();
+        testHighResolutionAudio();
+        testFrameTypes();
+        testSilenceRuns();
+        testExtraHighMode();
+        testEncoderPresets();
+        testPartitionedParameters();
+        testPitchPrediction();
+        testCrossChannelPrediction();
+        testNearLossless();
+        testLossyMode();
+        testRateControl();
+        testHybridMode();
+        testLowLatencyProfile();
+        testResyncFrames();
+        testFrameEditing();
+        testInstrumentation();
+        testFrameTrace();
+        testMappedWAV();
+        testChunkedWAV();
+        testInterleaveKernels();
+        testStreamingWAVWriter();
+        testAllocationFree();
         testComplexWaveforms();
         testWAVFileIO();
         
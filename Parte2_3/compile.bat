@@ -2,7 +2,7 @@
 echo Compiling Golomb Coding projects...
 echo.
 
-echo [1/2] Compiling Golomb Test...
+echo [1/3] Compiling Golomb Test...
 g++ -std=c++11 -D_USE_MATH_DEFINES -o golomb_test.exe main.cpp GolombCoding.cpp
 if %errorlevel% neq 0 (
     echo ERROR: Golomb test compilation failed!
@@ -10,14 +10,22 @@ if %errorlevel% neq 0 (
 )
 echo       Success!
 
-echo [2/2] Compiling Audio Codec Test...
-g++ -std=c++11 -D_USE_MATH_DEFINES -o audio_test.exe audio_test.cpp AudioCodec.cpp WAVFile.cpp GolombCoding.cpp
+echo [2/3] Compiling Audio Codec Test...
+g++ -std=c++11 -D_USE_MATH_DEFINES -o audio_test.exe audio_test.cpp AudioCodec.cpp CodecProfile.cpp FrameSync.cpp FrameTrace.cpp LowLatencyCodec.cpp WAVFile.cpp PCMConvert.cpp NLMSPredictor.cpp LPCPredictor.cpp PitchPredictor.cpp FFT.cpp MDCT.cpp GolombCoding.cpp
 if %errorlevel% neq 0 (
     echo ERROR: Audio test compilation failed!
     exit /b 1
 )
 echo       Success!
 
+echo [3/3] Compiling Audio Benchmark...
+g++ -std=c++11 -D_USE_MATH_DEFINES -o audio_bench.exe audio_bench.cpp AudioCodec.cpp CodecProfile.cpp FrameSync.cpp FrameTrace.cpp LowLatencyCodec.cpp WAVFile.cpp PCMConvert.cpp NLMSPredictor.cpp LPCPredictor.cpp PitchPredictor.cpp FFT.cpp MDCT.cpp GolombCoding.cpp
+if %errorlevel% neq 0 (
+    echo ERROR: Audio benchmark compilation failed!
+    exit /b 1
+)
+echo       Success!
+
 echo.
 echo ================================================
 echo Compilation completed successfully!
@@ -25,4 +33,5 @@ echo ================================================
 echo.
 echo Run './golomb_test.exe' to test Golomb coding
 echo Run './audio_test.exe' to test audio codec
+echo Run './audio_bench.exe' to benchmark the presets
 echo.